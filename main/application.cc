@@ -9,6 +9,7 @@
 #include "mcp_server.h"
 #include "assets.h"
 #include "settings.h"
+#include "emotion_table.h"
 
 #include <cstring>
 #include <esp_log.h>
@@ -16,9 +17,69 @@
 #include <driver/gpio.h>
 #include <arpa/inet.h>
 #include <font_awesome.h>
+#include <freertos/semphr.h>
+#include <atomic>
 
 #define TAG "Application"
 
+// 升级进度显示：下载回调只更新数值，由一个常驻任务刷新界面，避免每次回调创建线程
+class UpgradeProgressReporter {
+public:
+    explicit UpgradeProgressReporter(Display* display) : display_(display) {
+        done_ = xSemaphoreCreateBinary();
+        if (done_ == nullptr || xTaskCreate([](void* arg) {
+            ((UpgradeProgressReporter*)arg)->Run();
+            vTaskDelete(NULL);
+        }, "upgrade_progress", 3072, this, 2, &task_handle_) != pdPASS) {
+            // 没有刷新任务时只是不显示进度，不影响升级本身
+            ESP_LOGW(TAG, "Failed to create upgrade progress task");
+            task_handle_ = nullptr;
+        }
+    }
+
+    ~UpgradeProgressReporter() {
+        if (task_handle_ != nullptr) {
+            stopping_ = true;
+            xTaskNotifyGive(task_handle_);
+            xSemaphoreTake(done_, portMAX_DELAY);
+        }
+        if (done_ != nullptr) {
+            vSemaphoreDelete(done_);
+        }
+    }
+
+    void Update(int progress, size_t speed) {
+        if (task_handle_ == nullptr) {
+            return;
+        }
+        progress_ = progress;
+        speed_ = speed;
+        updated_ = true;
+        xTaskNotifyGive(task_handle_);
+    }
+
+private:
+    Display* display_;
+    TaskHandle_t task_handle_ = nullptr;
+    SemaphoreHandle_t done_ = nullptr;
+    std::atomic<int> progress_{0};
+    std::atomic<size_t> speed_{0};
+    std::atomic<bool> updated_{false};
+    std::atomic<bool> stopping_{false};
+
+    void Run() {
+        while (!stopping_) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            if (updated_.exchange(false)) {
+                char buffer[32];
+                snprintf(buffer, sizeof(buffer), "%d%% %uKB/s", progress_.load(), speed_.load() / 1024);
+                display_->SetChatMessage("system", buffer);
+            }
+        }
+        xSemaphoreGive(done_);
+    }
+};
+
 
 static const char* const STATE_STRINGS[] = {
     "unknown",
@@ -82,6 +143,10 @@ void Application::CheckAssetsVersion() {
     Settings settings("assets", true);
     // Check if there is a new assets need to be downloaded
     std::string download_url = settings.GetString("download_url");
+    if (download_url.empty()) {
+        // 上次下载被中断（断电或重启），继续未完成的下载
+        download_url = assets.resumable_download_url();
+    }
 
     if (!download_url.empty()) {
         settings.EraseKey("download_url");
@@ -96,12 +161,9 @@ void Application::CheckAssetsVersion() {
         board.SetPowerSaveMode(false);
         display->SetChatMessage("system", Lang::Strings::PLEASE_WAIT);
 
-        bool success = assets.Download(download_url, [display](int progress, size_t speed) -> void {
-            std::thread([display, progress, speed]() {
-                char buffer[32];
-                snprintf(buffer, sizeof(buffer), "%d%% %uKB/s", progress, speed / 1024);
-                display->SetChatMessage("system", buffer);
-            }).detach();
+        UpgradeProgressReporter reporter(display);
+        bool success = assets.Download(download_url, [&reporter](int progress, size_t speed) -> void {
+            reporter.Update(progress, speed);
         });
 
         board.SetPowerSaveMode(true);
@@ -423,7 +485,7 @@ void Application::Start() {
         xEventGroupSetBits(event_group_, MAIN_EVENT_ERROR);
     });
     protocol_->OnIncomingAudio([this](std::unique_ptr<AudioStreamPacket> packet) {
-        if (device_state_ == kDeviceStateSpeaking) {
+        if (device_state_ == kDeviceStateSpeaking || tts_streaming_) {
             audio_service_.PushPacketToDecodeQueue(std::move(packet));
         }
     });
@@ -436,6 +498,10 @@ void Application::Start() {
     });
     protocol_->OnAudioChannelClosed([this, &board]() {
         board.SetPowerSaveMode(true);
+#if CONFIG_USE_GAPLESS_TTS
+        tts_streaming_ = false;
+        audio_service_.StopTtsPlayback();
+#endif
         Schedule([this]() {
             auto display = Board::GetInstance().GetDisplay();
             display->SetChatMessage("system", "");
@@ -448,6 +514,14 @@ void Application::Start() {
         if (strcmp(type->valuestring, "tts") == 0) {
             auto state = cJSON_GetObjectItem(root, "state");
             if (strcmp(state->valuestring, "start") == 0) {
+#if CONFIG_USE_GAPLESS_TTS
+                // 在网络任务里直接开始接收音频，不等主循环切换状态，避免丢掉第一句的开头
+                if (!tts_streaming_) {
+                    audio_service_.ResetDecoder();
+                    audio_service_.StartTtsPlayback();
+                    tts_streaming_ = true;
+                }
+#endif
                 Schedule([this]() {
                     aborted_ = false;
                     if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
@@ -455,6 +529,10 @@ void Application::Start() {
                     }
                 });
             } else if (strcmp(state->valuestring, "stop") == 0) {
+#if CONFIG_USE_GAPLESS_TTS
+                tts_streaming_ = false;
+                audio_service_.StopTtsPlayback();
+#endif
                 Schedule([this]() {
                     if (device_state_ == kDeviceStateSpeaking) {
                         if (listening_mode_ == kListeningModeManualStop) {
@@ -465,6 +543,7 @@ void Application::Start() {
                     }
                 });
             } else if (strcmp(state->valuestring, "sentence_start") == 0) {
+                audio_service_.MarkTtsSentenceStart();
                 auto text = cJSON_GetObjectItem(root, "text");
                 if (cJSON_IsString(text)) {
                     ESP_LOGI(TAG, "<< %s", text->valuestring);
@@ -484,9 +563,17 @@ void Application::Start() {
         } else if (strcmp(type->valuestring, "llm") == 0) {
             auto emotion = cJSON_GetObjectItem(root, "emotion");
             if (cJSON_IsString(emotion)) {
-                Schedule([this, display, emotion_str = std::string(emotion->valuestring)]() {
-                    display->SetEmotion(emotion_str.c_str());
-                });
+                // 在网络任务里解析一次，已登记的表情只传 ID；服务器发来的未知名称不登记，避免占满表项
+                EmotionId emotion_id = EmotionTable::GetInstance().Find(emotion->valuestring);
+                if (emotion_id != EmotionTable::kInvalidId) {
+                    Schedule([this, display, emotion_id]() {
+                        display->SetEmotionId(emotion_id);
+                    });
+                } else {
+                    Schedule([this, display, emotion_str = std::string(emotion->valuestring)]() {
+                        display->SetEmotion(emotion_str.c_str());
+                    });
+                }
             }
         } else if (strcmp(type->valuestring, "mcp") == 0) {
             auto payload = cJSON_GetObjectItem(root, "payload");
@@ -577,6 +664,11 @@ void Application::MainEventLoop() {
                 if (protocol_ && !protocol_->SendAudio(std::move(packet))) {
                     break;
                 }
+                if (wake_word_time_ != 0) {
+                    ESP_LOGI(TAG, "First audio frame uploaded %ld ms after wake word",
+                        (long)((esp_timer_get_time() - wake_word_time_) / 1000));
+                    wake_word_time_ = 0;
+                }
             }
         }
 
@@ -621,14 +713,20 @@ void Application::OnWakeWordDetected() {
     }
 
     if (device_state_ == kDeviceStateIdle) {
+        wake_word_time_ = esp_timer_get_time();
         audio_service_.EncodeWakeWord();
+        // 打开音频通道可能需要数秒，期间先录音并编码，通道打开后立即上传
+        audio_service_.StartPreroll();
 
         if (!protocol_->IsAudioChannelOpened()) {
             SetDeviceState(kDeviceStateConnecting);
             if (!protocol_->OpenAudioChannel()) {
+                audio_service_.EnableVoiceProcessing(false);
                 audio_service_.EnableWakeWordDetection(true);
+                wake_word_time_ = 0;
                 return;
             }
+            ESP_LOGI(TAG, "Audio channel opened in %ld ms", (long)((esp_timer_get_time() - wake_word_time_) / 1000));
         }
 
         auto wake_word = audio_service_.GetLastWakeWord();
@@ -659,6 +757,12 @@ void Application::AbortSpeaking(AbortReason reason) {
     if (protocol_) {
         protocol_->SendAbortSpeaking(reason);
     }
+#if CONFIG_USE_GAPLESS_TTS
+    // 解码器在整段回复中不会重置，打断时立即清空剩余音频
+    tts_streaming_ = false;
+    audio_service_.StopTtsPlayback();
+    audio_service_.ResetDecoder();
+#endif
 }
 
 void Application::SetListeningMode(ListeningMode mode) {
@@ -701,7 +805,12 @@ void Application::SetDeviceState(DeviceState state) {
             display->SetEmotion("neutral");
 
             // Make sure the audio processor is running
-            if (!audio_service_.IsAudioProcessorRunning()) {
+            if (audio_service_.IsPrerollActive()) {
+                // 唤醒后已经在录音，发送开始监听后上传缓存的音频
+                protocol_->SendStartListening(listening_mode_);
+                audio_service_.EnableWakeWordDetection(false);
+                audio_service_.FlushPreroll();
+            } else if (!audio_service_.IsAudioProcessorRunning()) {
                 // Send the start listening command
                 protocol_->SendStartListening(listening_mode_);
                 audio_service_.EnableVoiceProcessing(true);
@@ -716,7 +825,9 @@ void Application::SetDeviceState(DeviceState state) {
                 // Only AFE wake word can be detected in speaking mode
                 audio_service_.EnableWakeWordDetection(audio_service_.IsAfeWakeWord());
             }
+#if !CONFIG_USE_GAPLESS_TTS
             audio_service_.ResetDecoder();
+#endif
             break;
         default:
             // Do nothing
@@ -764,13 +875,13 @@ bool Application::UpgradeFirmware(Ota& ota, const std::string& url) {
     audio_service_.Stop();
     vTaskDelay(pdMS_TO_TICKS(1000));
 
-    bool upgrade_success = ota.StartUpgradeFromUrl(upgrade_url, [display](int progress, size_t speed) {
-        std::thread([display, progress, speed]() {
-            char buffer[32];
-            snprintf(buffer, sizeof(buffer), "%d%% %uKB/s", progress, speed / 1024);
-            display->SetChatMessage("system", buffer);
-        }).detach();
-    });
+    bool upgrade_success;
+    {
+        UpgradeProgressReporter reporter(display);
+        upgrade_success = ota.StartUpgradeFromUrl(upgrade_url, [&reporter](int progress, size_t speed) {
+            reporter.Update(progress, speed);
+        });
+    }
 
     if (!upgrade_success) {
         // Upgrade failed, restart audio service and continue running
@@ -796,14 +907,20 @@ void Application::WakeWordInvoke(const std::string& wake_word) {
     }
 
     if (device_state_ == kDeviceStateIdle) {
+        wake_word_time_ = esp_timer_get_time();
         audio_service_.EncodeWakeWord();
+        // 打开音频通道可能需要数秒，期间先录音并编码，通道打开后立即上传
+        audio_service_.StartPreroll();
 
         if (!protocol_->IsAudioChannelOpened()) {
             SetDeviceState(kDeviceStateConnecting);
             if (!protocol_->OpenAudioChannel()) {
+                audio_service_.EnableVoiceProcessing(false);
                 audio_service_.EnableWakeWordDetection(true);
+                wake_word_time_ = 0;
                 return;
             }
+            ESP_LOGI(TAG, "Audio channel opened in %ld ms", (long)((esp_timer_get_time() - wake_word_time_) / 1000));
         }
 
         ESP_LOGI(TAG, "Wake word detected: %s", wake_word.c_str());
@@ -6,16 +6,30 @@
 #include "emote_display.h"
 #ifdef HAVE_LVGL
 #include "display/lcd_display.h"
+#include "gif/gif_frame_cache.h"
 #endif
 
+#include "settings.h"
+
 #include <esp_log.h>
+#include <esp_rom_crc.h>
 #include <spi_flash_mmap.h>
 #include <esp_timer.h>
 #include <cbin_font.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
 
 
 #define TAG "Assets"
 
+#define ASSETS_DOWNLOAD_BUFFER_SIZE (16 * 1024)         // 必须是扇区大小的整数倍
+#define ASSETS_DOWNLOAD_CHECKPOINT_SIZE (64 * 1024)
+#define ASSETS_DOWNLOAD_MAX_TRIES 3
+
 struct mmap_assets_table {
     char asset_name[32];          /*!< Name of the asset */
     uint32_t asset_size;          /*!< Size of the asset */
@@ -24,6 +38,48 @@ struct mmap_assets_table {
     uint16_t asset_height;        /*!< Height of the asset */
 };
 
+/*
+ * Assets format v2:
+ * [mmap_assets_header_v2][mmap_assets_entry_v2 * file_count][data...]
+ * Entries are sorted by (name_hash, name) so lookups are a binary search on integers,
+ * only the directory is checked at boot, and each asset carries its own CRC32.
+ */
+#define MMAP_ASSETS_V2_MAGIC 0x3253415A  // "ZAS2"
+
+struct mmap_assets_header_v2 {
+    uint32_t magic;               /*!< MMAP_ASSETS_V2_MAGIC */
+    uint32_t version;             /*!< Format version, 2 */
+    uint32_t file_count;          /*!< Number of directory entries */
+    uint32_t directory_crc32;     /*!< CRC32 of the directory entries */
+    uint32_t data_offset;         /*!< Offset of the data area from the partition start */
+    uint32_t data_length;         /*!< Length of the data area */
+};
+
+struct mmap_assets_entry_v2 {
+    char asset_name[32];          /*!< Name of the asset */
+    uint32_t asset_size;          /*!< Size of the asset */
+    uint32_t asset_offset;        /*!< Offset of the asset in the data area */
+    uint16_t asset_width;         /*!< Width of the asset */
+    uint16_t asset_height;        /*!< Height of the asset */
+    uint32_t asset_crc32;         /*!< CRC32 of the asset payload */
+    uint32_t name_hash;           /*!< FNV-1a hash of the asset name */
+};
+
+enum AssetEntryState : uint8_t {
+    kAssetEntryUnchecked,
+    kAssetEntryValid,
+    kAssetEntryInvalid,
+};
+
+static uint32_t HashAssetName(const char* name, size_t length) {
+    uint32_t hash = 0x811C9DC5;
+    for (size_t i = 0; i < length && name[i] != '\0'; i++) {
+        hash ^= static_cast<uint8_t>(name[i]);
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
 
 Assets::Assets() {
     // Initialize the partition
@@ -48,8 +104,11 @@ bool Assets::InitializePartition() {
     partition_valid_ = false;
     checksum_valid_ = false;
     assets_.clear();
+    directory_ = nullptr;
+    directory_count_ = 0;
+    entry_states_.clear();
 
-    partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_ANY, ESP_PARTITION_SUBTYPE_ANY, "assets");
+    partition_ = FindSlotPartition(GetActiveSlot());
     if (partition_ == nullptr) {
         ESP_LOGI(TAG, "No assets partition found");
         return false;
@@ -72,6 +131,20 @@ bool Assets::InitializePartition() {
 
     partition_valid_ = true;
 
+    auto start_time = esp_timer_get_time();
+    auto header = (const mmap_assets_header_v2*)mmap_root_;
+    if (header->magic == MMAP_ASSETS_V2_MAGIC) {
+        checksum_valid_ = InitializeDirectoryV2();
+    } else {
+        checksum_valid_ = InitializeDirectoryV1();
+    }
+    auto end_time = esp_timer_get_time();
+    ESP_LOGI(TAG, "Assets v%lu directory loaded in %d ms", format_version_, int((end_time - start_time) / 1000));
+    return checksum_valid_;
+}
+
+bool Assets::InitializeDirectoryV1() {
+    format_version_ = 1;
     uint32_t stored_files = *(uint32_t*)(mmap_root_ + 0);
     uint32_t stored_chksum = *(uint32_t*)(mmap_root_ + 4);
     uint32_t stored_len = *(uint32_t*)(mmap_root_ + 8);
@@ -81,27 +154,100 @@ bool Assets::InitializePartition() {
         return false;
     }
 
-    auto start_time = esp_timer_get_time();
     uint32_t calculated_checksum = CalculateChecksum(mmap_root_ + 12, stored_len);
-    auto end_time = esp_timer_get_time();
-    ESP_LOGI(TAG, "The checksum calculation time is %d ms", int((end_time - start_time) / 1000));
-
     if (calculated_checksum != stored_chksum) {
         ESP_LOGE(TAG, "The calculated checksum (0x%lx) does not match the stored checksum (0x%lx)", calculated_checksum, stored_chksum);
         return false;
     }
 
-    checksum_valid_ = true;
-
     for (uint32_t i = 0; i < stored_files; i++) {
         auto item = (const mmap_assets_table*)(mmap_root_ + 12 + i * sizeof(mmap_assets_table));
         auto asset = Asset{
             .size = static_cast<size_t>(item->asset_size),
             .offset = static_cast<size_t>(12 + sizeof(mmap_assets_table) * stored_files + item->asset_offset)
         };
-        assets_[item->asset_name] = asset;
+        assets_[std::string(item->asset_name, strnlen(item->asset_name, sizeof(item->asset_name)))] = asset;
     }
-    return checksum_valid_;
+    return true;
+}
+
+bool Assets::InitializeDirectoryV2() {
+    auto header = (const mmap_assets_header_v2*)mmap_root_;
+    format_version_ = header->version;
+    if (header->version != 2) {
+        ESP_LOGE(TAG, "The assets format version %lu is not supported", header->version);
+        return false;
+    }
+
+    size_t directory_size = header->file_count * sizeof(mmap_assets_entry_v2);
+    if (sizeof(mmap_assets_header_v2) + directory_size > header->data_offset ||
+        header->data_offset > partition_->size ||
+        header->data_length > partition_->size - header->data_offset) {
+        ESP_LOGE(TAG, "The assets header is corrupted (files=%lu, data_offset=0x%lx, data_length=0x%lx)",
+            header->file_count, header->data_offset, header->data_length);
+        return false;
+    }
+
+    // Fast boot path: only the directory is verified, asset payloads are checked on first access
+    directory_ = (const mmap_assets_entry_v2*)(mmap_root_ + sizeof(mmap_assets_header_v2));
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t*)directory_, directory_size);
+    if (crc != header->directory_crc32) {
+        ESP_LOGE(TAG, "The directory CRC32 (0x%08lx) does not match the stored CRC32 (0x%08lx)", crc, header->directory_crc32);
+        directory_ = nullptr;
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header->file_count; i++) {
+        if (directory_[i].asset_offset + 2 + (uint64_t)directory_[i].asset_size > header->data_length) {
+            ESP_LOGE(TAG, "The asset %.32s exceeds the data area", directory_[i].asset_name);
+            directory_ = nullptr;
+            return false;
+        }
+    }
+
+    directory_count_ = header->file_count;
+    data_offset_ = header->data_offset;
+    entry_states_.assign(directory_count_, kAssetEntryUnchecked);
+    return true;
+}
+
+const mmap_assets_entry_v2* Assets::FindEntryV2(const std::string& name) const {
+    uint32_t hash = HashAssetName(name.c_str(), name.size());
+    size_t low = 0, high = directory_count_;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (directory_[mid].name_hash < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    // Entries with the same hash are adjacent, compare names to resolve collisions
+    for (size_t i = low; i < directory_count_ && directory_[i].name_hash == hash; i++) {
+        auto entry_name = directory_[i].asset_name;
+        if (strnlen(entry_name, sizeof(directory_[i].asset_name)) == name.size() &&
+            memcmp(entry_name, name.data(), name.size()) == 0) {
+            return &directory_[i];
+        }
+    }
+    return nullptr;
+}
+
+bool Assets::VerifyEntryV2(const mmap_assets_entry_v2* entry) {
+    auto& state = entry_states_[entry - directory_];
+    if (state == kAssetEntryUnchecked) {
+        auto start_time = esp_timer_get_time();
+        auto data = (const uint8_t*)(mmap_root_ + data_offset_ + entry->asset_offset + 2);
+        uint32_t crc = esp_rom_crc32_le(0, data, entry->asset_size);
+        state = crc == entry->asset_crc32 ? kAssetEntryValid : kAssetEntryInvalid;
+        ESP_LOGD(TAG, "Verified asset %.32s (%lu bytes) in %d us", entry->asset_name, entry->asset_size,
+            int(esp_timer_get_time() - start_time));
+        if (state == kAssetEntryInvalid) {
+            ESP_LOGE(TAG, "The asset %.32s CRC32 (0x%08lx) does not match the stored CRC32 (0x%08lx)",
+                entry->asset_name, crc, entry->asset_crc32);
+        }
+    }
+    return state == kAssetEntryValid;
 }
 
 bool Assets::Apply() {
@@ -155,11 +301,17 @@ bool Assets::Apply() {
     if (cJSON_IsString(font)) {
         std::string fonts_text_file = font->valuestring;
         if (GetAssetData(fonts_text_file, ptr, size)) {
-            auto text_font = std::make_shared<LvglCBinFont>(ptr);
+            // 按语料生成的子集字体会给出缺字时显示的替代字符
+            cJSON* fallback = cJSON_GetObjectItem(root, "text_font_fallback");
+            uint32_t fallback_letter = cJSON_IsNumber(fallback) ? (uint32_t)fallback->valuedouble : 0;
+            int64_t start_time = esp_timer_get_time();
+            auto text_font = std::make_shared<LvglCBinFont>(ptr, true, fallback_letter);
             if (text_font->font() == nullptr) {
                 ESP_LOGE(TAG, "Failed to load fonts.bin");
                 return false;
             }
+            ESP_LOGI(TAG, "Loaded text font %s, %u KB in %lu us", fonts_text_file.c_str(), size / 1024,
+                (uint32_t)(esp_timer_get_time() - start_time));
             if (light_theme != nullptr) {
                 light_theme->set_text_font(text_font);
             }
@@ -173,6 +325,8 @@ bool Assets::Apply() {
 
     cJSON* emoji_collection = cJSON_GetObjectItem(root, "emoji_collection");
     if (cJSON_IsArray(emoji_collection)) {
+        // 资源分区重新映射后表情数据地址可能复用，丢弃按地址缓存的 GIF 帧
+        GifFrameCache::GetInstance().Clear();
         auto custom_emoji_collection = std::make_shared<EmojiCollection>();
         int emoji_count = cJSON_GetArraySize(emoji_collection);
         for (int i = 0; i < emoji_count; i++) {
@@ -382,29 +536,282 @@ bool Assets::Apply() {
     return true;
 }
 
-bool Assets::Download(std::string url, std::function<void(int progress, size_t speed)> progress_callback) {
-    ESP_LOGI(TAG, "Downloading new version of assets from %s", url.c_str());
-    
-    // 取消当前资源分区的内存映射
-    if (mmap_handle_ != 0) {
-        esp_partition_munmap(mmap_handle_);
-        mmap_handle_ = 0;
-        mmap_root_ = nullptr;
+const esp_partition_t* Assets::FindSlotPartition(int slot) {
+    return esp_partition_find_first(ESP_PARTITION_TYPE_ANY, ESP_PARTITION_SUBTYPE_ANY, slot == 0 ? "assets" : "assets_b");
+}
+
+int Assets::GetActiveSlot() {
+    Settings settings("assets", false);
+    int slot = settings.GetInt("slot", 0);
+    if (slot != 0 && FindSlotPartition(slot) == nullptr) {
+        ESP_LOGW(TAG, "Assets slot %d is not in the partition table, fallback to slot 0", slot);
+        return 0;
+    }
+    return slot;
+}
+
+std::string Assets::resumable_download_url() const {
+    Settings settings("assets", false);
+    if (settings.GetInt("dl_offset", 0) == 0) {
+        return "";
+    }
+    return settings.GetString("dl_url");
+}
+
+void Assets::ClearResumeState() {
+    Settings settings("assets", true);
+    settings.EraseKey("dl_url");
+    settings.EraseKey("dl_size");
+    settings.EraseKey("dl_offset");
+    settings.EraseKey("dl_slot");
+    settings.EraseKey("dl_tries");
+}
+
+// 通过 esp_partition_read 校验暂存分区中的完整镜像，不需要额外的 mmap 空间
+bool Assets::VerifyPartitionImage(const esp_partition_t* partition, size_t image_size) {
+    auto start_time = esp_timer_get_time();
+    const size_t chunk_size = 4096;
+    auto buffer = (uint8_t*)malloc(chunk_size);
+    if (buffer == nullptr) {
+        return false;
+    }
+
+    bool valid = false;
+    mmap_assets_header_v2 header;
+    if (image_size < sizeof(header) || esp_partition_read(partition, 0, &header, sizeof(header)) != ESP_OK) {
+        free(buffer);
+        return false;
+    }
+
+    if (header.magic == MMAP_ASSETS_V2_MAGIC) {
+        size_t directory_size = header.file_count * sizeof(mmap_assets_entry_v2);
+        if (header.version == 2 && sizeof(header) + directory_size <= header.data_offset &&
+            header.data_offset + header.data_length <= image_size) {
+            // 目录 CRC
+            uint32_t crc = 0;
+            for (size_t pos = 0; pos < directory_size; pos += chunk_size) {
+                size_t n = std::min(chunk_size, directory_size - pos);
+                esp_partition_read(partition, sizeof(header) + pos, buffer, n);
+                crc = esp_rom_crc32_le(crc, buffer, n);
+            }
+            valid = crc == header.directory_crc32;
+
+            // 逐个资源 CRC
+            for (uint32_t i = 0; valid && i < header.file_count; i++) {
+                mmap_assets_entry_v2 entry;
+                esp_partition_read(partition, sizeof(header) + i * sizeof(entry), &entry, sizeof(entry));
+                if (entry.asset_offset + 2 + (uint64_t)entry.asset_size > header.data_length) {
+                    valid = false;
+                    break;
+                }
+                crc = 0;
+                size_t base = header.data_offset + entry.asset_offset + 2;
+                for (size_t pos = 0; pos < entry.asset_size; pos += chunk_size) {
+                    size_t n = std::min(chunk_size, (size_t)entry.asset_size - pos);
+                    esp_partition_read(partition, base + pos, buffer, n);
+                    crc = esp_rom_crc32_le(crc, buffer, n);
+                }
+                if (crc != entry.asset_crc32) {
+                    ESP_LOGE(TAG, "The staged asset %.32s CRC32 mismatch", entry.asset_name);
+                    valid = false;
+                }
+            }
+        }
+    } else {
+        uint32_t stored_chksum = 0, stored_len = 0;
+        esp_partition_read(partition, 4, &stored_chksum, sizeof(stored_chksum));
+        esp_partition_read(partition, 8, &stored_len, sizeof(stored_len));
+        if (stored_len <= image_size - 12) {
+            uint32_t checksum = 0;
+            for (size_t pos = 0; pos < stored_len; pos += chunk_size) {
+                size_t n = std::min(chunk_size, (size_t)stored_len - pos);
+                esp_partition_read(partition, 12 + pos, buffer, n);
+                for (size_t i = 0; i < n; i++) {
+                    checksum += (char)buffer[i];
+                }
+            }
+            valid = (checksum & 0xFFFF) == stored_chksum;
+        }
+    }
+
+    free(buffer);
+    ESP_LOGI(TAG, "Staged assets image is %s, verified in %d ms", valid ? "valid" : "invalid",
+        int((esp_timer_get_time() - start_time) / 1000));
+    return valid;
+}
+
+namespace {
+
+struct DownloadChunk {
+    uint8_t* data;
+    size_t offset;      // 分区内偏移，按扇区对齐
+    size_t length;      // 0 表示数据流结束
+};
+
+struct DownloadWriter {
+    const esp_partition_t* partition;
+    size_t sector_size;
+    size_t resume_checkpoint;
+    QueueHandle_t free_queue;
+    QueueHandle_t filled_queue;
+    SemaphoreHandle_t done;
+    uint8_t* header_sector;         // 第一个扇区最后写入，中断时分区不会被误认为有效
+    bool header_captured = false;
+    std::atomic<size_t> written{0};
+    std::atomic<size_t> sectors_erased{0};
+    int64_t busy_time_us = 0;
+    std::atomic<bool> failed{false};
+};
+
+void DownloadWriterTask(DownloadWriter* writer) {
+    size_t last_checkpoint = 0;
+    DownloadChunk chunk;
+    while (xQueueReceive(writer->filled_queue, &chunk, portMAX_DELAY) == pdTRUE) {
+        if (chunk.length == 0) {
+            break;
+        }
+        if (!writer->failed) {
+            auto start_time = esp_timer_get_time();
+            size_t erase_size = (chunk.length + writer->sector_size - 1) / writer->sector_size * writer->sector_size;
+            esp_err_t err = esp_partition_erase_range(writer->partition, chunk.offset, erase_size);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to erase 0x%x bytes at offset 0x%x: %s", erase_size, chunk.offset, esp_err_to_name(err));
+                writer->failed = true;
+            }
+            writer->sectors_erased += erase_size / writer->sector_size;
+
+            const uint8_t* data = chunk.data;
+            size_t offset = chunk.offset;
+            size_t length = chunk.length;
+            if (offset == 0) {
+                size_t header_length = std::min(length, writer->sector_size);
+                memcpy(writer->header_sector, data, header_length);
+                writer->header_captured = true;
+                data += header_length;
+                offset += header_length;
+                length -= header_length;
+            }
+            if (!writer->failed && length > 0) {
+                err = esp_partition_write(writer->partition, offset, data, length);
+                if (err != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed to write to assets partition at offset 0x%x: %s", offset, esp_err_to_name(err));
+                    writer->failed = true;
+                }
+            }
+            writer->busy_time_us += esp_timer_get_time() - start_time;
+
+            size_t end = chunk.offset + chunk.length;
+            if (!writer->failed) {
+                writer->written = end;
+                // 只记录完整写入的扇区边界，重启后从这里继续下载
+                if (end % writer->sector_size == 0 && end - last_checkpoint >= writer->resume_checkpoint) {
+                    Settings settings("assets", true);
+                    settings.SetInt("dl_offset", end);
+                    last_checkpoint = end;
+                }
+            }
+        }
+        xQueueSend(writer->free_queue, &chunk.data, portMAX_DELAY);
+    }
+    xSemaphoreGive(writer->done);
+}
+
+}  // namespace
+
+bool Assets::DownloadHeaderSector(const std::string& url, uint8_t* buffer, size_t length) {
+    auto http = Board::GetInstance().GetNetwork()->CreateHttp(0);
+    http->SetHeader("Range", "bytes=0-" + std::to_string(length - 1));
+    if (!http->Open("GET", url)) {
+        ESP_LOGE(TAG, "Failed to open HTTP connection");
+        return false;
+    }
+    int status = http->GetStatusCode();
+    if (status != 206 && status != 200) {
+        ESP_LOGE(TAG, "Failed to get assets header, status code: %d", status);
+        return false;
+    }
+    size_t total_read = 0;
+    while (total_read < length) {
+        int ret = http->Read((char*)buffer + total_read, length - total_read);
+        if (ret <= 0) {
+            break;
+        }
+        total_read += ret;
+    }
+    http->Close();
+    return total_read == length;
+}
+
+bool Assets::DownloadFull(const std::string& url, std::function<void(int progress, size_t speed)> progress_callback) {
+    // 有 assets_b 分区时写入非活动分区（A/B），旧资源在新镜像校验通过前一直可用；
+    // 否则原地更新，第一个扇区最后写入
+    int active_slot = GetActiveSlot();
+    int target_slot = active_slot;
+    if (FindSlotPartition(1) != nullptr) {
+        target_slot = 1 - active_slot;
+    }
+    auto target = FindSlotPartition(target_slot);
+    if (target == nullptr) {
+        ESP_LOGE(TAG, "No assets partition found");
+        return false;
+    }
+    bool in_place = target_slot == active_slot;
+    ESP_LOGI(TAG, "Download to slot %d (%s), %s", target_slot, target->label, in_place ? "in place" : "A/B staging");
+
+    if (in_place) {
+        // 取消当前资源分区的内存映射
+        if (mmap_handle_ != 0) {
+            esp_partition_munmap(mmap_handle_);
+            mmap_handle_ = 0;
+            mmap_root_ = nullptr;
+        }
+        checksum_valid_ = false;
+        assets_.clear();
+        directory_ = nullptr;
+        directory_count_ = 0;
+        entry_states_.clear();
+    }
+
+    // 读取断点信息，同一个 URL 和目标分区时从上次写入的扇区继续
+    size_t start_offset = 0;
+    size_t expected_size = 0;
+    {
+        Settings settings("assets", true);
+        if (settings.GetString("dl_url") == url && settings.GetInt("dl_slot", -1) == target_slot) {
+            int tries = settings.GetInt("dl_tries", 0) + 1;
+            if (tries > ASSETS_DOWNLOAD_MAX_TRIES) {
+                ESP_LOGW(TAG, "Too many resume attempts, restart from the beginning");
+            } else {
+                start_offset = settings.GetInt("dl_offset", 0);
+                expected_size = settings.GetInt("dl_size", 0);
+                settings.SetInt("dl_tries", tries);
+            }
+        }
+        if (start_offset == 0) {
+            settings.SetString("dl_url", url);
+            settings.SetInt("dl_slot", target_slot);
+            settings.SetInt("dl_offset", 0);
+            settings.SetInt("dl_tries", 1);
+        }
     }
-    checksum_valid_ = false;
-    assets_.clear();
 
-    // 下载新的资源文件
     auto network = Board::GetInstance().GetNetwork();
     auto http = network->CreateHttp(0);
-    
+    if (start_offset > 0) {
+        http->SetHeader("Range", "bytes=" + std::to_string(start_offset) + "-");
+    }
+
     if (!http->Open("GET", url)) {
         ESP_LOGE(TAG, "Failed to open HTTP connection");
         return false;
     }
 
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get assets, status code: %d", http->GetStatusCode());
+    int status_code = http->GetStatusCode();
+    if (status_code == 200 && start_offset > 0) {
+        ESP_LOGW(TAG, "Server does not support Range, restart from the beginning");
+        start_offset = 0;
+    } else if (status_code != 200 && status_code != 206) {
+        ESP_LOGE(TAG, "Failed to get assets, status code: %d", status_code);
         return false;
     }
 
@@ -413,98 +820,183 @@ bool Assets::Download(std::string url, std::function<void(int progress, size_t s
         ESP_LOGE(TAG, "Failed to get content length");
         return false;
     }
+    content_length += start_offset;
+    if (start_offset > 0 && content_length != expected_size) {
+        ESP_LOGE(TAG, "Assets size changed (%u -> %u), cannot resume", expected_size, content_length);
+        http->Close();
+        ClearResumeState();
+        return false;
+    }
 
-    if (content_length > partition_->size) {
-        ESP_LOGE(TAG, "Assets file size (%u) is larger than partition size (%lu)", content_length, partition_->size);
+    if (content_length > target->size) {
+        ESP_LOGE(TAG, "Assets file size (%u) is larger than partition size (%lu)", content_length, target->size);
         return false;
     }
+    {
+        Settings settings("assets", true);
+        settings.SetInt("dl_size", content_length);
+    }
 
-    // 定义扇区大小为4KB（ESP32的标准扇区大小）
     const size_t SECTOR_SIZE = esp_partition_get_main_flash_sector_size();
-    
-    // 计算需要擦除的扇区数量
-    size_t sectors_to_erase = (content_length + SECTOR_SIZE - 1) / SECTOR_SIZE; // 向上取整
-    size_t total_erase_size = sectors_to_erase * SECTOR_SIZE;
-    
-    ESP_LOGI(TAG, "Sector size: %u, content length: %u, sectors to erase: %u, total erase size: %u", 
-             SECTOR_SIZE, content_length, sectors_to_erase, total_erase_size);
-    
-    // 写入新的资源文件到分区，一边erase一边写入
-    char buffer[512];
-    size_t total_written = 0;
-    size_t recent_written = 0;
-    size_t current_sector = 0;
-    auto last_calc_time = esp_timer_get_time();
-    
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
-            return false;
-        }
+    ESP_LOGI(TAG, "Sector size: %u, content length: %u, resume from: %u", SECTOR_SIZE, content_length, start_offset);
 
-        if (ret == 0) {
-            break;
+    // 网络读取在当前任务，擦除和写入在写入任务，两个缓冲区交替使用
+    DownloadWriter writer;
+    writer.partition = target;
+    writer.sector_size = SECTOR_SIZE;
+    writer.resume_checkpoint = ASSETS_DOWNLOAD_CHECKPOINT_SIZE;
+    writer.free_queue = xQueueCreate(2, sizeof(uint8_t*));
+    writer.filled_queue = xQueueCreate(2, sizeof(DownloadChunk));
+    writer.done = xSemaphoreCreateBinary();
+    writer.header_sector = (uint8_t*)malloc(SECTOR_SIZE);
+    writer.written = start_offset;
+    uint8_t* buffers[2] = {
+        (uint8_t*)malloc(ASSETS_DOWNLOAD_BUFFER_SIZE),
+        (uint8_t*)malloc(ASSETS_DOWNLOAD_BUFFER_SIZE),
+    };
+    auto cleanup = [&]() {
+        if (writer.free_queue != nullptr) {
+            vQueueDelete(writer.free_queue);
+        }
+        if (writer.filled_queue != nullptr) {
+            vQueueDelete(writer.filled_queue);
         }
+        if (writer.done != nullptr) {
+            vSemaphoreDelete(writer.done);
+        }
+        free(writer.header_sector);
+        free(buffers[0]);
+        free(buffers[1]);
+    };
+    if (writer.free_queue == nullptr || writer.filled_queue == nullptr || writer.done == nullptr ||
+        writer.header_sector == nullptr || buffers[0] == nullptr || buffers[1] == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate download buffers");
+        cleanup();
+        return false;
+    }
+    xQueueSend(writer.free_queue, &buffers[0], 0);
+    xQueueSend(writer.free_queue, &buffers[1], 0);
 
-        // 检查是否需要擦除新的扇区
-        size_t write_end_offset = total_written + ret;
-        size_t needed_sectors = (write_end_offset + SECTOR_SIZE - 1) / SECTOR_SIZE;
-        
-        // 擦除需要的新扇区
-        while (current_sector < needed_sectors) {
-            size_t sector_start = current_sector * SECTOR_SIZE;
-            size_t sector_end = (current_sector + 1) * SECTOR_SIZE;
-            
-            // 确保擦除范围不超过分区大小
-            if (sector_end > partition_->size) {
-                ESP_LOGE(TAG, "Sector end (%u) exceeds partition size (%lu)", sector_end, partition_->size);
-                return false;
-            }
-            
-            ESP_LOGD(TAG, "Erasing sector %u (offset: %u, size: %u)", current_sector, sector_start, SECTOR_SIZE);
-            esp_err_t err = esp_partition_erase_range(partition_, sector_start, SECTOR_SIZE);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to erase sector %u at offset %u: %s", current_sector, sector_start, esp_err_to_name(err));
-                return false;
+    if (xTaskCreate([](void* arg) {
+        DownloadWriterTask((DownloadWriter*)arg);
+        vTaskDelete(NULL);
+    }, "assets_writer", 4096, &writer, 4, nullptr) != pdPASS) {
+        // 没有写入任务时缓冲区不会被归还，下载循环会一直等待
+        ESP_LOGE(TAG, "Failed to create assets writer task");
+        http->Close();
+        cleanup();
+        return false;
+    }
+
+    auto start_time = esp_timer_get_time();
+    auto last_calc_time = start_time;
+    size_t last_written = start_offset;
+    size_t offset = start_offset;
+    int64_t reader_wait_us = 0;
+    bool read_failed = false;
+
+    while (offset < content_length && !writer.failed) {
+        uint8_t* buffer = nullptr;
+        auto wait_start = esp_timer_get_time();
+        xQueueReceive(writer.free_queue, &buffer, portMAX_DELAY);
+        reader_wait_us += esp_timer_get_time() - wait_start;
+
+        size_t filled = 0;
+        size_t want = std::min((size_t)ASSETS_DOWNLOAD_BUFFER_SIZE, content_length - offset);
+        while (filled < want) {
+            int ret = http->Read((char*)buffer + filled, want - filled);
+            if (ret <= 0) {
+                if (ret < 0) {
+                    ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
+                }
+                read_failed = true;
+                break;
             }
-            
-            current_sector++;
+            filled += ret;
         }
 
-        // 写入数据到分区
-        esp_err_t err = esp_partition_write(partition_, total_written, buffer, ret);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write to assets partition at offset %u: %s", total_written, esp_err_to_name(err));
-            return false;
+        if (filled > 0) {
+            DownloadChunk chunk = { buffer, offset, filled };
+            xQueueSend(writer.filled_queue, &chunk, portMAX_DELAY);
+            offset += filled;
+        } else {
+            xQueueSend(writer.free_queue, &buffer, portMAX_DELAY);
+        }
+        if (read_failed) {
+            break;
         }
-
-        total_written += ret;
-        recent_written += ret;
 
         // 计算进度和速度
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || total_written == content_length || ret == 0) {
-            size_t progress = total_written * 100 / content_length;
-            size_t speed = recent_written; // 每秒的字节数
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %u B/s, Sectors erased: %u", 
-                     progress, total_written, content_length, speed, current_sector);
+        auto now = esp_timer_get_time();
+        if (now - last_calc_time >= 1000000 || offset == content_length) {
+            size_t written = writer.written;
+            size_t progress = written * 100 / content_length;
+            size_t speed = (written - last_written) * 1000000 / (now - last_calc_time);
+            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %u B/s, Sectors erased: %u",
+                     progress, written, content_length, speed, writer.sectors_erased.load());
             if (progress_callback) {
                 progress_callback(progress, speed);
             }
-            last_calc_time = esp_timer_get_time();
-            recent_written = 0; // 重置最近写入的字节数
+            last_calc_time = now;
+            last_written = written;
         }
     }
-    
     http->Close();
 
-    if (total_written != content_length) {
-        ESP_LOGE(TAG, "Downloaded size (%u) does not match expected size (%u)", total_written, content_length);
+    DownloadChunk end_chunk = { nullptr, 0, 0 };
+    xQueueSend(writer.filled_queue, &end_chunk, portMAX_DELAY);
+    xSemaphoreTake(writer.done, portMAX_DELAY);
+
+    auto elapsed_us = esp_timer_get_time() - start_time;
+    size_t downloaded = offset - start_offset;
+    ESP_LOGI(TAG, "Downloaded %u bytes in %d ms (%u KB/s), flash busy %d ms, reader waited %d ms, sectors erased: %u",
+        downloaded, int(elapsed_us / 1000), elapsed_us > 0 ? size_t(downloaded * 1000000LL / elapsed_us / 1024) : 0,
+        int(writer.busy_time_us / 1000), int(reader_wait_us / 1000), writer.sectors_erased.load());
+
+    if (writer.failed || offset != content_length) {
+        ESP_LOGE(TAG, "Downloaded size (%u) does not match expected size (%u)", offset, content_length);
+        cleanup();
+        if (!in_place) {
+            // 旧资源仍然有效
+            return false;
+        }
+        InitializePartition();
+        return false;
+    }
+
+    // 断点续传时第一个扇区不在内存中，单独下载
+    size_t header_length = std::min(SECTOR_SIZE, content_length);
+    if (!writer.header_captured && !DownloadHeaderSector(url, writer.header_sector, header_length)) {
+        cleanup();
+        return false;
+    }
+    esp_err_t err = esp_partition_write(target, 0, writer.header_sector, header_length);
+    cleanup();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write assets header: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    if (!VerifyPartitionImage(target, content_length)) {
+        // 让损坏的镜像无法被识别，下次重新下载
+        esp_partition_erase_range(target, 0, SECTOR_SIZE);
+        ClearResumeState();
+        if (in_place) {
+            InitializePartition();
+        }
         return false;
     }
+    ClearResumeState();
 
-    ESP_LOGI(TAG, "Assets download completed, total written: %u bytes, total sectors erased: %u", 
-             total_written, current_sector);
+    if (!in_place) {
+        if (mmap_handle_ != 0) {
+            esp_partition_munmap(mmap_handle_);
+            mmap_handle_ = 0;
+            mmap_root_ = nullptr;
+        }
+        Settings settings("assets", true);
+        settings.SetInt("slot", target_slot);
+    }
 
     // 重新初始化资源分区
     if (!InitializePartition()) {
@@ -515,18 +1007,381 @@ bool Assets::Download(std::string url, std::function<void(int progress, size_t s
     return true;
 }
 
-bool Assets::GetAssetData(const std::string& name, void*& ptr, size_t& size) {
-    auto asset = assets_.find(name);
-    if (asset == assets_.end()) {
+namespace {
+
+// 按顺序拼装新镜像，凑满一个扇区后与 flash 中现有内容比较，只擦写有变化的扇区
+class DeltaSectorWriter {
+public:
+    DeltaSectorWriter(const esp_partition_t* partition, size_t sector_size, size_t image_size)
+        : partition_(partition), sector_size_(sector_size), image_size_(image_size),
+          rewritten_((image_size + sector_size - 1) / sector_size, false) {
+        sector_ = (uint8_t*)malloc(sector_size);
+        compare_ = (uint8_t*)malloc(sector_size);
+        header_ = (uint8_t*)malloc(sector_size);
+    }
+
+    ~DeltaSectorWriter() {
+        free(sector_);
+        free(compare_);
+        free(header_);
+    }
+
+    bool valid() const { return sector_ != nullptr && compare_ != nullptr && header_ != nullptr; }
+    size_t position() const { return position_; }
+    size_t sectors_erased() const { return sectors_erased_; }
+
+    // 第一个扇区先擦除、最后写入，更新过程中镜像不会被误认为有效
+    bool Begin() {
+        esp_err_t err = esp_partition_erase_range(partition_, 0, sector_size_);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to erase assets header: %s", esp_err_to_name(err));
+            return false;
+        }
+        rewritten_[0] = true;
+        sectors_erased_++;
+        return true;
+    }
+
+    bool IsRewritten(size_t offset, size_t length) const {
+        for (size_t s = offset / sector_size_; s < rewritten_.size() && s * sector_size_ < offset + length; s++) {
+            if (rewritten_[s]) {
+                return true;
+            }
+        }
         return false;
     }
-    auto data = (const char*)(mmap_root_ + asset->second.offset);
+
+    bool Append(const uint8_t* data, size_t length) {
+        while (length > 0) {
+            size_t fill = position_ % sector_size_;
+            size_t n = std::min(length, sector_size_ - fill);
+            memcpy(sector_ + fill, data, n);
+            position_ += n;
+            data += n;
+            length -= n;
+            if (position_ % sector_size_ == 0 || position_ == image_size_) {
+                if (!FlushSector()) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool Finish() {
+        if (position_ != image_size_) {
+            ESP_LOGE(TAG, "Delta image size mismatch (%u/%u)", position_, image_size_);
+            return false;
+        }
+        esp_err_t err = esp_partition_write(partition_, 0, header_, std::min(sector_size_, image_size_));
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write assets header: %s", esp_err_to_name(err));
+            return false;
+        }
+        return true;
+    }
+
+private:
+    const esp_partition_t* partition_;
+    size_t sector_size_;
+    size_t image_size_;
+    std::vector<bool> rewritten_;
+    uint8_t* sector_ = nullptr;
+    uint8_t* compare_ = nullptr;
+    uint8_t* header_ = nullptr;
+    size_t position_ = 0;
+    size_t sectors_erased_ = 0;
+
+    bool FlushSector() {
+        size_t index = (position_ - 1) / sector_size_;
+        size_t offset = index * sector_size_;
+        size_t length = position_ - offset;
+        if (index == 0) {
+            memcpy(header_, sector_, length);
+            return true;
+        }
+
+        esp_err_t err = esp_partition_read(partition_, offset, compare_, length);
+        if (err == ESP_OK && memcmp(compare_, sector_, length) == 0) {
+            return true;
+        }
+
+        err = esp_partition_erase_range(partition_, offset, sector_size_);
+        if (err == ESP_OK) {
+            err = esp_partition_write(partition_, offset, sector_, length);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to rewrite sector %u: %s", index, esp_err_to_name(err));
+            return false;
+        }
+        rewritten_[index] = true;
+        sectors_erased_++;
+        return true;
+    }
+};
+
+struct DeltaPiece {
+    size_t offset;      // 新镜像中的偏移
+    size_t length;
+    int64_t source;     // 旧镜像中的偏移，-1 表示需要下载
+};
+
+}  // namespace
+
+bool Assets::DownloadDelta(const std::string& url, std::function<void(int progress, size_t speed)> progress_callback) {
+    if (directory_ == nullptr) {
+        return false;
+    }
+
+    // 清单与镜像放在一起：assets.bin -> assets.bin.manifest.json
+    std::string manifest_url = url;
+    size_t query_pos = manifest_url.find('?');
+    manifest_url.insert(query_pos == std::string::npos ? manifest_url.size() : query_pos, ".manifest.json");
+
+    auto network = Board::GetInstance().GetNetwork();
+    auto http = network->CreateHttp(0);
+    if (!http->Open("GET", manifest_url) || http->GetStatusCode() != 200) {
+        ESP_LOGI(TAG, "No delta manifest at %s, use full download", manifest_url.c_str());
+        return false;
+    }
+    std::string manifest_data = http->ReadAll();
+    http->Close();
+
+    cJSON* root = cJSON_Parse(manifest_data.c_str());
+    manifest_data.clear();
+    if (root == nullptr) {
+        ESP_LOGE(TAG, "Failed to parse delta manifest");
+        return false;
+    }
+    cJSON* version = cJSON_GetObjectItem(root, "version");
+    cJSON* image_size_json = cJSON_GetObjectItem(root, "image_size");
+    cJSON* data_offset_json = cJSON_GetObjectItem(root, "data_offset");
+    cJSON* assets_json = cJSON_GetObjectItem(root, "assets");
+    if (!cJSON_IsNumber(version) || version->valueint != 2 || !cJSON_IsNumber(image_size_json) ||
+        !cJSON_IsNumber(data_offset_json) || !cJSON_IsArray(assets_json)) {
+        ESP_LOGE(TAG, "Unsupported delta manifest");
+        cJSON_Delete(root);
+        return false;
+    }
+
+    // 对比新旧目录：名称、大小和 CRC32 都相同的资源从本地复制，其余下载
+    size_t image_size = image_size_json->valueint;
+    size_t new_data_offset = data_offset_json->valueint;
+    std::vector<DeltaPiece> pieces;
+    pieces.push_back(DeltaPiece{0, new_data_offset, -1});
+    size_t remote_bytes = new_data_offset;
+    bool plan_valid = true;
+    cJSON* item = nullptr;
+    cJSON_ArrayForEach(item, assets_json) {
+        cJSON* name = cJSON_GetObjectItem(item, "name");
+        cJSON* offset = cJSON_GetObjectItem(item, "offset");
+        cJSON* size = cJSON_GetObjectItem(item, "size");
+        cJSON* crc32 = cJSON_GetObjectItem(item, "crc32");
+        if (!cJSON_IsString(name) || !cJSON_IsNumber(offset) || !cJSON_IsNumber(size) || !cJSON_IsNumber(crc32)) {
+            plan_valid = false;
+            break;
+        }
+        DeltaPiece piece = {
+            .offset = new_data_offset + (size_t)offset->valuedouble,
+            .length = (size_t)size->valuedouble + 2,
+            .source = -1,
+        };
+        if (piece.offset != pieces.back().offset + pieces.back().length) {
+            plan_valid = false;
+            break;
+        }
+        auto entry = FindEntryV2(name->valuestring);
+        if (entry != nullptr && entry->asset_size == (uint32_t)size->valuedouble &&
+            entry->asset_crc32 == (uint32_t)crc32->valuedouble) {
+            piece.source = data_offset_ + entry->asset_offset;
+        } else {
+            remote_bytes += piece.length;
+        }
+        pieces.push_back(piece);
+    }
+    cJSON_Delete(root);
+
+    if (!plan_valid || pieces.back().offset + pieces.back().length != image_size) {
+        ESP_LOGE(TAG, "Invalid delta manifest");
+        return false;
+    }
+
+    int active_slot = GetActiveSlot();
+    int target_slot = FindSlotPartition(1) != nullptr ? 1 - active_slot : active_slot;
+    auto target = FindSlotPartition(target_slot);
+    bool in_place = target_slot == active_slot;
+    if (target == nullptr || image_size > target->size) {
+        return false;
+    }
+    // 变化太大时整包下载更快（流水线写入，且没有额外的 Range 请求）
+    if (remote_bytes * 10 > image_size * 7) {
+        ESP_LOGI(TAG, "Delta is %u of %u bytes, use full download", remote_bytes, image_size);
+        return false;
+    }
+    ESP_LOGI(TAG, "Delta update to slot %d (%s): %u of %u bytes to download",
+        target_slot, target->label, remote_bytes, image_size);
+
+    const esp_partition_t* source = partition_;
+    if (in_place) {
+        if (mmap_handle_ != 0) {
+            esp_partition_munmap(mmap_handle_);
+            mmap_handle_ = 0;
+            mmap_root_ = nullptr;
+        }
+        checksum_valid_ = false;
+        assets_.clear();
+        directory_ = nullptr;
+        directory_count_ = 0;
+        entry_states_.clear();
+        // 更新中断时下次启动重新下载
+        Settings settings("assets", true);
+        settings.SetString("download_url", url);
+    }
+
+    const size_t SECTOR_SIZE = esp_partition_get_main_flash_sector_size();
+    DeltaSectorWriter writer(target, SECTOR_SIZE, image_size);
+    auto buffer = (uint8_t*)malloc(SECTOR_SIZE);
+    bool success = buffer != nullptr && writer.valid() && writer.Begin();
+
+    auto start_time = esp_timer_get_time();
+    auto last_calc_time = start_time;
+    size_t downloaded = 0, last_downloaded = 0, copied = 0;
+    auto report_progress = [&]() {
+        auto now = esp_timer_get_time();
+        if (now - last_calc_time >= 1000000) {
+            size_t progress = writer.position() * 100 / image_size;
+            size_t speed = (downloaded - last_downloaded) * 1000000 / (now - last_calc_time);
+            if (progress_callback) {
+                progress_callback(progress, speed);
+            }
+            last_calc_time = now;
+            last_downloaded = downloaded;
+        }
+    };
+
+    for (size_t i = 0; success && i < pieces.size();) {
+        auto& piece = pieces[i];
+        // 原地更新时，源数据所在扇区可能已被改写或即将被本次复制覆盖，这种资源改为下载
+        bool local = piece.source >= 0;
+        if (local && in_place) {
+            bool moves_up = (size_t)piece.source < piece.offset;
+            if (writer.IsRewritten(piece.source, piece.length) ||
+                (moves_up && piece.source + piece.length > piece.offset / SECTOR_SIZE * SECTOR_SIZE)) {
+                local = false;
+            }
+        }
+
+        if (local) {
+            for (size_t pos = 0; success && pos < piece.length; pos += SECTOR_SIZE) {
+                size_t n = std::min(SECTOR_SIZE, piece.length - pos);
+                success = esp_partition_read(source, piece.source + pos, buffer, n) == ESP_OK && writer.Append(buffer, n);
+            }
+            copied += piece.length;
+            report_progress();
+            i++;
+            continue;
+        }
+
+        // 合并连续需要下载的资源为一个 Range 请求
+        size_t j = i + 1;
+        if (piece.source < 0) {
+            while (j < pieces.size() && pieces[j].source < 0) {
+                j++;
+            }
+        }
+        size_t range_start = piece.offset;
+        size_t range_end = pieces[j - 1].offset + pieces[j - 1].length;
+        http = network->CreateHttp(0);
+        http->SetHeader("Range", "bytes=" + std::to_string(range_start) + "-" + std::to_string(range_end - 1));
+        if (!http->Open("GET", url) || http->GetStatusCode() != 206) {
+            ESP_LOGE(TAG, "Failed to get range %u-%u, status code: %d", range_start, range_end, http->GetStatusCode());
+            success = false;
+            break;
+        }
+        size_t remaining = range_end - range_start;
+        while (success && remaining > 0) {
+            int ret = http->Read((char*)buffer, std::min(SECTOR_SIZE, remaining));
+            if (ret <= 0) {
+                ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
+                success = false;
+                break;
+            }
+            success = writer.Append(buffer, ret);
+            remaining -= ret;
+            downloaded += ret;
+            report_progress();
+        }
+        http->Close();
+        i = j;
+    }
+
+    success = success && writer.Finish();
+    free(buffer);
+
+    auto elapsed_us = esp_timer_get_time() - start_time;
+    ESP_LOGI(TAG, "Delta update %s in %d ms: downloaded %u bytes, copied %u bytes, image %u bytes, sectors erased: %u",
+        success ? "completed" : "failed", int(elapsed_us / 1000), downloaded, copied, image_size, writer.sectors_erased());
+
+    if (success && !VerifyPartitionImage(target, image_size)) {
+        esp_partition_erase_range(target, 0, SECTOR_SIZE);
+        success = false;
+    }
+
+    if (in_place) {
+        if (success) {
+            Settings settings("assets", true);
+            settings.EraseKey("download_url");
+        }
+        InitializePartition();
+        return success;
+    }
+
+    if (success) {
+        if (mmap_handle_ != 0) {
+            esp_partition_munmap(mmap_handle_);
+            mmap_handle_ = 0;
+            mmap_root_ = nullptr;
+        }
+        Settings settings("assets", true);
+        settings.SetInt("slot", target_slot);
+        InitializePartition();
+    }
+    return success;
+}
+
+bool Assets::Download(std::string url, std::function<void(int progress, size_t speed)> progress_callback) {
+    ESP_LOGI(TAG, "Downloading new version of assets from %s", url.c_str());
+    // 断点续传中的整包下载优先继续
+    if (resumable_download_url() != url && DownloadDelta(url, progress_callback)) {
+        return true;
+    }
+    return DownloadFull(url, progress_callback);
+}
+
+bool Assets::GetAssetData(const std::string& name, void*& ptr, size_t& size) {
+    size_t offset = 0;
+    if (directory_ != nullptr) {
+        auto entry = FindEntryV2(name);
+        if (entry == nullptr || !VerifyEntryV2(entry)) {
+            return false;
+        }
+        offset = data_offset_ + entry->asset_offset;
+        size = entry->asset_size;
+    } else {
+        auto asset = assets_.find(name);
+        if (asset == assets_.end()) {
+            return false;
+        }
+        offset = asset->second.offset;
+        size = asset->second.size;
+    }
+
+    auto data = (const char*)(mmap_root_ + offset);
     if (data[0] != 'Z' || data[1] != 'Z') {
         ESP_LOGE(TAG, "The asset %s is not valid with magic %02x%02x", name.c_str(), data[0], data[1]);
         return false;
     }
 
     ptr = static_cast<void*>(const_cast<char*>(data + 2));
-    size = asset->second.size;
     return true;
 }
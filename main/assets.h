@@ -3,6 +3,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 #include <functional>
 
 #include <cJSON.h>
@@ -15,6 +16,8 @@ struct Asset {
     size_t offset;
 };
 
+struct mmap_assets_entry_v2;
+
 class Assets {
 public:
     static Assets& GetInstance() {
@@ -30,6 +33,8 @@ public:
     inline bool partition_valid() const { return partition_valid_; }
     inline bool checksum_valid() const { return checksum_valid_; }
     inline std::string default_assets_url() const { return default_assets_url_; }
+    // 上次被中断、可以断点续传的下载地址
+    std::string resumable_download_url() const;
 
 private:
     Assets();
@@ -37,7 +42,18 @@ private:
     Assets& operator=(const Assets&) = delete;
 
     bool InitializePartition();
+    bool InitializeDirectoryV1();
+    bool InitializeDirectoryV2();
+    const mmap_assets_entry_v2* FindEntryV2(const std::string& name) const;
+    bool VerifyEntryV2(const mmap_assets_entry_v2* entry);
     uint32_t CalculateChecksum(const char* data, uint32_t length);
+    static const esp_partition_t* FindSlotPartition(int slot);
+    static int GetActiveSlot();
+    static void ClearResumeState();
+    bool VerifyPartitionImage(const esp_partition_t* partition, size_t image_size);
+    bool DownloadFull(const std::string& url, std::function<void(int progress, size_t speed)> progress_callback);
+    bool DownloadDelta(const std::string& url, std::function<void(int progress, size_t speed)> progress_callback);
+    bool DownloadHeaderSector(const std::string& url, uint8_t* buffer, size_t length);
 
     const esp_partition_t* partition_ = nullptr;
     esp_partition_mmap_handle_t mmap_handle_ = 0;
@@ -47,6 +63,13 @@ private:
     std::string default_assets_url_;
     srmodel_list_t* models_list_ = nullptr;
     std::map<std::string, Asset> assets_;
+
+    // v2: 目录直接指向 mmap 区域，按名称哈希排序，资源 CRC32 在首次访问时校验
+    uint32_t format_version_ = 0;
+    const mmap_assets_entry_v2* directory_ = nullptr;
+    uint32_t directory_count_ = 0;
+    size_t data_offset_ = 0;
+    std::vector<uint8_t> entry_states_;
 };
 
 #endif
@@ -0,0 +1,75 @@
+#include "audio_capture_ring.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "AudioCaptureRing"
+
+AudioCaptureRing::~AudioCaptureRing() {
+    heap_caps_free(buffer_);
+}
+
+bool AudioCaptureRing::Configure(size_t capacity_frames, int channels, uint32_t caps) {
+    heap_caps_free(buffer_);
+    buffer_ = (int16_t*)heap_caps_calloc(capacity_frames * channels, sizeof(int16_t), caps);
+    capacity_ = buffer_ != nullptr ? capacity_frames : 0;
+    channels_ = channels;
+    write_position_ = 0;
+    if (buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u frames", capacity_frames);
+        return false;
+    }
+    return true;
+}
+
+void AudioCaptureRing::Write(const int16_t* data, size_t frames) {
+    if (capacity_ == 0) {
+        return;
+    }
+    // 单次写入超过容量时只保留最新的部分
+    if (frames > capacity_) {
+        data += (frames - capacity_) * channels_;
+        write_position_ += frames - capacity_;
+        frames = capacity_;
+    }
+    size_t offset = write_position_ % capacity_;
+    size_t first = std::min(frames, capacity_ - offset);
+    memcpy(&buffer_[offset * channels_], data, first * channels_ * sizeof(int16_t));
+    if (frames > first) {
+        memcpy(buffer_, data + first * channels_, (frames - first) * channels_ * sizeof(int16_t));
+    }
+    write_position_ += frames;
+}
+
+void AudioCaptureRing::Attach(Reader& reader, uint64_t position) {
+    reader.position = std::max(position, oldest_position());
+    reader.attached = true;
+}
+
+size_t AudioCaptureRing::Available(Reader& reader) {
+    if (!reader.attached || reader.position >= write_position_) {
+        return 0;
+    }
+    if (reader.position < oldest_position()) {
+        ESP_LOGW(TAG, "Reader overrun, %llu frames lost", oldest_position() - reader.position);
+        reader.position = oldest_position();
+        reader.overruns++;
+    }
+    return write_position_ - reader.position;
+}
+
+bool AudioCaptureRing::Read(Reader& reader, std::vector<int16_t>& data, size_t frames) {
+    if (frames == 0 || Available(reader) < frames) {
+        return false;
+    }
+    data.resize(frames * channels_);
+    size_t offset = reader.position % capacity_;
+    size_t first = std::min(frames, capacity_ - offset);
+    memcpy(data.data(), &buffer_[offset * channels_], first * channels_ * sizeof(int16_t));
+    if (frames > first) {
+        memcpy(data.data() + first * channels_, buffer_, (frames - first) * channels_ * sizeof(int16_t));
+    }
+    reader.position += frames;
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef AUDIO_CAPTURE_RING_H
+#define AUDIO_CAPTURE_RING_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <esp_heap_caps.h>
+
+/*
+ * Ring buffer of captured (interleaved, 16 kHz) microphone frames shared by several consumers.
+ *
+ * The input task writes every I2S read once, and each consumer (wake word, audio processor,
+ * audio testing) keeps its own read cursor and takes chunks of its own feed size. A consumer
+ * that is attached while others are running starts from the write position, or from any
+ * position still held by the ring, so state transitions neither drop nor repeat audio.
+ *
+ * Positions are absolute frame counts. The ring has no locking, callers that write and read
+ * from different tasks must hold their own lock.
+ */
+class AudioCaptureRing {
+public:
+    struct Reader {
+        uint64_t position = 0;
+        bool attached = false;
+        uint32_t overruns = 0;      // Times the reader fell behind and lost the oldest frames
+    };
+
+    AudioCaptureRing() = default;
+    ~AudioCaptureRing();
+    AudioCaptureRing(const AudioCaptureRing&) = delete;
+    AudioCaptureRing& operator=(const AudioCaptureRing&) = delete;
+
+    bool Configure(size_t capacity_frames, int channels, uint32_t caps = MALLOC_CAP_DEFAULT);
+    int channels() const { return channels_; }
+    size_t capacity() const { return capacity_; }
+    uint64_t write_position() const { return write_position_; }
+    uint64_t oldest_position() const { return write_position_ > capacity_ ? write_position_ - capacity_ : 0; }
+
+    void Write(const int16_t* data, size_t frames);
+
+    // Attach the reader at the given position, clamped to the frames still in the ring.
+    // A position after the write position skips the frames in between.
+    void Attach(Reader& reader, uint64_t position);
+    void Detach(Reader& reader) { reader.attached = false; }
+
+    size_t Available(Reader& reader);
+    bool Read(Reader& reader, std::vector<int16_t>& data, size_t frames);
+
+private:
+    int16_t* buffer_ = nullptr;
+    size_t capacity_ = 0;
+    int channels_ = 1;
+    uint64_t write_position_ = 0;
+};
+
+#endif // AUDIO_CAPTURE_RING_H
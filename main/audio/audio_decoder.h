@@ -0,0 +1,26 @@
+#ifndef AUDIO_DECODER_H
+#define AUDIO_DECODER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Decoder for byte-stream formats played as they are fetched (MP3, WAV / PCM).
+ *
+ * Unlike Opus packets, chunks may split frames anywhere, so the decoder keeps the partial frame
+ * until the next chunk. A new stream is found from its own header (ID3 / frame sync, RIFF),
+ * Reset() drops everything that is buffered.
+ */
+class AudioDecoder {
+public:
+    virtual ~AudioDecoder() = default;
+
+    // Decode a chunk of the stream and append mono 16-bit PCM to pcm
+    virtual bool Decode(const uint8_t* data, size_t size, std::vector<int16_t>& pcm) = 0;
+    virtual void Reset() = 0;
+    // Sample rate of the decoded PCM, 0 until the stream header is parsed
+    virtual int sample_rate() const = 0;
+};
+
+#endif // AUDIO_DECODER_H
@@ -21,6 +21,8 @@ public:
     virtual void OnVadStateChange(std::function<void(bool speaking)> callback) = 0;
     virtual size_t GetFeedSize() = 0;
     virtual void EnableDeviceAec(bool enable) = 0;
+    // Give an output buffer back once it is consumed, processors may reuse it for later frames
+    virtual void Recycle(std::vector<int16_t>&& buffer) {}
 };
 
 #endif
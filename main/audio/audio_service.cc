@@ -1,6 +1,8 @@
 #include "audio_service.h"
 #include <esp_log.h>
 #include <cstring>
+#include <cstdlib>
+#include <algorithm>
 
 #if CONFIG_USE_AUDIO_PROCESSOR
 #include "processors/afe_audio_processor.h"
@@ -36,12 +38,25 @@ void AudioService::Initialize(AudioCodec* codec) {
     /* Setup the audio codec */
     opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
     opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_->SetComplexity(0);
+    opus_tuner_.Configure(CONFIG_OPUS_ENCODER_COMPLEXITY_MIN, CONFIG_OPUS_ENCODER_COMPLEXITY_MAX,
+        CONFIG_OPUS_ENCODER_CPU_BUDGET, OPUS_TUNER_QUEUE_LIMIT);
+    opus_encoder_->SetComplexity(opus_tuner_.complexity());
 
     if (codec->input_sample_rate() != 16000) {
         input_resampler_.Configure(codec->input_sample_rate(), 16000);
         reference_resampler_.Configure(codec->input_sample_rate(), 16000);
     }
+    capture_ring_.Configure(AUDIO_CAPTURE_RING_MS * 16, codec->input_channels());
+    playback_clock_.Configure(codec->output_sample_rate(), AUDIO_CODEC_DMA_DESC_NUM * AUDIO_CODEC_DMA_FRAME_NUM,
+        AUDIO_CODEC_DMA_FRAME_NUM);
+#if CONFIG_USE_WAKE_WORD_PRE_GATE
+    wake_word_gate_.Configure(16000, CONFIG_WAKE_WORD_PRE_GATE_MARGIN_DB, WAKE_WORD_GATE_HANGOVER_MS);
+#endif
+    if (CONFIG_AUDIO_PREROLL_MS > 0) {
+        // 唤醒后连接服务器期间的录音放在 PSRAM，长度有上限
+        uint32_t caps = heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0 ? MALLOC_CAP_SPIRAM : MALLOC_CAP_DEFAULT;
+        preroll_ring_.Configure(CONFIG_AUDIO_PREROLL_MS * 16, 1, caps);
+    }
 
 #if CONFIG_USE_AUDIO_PROCESSOR
     audio_processor_ = std::make_unique<AfeAudioProcessor>();
@@ -50,11 +65,29 @@ void AudioService::Initialize(AudioCodec* codec) {
 #endif
 
     audio_processor_->OnOutput([this](std::vector<int16_t>&& data) {
+        {
+            // 预录音未发完之前，新的音频也排在后面，保证上传顺序
+            std::unique_lock<std::mutex> lock(audio_queue_mutex_);
+            if (preroll_active_ || preroll_ring_.Available(preroll_reader_) > 0) {
+                preroll_ring_.Write(data.data(), data.size());
+                preroll_write_time_ = esp_timer_get_time();
+                audio_queue_cv_.notify_all();
+                lock.unlock();
+                audio_processor_->Recycle(std::move(data));
+                return;
+            }
+        }
         PushTaskToEncodeQueue(kAudioTaskTypeEncodeToSendQueue, std::move(data));
     });
 
     audio_processor_->OnVadStateChange([this](bool speaking) {
         voice_detected_ = speaking;
+#if CONFIG_AUDIO_DEBUG_REPLAY
+        if (audio_debugger_) {
+            audio_debugger_->ReportEvent("vad", speaking ? "1" : "0");
+        }
+        return;
+#endif
         if (callbacks_.on_vad_change) {
             callbacks_.on_vad_change(speaking);
         }
@@ -133,6 +166,29 @@ void AudioService::Stop() {
 }
 
 bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples) {
+#if CONFIG_AUDIO_DEBUG_REPLAY
+    // 评测模式：用主机回放的标注音频代替麦克风
+    if (audio_debugger_ == nullptr) {
+        audio_debugger_ = std::make_unique<AudioDebugger>();
+    }
+    switch (audio_debugger_->ReadReplay(data, samples, codec_->input_channels(), replay_feed_us_)) {
+    case AudioDebugger::kReplayAudio:
+        last_input_time_ = std::chrono::steady_clock::now();
+        debug_statistics_.input_count++;
+        return true;
+    case AudioDebugger::kReplayStartWakeWord:
+        EnableVoiceProcessing(false);
+        EnableWakeWordDetection(true);
+        return false;
+    case AudioDebugger::kReplayStartVad:
+        EnableWakeWordDetection(false);
+        EnableVoiceProcessing(true, false);
+        return false;
+    default:
+        break;
+    }
+#endif
+
     if (!codec_->input_enabled()) {
         esp_timer_stop(audio_power_timer_);
         esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
@@ -145,25 +201,26 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
             return false;
         }
         if (codec_->input_channels() == 2) {
-            auto mic_channel = std::vector<int16_t>(data.size() / 2);
-            auto reference_channel = std::vector<int16_t>(data.size() / 2);
-            for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
-                mic_channel[i] = data[j];
-                reference_channel[i] = data[j + 1];
+            // 拆分声道后各自原地重采样，缓冲区在多次读取间复用
+            size_t frames = data.size() / 2;
+            size_t capacity = std::max<size_t>(frames, input_resampler_.GetOutputSamples(frames));
+            mic_buffer_.resize(capacity);
+            reference_buffer_.resize(capacity);
+            for (size_t i = 0, j = 0; i < frames; ++i, j += 2) {
+                mic_buffer_[i] = data[j];
+                reference_buffer_[i] = data[j + 1];
             }
-            auto resampled_mic = std::vector<int16_t>(input_resampler_.GetOutputSamples(mic_channel.size()));
-            auto resampled_reference = std::vector<int16_t>(reference_resampler_.GetOutputSamples(reference_channel.size()));
-            input_resampler_.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
-            reference_resampler_.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
-            data.resize(resampled_mic.size() + resampled_reference.size());
-            for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
-                data[j] = resampled_mic[i];
-                data[j + 1] = resampled_reference[i];
+            int resampled = input_resampler_.Process(mic_buffer_.data(), frames, mic_buffer_.data());
+            reference_resampler_.Process(reference_buffer_.data(), frames, reference_buffer_.data());
+            data.resize(resampled * 2);
+            for (int i = 0, j = 0; i < resampled; ++i, j += 2) {
+                data[j] = mic_buffer_[i];
+                data[j + 1] = reference_buffer_[i];
             }
         } else {
-            auto resampled = std::vector<int16_t>(input_resampler_.GetOutputSamples(data.size()));
-            input_resampler_.Process(data.data(), data.size(), resampled.data());
-            data = std::move(resampled);
+            size_t frames = data.size();
+            data.resize(std::max<size_t>(frames, input_resampler_.GetOutputSamples(frames)));
+            data.resize(input_resampler_.Process(data.data(), frames, data.data()));
         }
     } else {
         data.resize(samples * codec_->input_channels());
@@ -176,7 +233,7 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
     last_input_time_ = std::chrono::steady_clock::now();
     debug_statistics_.input_count++;
 
-#if CONFIG_USE_AUDIO_DEBUGGER
+#if CONFIG_USE_AUDIO_DEBUGGER && !CONFIG_AUDIO_DEBUG_REPLAY
     // 音频调试：发送原始音频数据
     if (audio_debugger_ == nullptr) {
         audio_debugger_ = std::make_unique<AudioDebugger>();
@@ -188,6 +245,20 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
 }
 
 void AudioService::AudioInputTask() {
+    AudioCaptureRing::Reader testing_reader;
+    AudioCaptureRing::Reader wake_word_reader;
+    AudioCaptureRing::Reader processor_reader;
+    std::vector<int16_t> data;
+    std::vector<int16_t> chunk;
+
+    auto update_reader = [this](AudioCaptureRing::Reader& reader, bool running) {
+        if (running && !reader.attached) {
+            capture_ring_.Attach(reader, capture_ring_.write_position());
+        } else if (!running && reader.attached) {
+            capture_ring_.Detach(reader);
+        }
+    };
+
     while (true) {
         EventBits_t bits = xEventGroupWaitBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING |
             AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING,
@@ -196,108 +267,321 @@ void AudioService::AudioInputTask() {
         if (service_stopped_) {
             break;
         }
-        if (audio_input_need_warmup_) {
+
+        /* Every consumer reads the same capture from its own cursor */
+        update_reader(testing_reader, bits & AS_EVENT_AUDIO_TESTING_RUNNING);
+        update_reader(wake_word_reader, bits & AS_EVENT_WAKE_WORD_RUNNING);
+        update_reader(processor_reader, bits & AS_EVENT_AUDIO_PROCESSOR_RUNNING);
+        if (audio_input_need_warmup_ && (bits & AS_EVENT_AUDIO_PROCESSOR_RUNNING)) {
+            // 只让音频处理器跳过扬声器停止前的一小段录音，唤醒词等其他读者不受影响
             audio_input_need_warmup_ = false;
-            vTaskDelay(pdMS_TO_TICKS(120));
+            capture_ring_.Attach(processor_reader, capture_ring_.write_position() + AUDIO_INPUT_WARMUP_MS * 16);
+        }
+
+        int testing_size = OPUS_FRAME_DURATION_MS * 16000 / 1000;
+        int wake_word_size = wake_word_reader.attached ? wake_word_->GetFeedSize() : 0;
+        int processor_size = processor_reader.attached ? audio_processor_->GetFeedSize() : 0;
+
+        /* Read one chunk of the smallest feed size, larger consumers wait for enough frames */
+        int samples = 0;
+        for (int size : { testing_reader.attached ? testing_size : 0, wake_word_size, processor_size }) {
+            if (size > 0 && (samples == 0 || size < samples)) {
+                samples = size;
+            }
+        }
+        if (samples == 0) {
+            ESP_LOGE(TAG, "Should not be here, bits: %lx", bits);
+            break;
+        }
+        if (!ReadAudioData(data, 16000, samples)) {
             continue;
         }
+        capture_ring_.Write(data.data(), data.size() / capture_ring_.channels());
+
+        bool wake_word_gate_open = true;
+#if CONFIG_USE_WAKE_WORD_PRE_GATE
+        if (wake_word_reader.attached) {
+            wake_word_gate_open = UpdateWakeWordGate(data);
+            if (!wake_word_gate_open) {
+                // 门限关闭时不喂唤醒词，只保留一小段回看音频，打开时先喂这段，不丢失唤醒词的开头
+                uint64_t write_position = capture_ring_.write_position();
+                uint64_t lookback = WAKE_WORD_GATE_LOOKBACK_MS * 16;
+                capture_ring_.Attach(wake_word_reader, std::max(wake_word_reader.position,
+                    write_position > lookback ? write_position - lookback : 0));
+            }
+        }
+#endif
 
         /* Used for audio testing in NetworkConfiguring mode by clicking the BOOT button */
-        if (bits & AS_EVENT_AUDIO_TESTING_RUNNING) {
+        while (capture_ring_.Read(testing_reader, chunk, testing_size)) {
             if (audio_testing_queue_.size() >= AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS) {
                 ESP_LOGW(TAG, "Audio testing queue is full, stopping audio testing");
                 EnableAudioTesting(false);
-                continue;
+                capture_ring_.Detach(testing_reader);
+                break;
             }
-            std::vector<int16_t> data;
-            int samples = OPUS_FRAME_DURATION_MS * 16000 / 1000;
-            if (ReadAudioData(data, 16000, samples)) {
-                // If input channels is 2, we need to fetch the left channel data
-                if (codec_->input_channels() == 2) {
-                    auto mono_data = std::vector<int16_t>(data.size() / 2);
-                    for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-                        mono_data[i] = data[j];
-                    }
-                    data = std::move(mono_data);
+            // If input channels is 2, we need to fetch the left channel data
+            if (capture_ring_.channels() == 2) {
+                auto mono_data = std::vector<int16_t>(chunk.size() / 2);
+                for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
+                    mono_data[i] = chunk[j];
                 }
-                PushTaskToEncodeQueue(kAudioTaskTypeEncodeToTestingQueue, std::move(data));
-                continue;
+                chunk = std::move(mono_data);
             }
+            PushTaskToEncodeQueue(kAudioTaskTypeEncodeToTestingQueue, std::move(chunk));
         }
 
+#if CONFIG_AUDIO_DEBUG_REPLAY
+        int64_t feed_start = esp_timer_get_time();
+#endif
+
         /* Feed the wake word */
-        if (bits & AS_EVENT_WAKE_WORD_RUNNING) {
-            std::vector<int16_t> data;
-            int samples = wake_word_->GetFeedSize();
-            if (samples > 0) {
-                if (ReadAudioData(data, 16000, samples)) {
-                    wake_word_->Feed(data);
-                    continue;
-                }
-            }
+        while (wake_word_gate_open && capture_ring_.Read(wake_word_reader, chunk, wake_word_size)) {
+            wake_word_->Feed(chunk);
         }
 
         /* Feed the audio processor */
-        if (bits & AS_EVENT_AUDIO_PROCESSOR_RUNNING) {
-            std::vector<int16_t> data;
-            int samples = audio_processor_->GetFeedSize();
-            if (samples > 0) {
-                if (ReadAudioData(data, 16000, samples)) {
-                    audio_processor_->Feed(std::move(data));
-                    continue;
-                }
-            }
+        while (capture_ring_.Read(processor_reader, chunk, processor_size)) {
+            audio_processor_->Feed(std::move(chunk));
         }
 
-        ESP_LOGE(TAG, "Should not be here, bits: %lx", bits);
-        break;
+#if CONFIG_AUDIO_DEBUG_REPLAY
+        // 上报给主机，用于统计每块音频的处理耗时
+        replay_feed_us_ = esp_timer_get_time() - feed_start;
+#endif
     }
 
     ESP_LOGW(TAG, "Audio input task stopped");
 }
 
+bool AudioService::UpdateWakeWordGate(const std::vector<int16_t>& data) {
+    int channels = capture_ring_.channels();
+    bool was_open = wake_word_gate_.is_open();
+    bool open = wake_word_gate_.Process(data.data(), data.size() / channels, channels);
+#if CONFIG_AUDIO_DEBUG_REPLAY
+    if (open != was_open && audio_debugger_) {
+        audio_debugger_->ReportEvent("gate", open ? "1" : "0");
+    }
+#else
+    (void)was_open;
+#endif
+
+    auto now = esp_timer_get_time();
+    if (now - wake_word_gate_log_time_ >= WAKE_WORD_GATE_LOG_INTERVAL_MS * 1000LL) {
+        wake_word_gate_log_time_ = now;
+        auto stats = wake_word_gate_.TakeStats();
+        if (stats.chunks > 0) {
+            ESP_LOGI(TAG, "Wake word gate: inference skipped %lu%% of %lu chunks, %lu openings, noise floor %.1f dB",
+                (stats.chunks - stats.open_chunks) * 100 / stats.chunks, stats.chunks, stats.openings,
+                wake_word_gate_.noise_floor_db());
+        }
+    }
+    return open;
+}
+
 void AudioService::AudioOutputTask() {
+    int64_t last_output_time = 0;
+    int16_t last_sample = 0;
+    bool after_gap = true;
+
     while (true) {
         std::unique_lock<std::mutex> lock(audio_queue_mutex_);
+        bool starved = audio_playback_queue_.empty();
         audio_queue_cv_.wait(lock, [this]() { return !audio_playback_queue_.empty() || service_stopped_; });
         if (service_stopped_) {
             break;
         }
 
+#if CONFIG_USE_GAPLESS_TTS
+        if (tts_prebuffering_ && tts_active_ && !tts_stopping_) {
+            // 句子开始或欠载之后先缓冲一小段，再连续播放；服务器发完之后不会再有数据，直接播完
+            audio_queue_cv_.wait_for(lock, std::chrono::milliseconds(TTS_PREBUFFER_TIMEOUT_MS), [this]() {
+                return service_stopped_ || !tts_active_ || tts_stopping_ || GetBufferedPlaybackMs() >= CONFIG_TTS_PREBUFFER_MS;
+            });
+            if (service_stopped_) {
+                break;
+            }
+            tts_prebuffering_ = false;
+            if (audio_playback_queue_.empty()) {
+                continue;
+            }
+        }
+#endif
+
         auto task = std::move(audio_playback_queue_.front());
         audio_playback_queue_.pop_front();
         audio_queue_cv_.notify_all();
+
+        /* A frame that arrives after the speaker ran dry starts from silence */
+        int64_t now = esp_timer_get_time();
+        bool gap = starved && last_output_time > 0 && now - last_output_time > PLAYBACK_GAP_THRESHOLD_MS * 1000;
+        if (output_reset_) {
+            output_reset_ = false;
+            after_gap = true;
+        }
+        if (gap) {
+            after_gap = true;
+        }
+        if (tts_active_) {
+            UpdatePlaybackMetrics(gap ? (now - last_output_time) / 1000 : 0);
+        }
         lock.unlock();
 
+        bool smoothed = SmoothDiscontinuity(task->pcm, after_gap, last_sample);
+        if (tts_active_) {
+            std::lock_guard<std::mutex> metrics_lock(audio_queue_mutex_);
+            if (smoothed) {
+                tts_metrics_.crossfades++;
+            }
+            // 服务器发完之后，最后一帧出队时才结束统计
+            FinishTtsPlaybackIfDrainedLocked();
+        }
+        after_gap = false;
+        if (!task->pcm.empty()) {
+            last_sample = task->pcm.back();
+        }
+
         if (!codec_->output_enabled()) {
             esp_timer_stop(audio_power_timer_);
             esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
             codec_->EnableOutput(true);
         }
+        int64_t write_start_time = esp_timer_get_time();
         codec_->OutputData(task->pcm);
+        last_output_time = esp_timer_get_time();
 
         /* Update the last output time */
         last_output_time_ = std::chrono::steady_clock::now();
         debug_statistics_.playback_count++;
 
-#if CONFIG_USE_SERVER_AEC
-        /* Record the timestamp for server AEC */
-        if (task->timestamp > 0) {
-            lock.lock();
-            timestamp_queue_.push_back(task->timestamp);
+        /* Track when the frame is rendered, server AEC looks up the far-end timestamp from it */
+        lock.lock();
+        playback_clock_.OnOutput(task->timestamp, task->pcm.size(), write_start_time, last_output_time);
+    }
+
+    ESP_LOGW(TAG, "Audio output task stopped");
+}
+
+bool AudioService::SmoothDiscontinuity(std::vector<int16_t>& pcm, bool after_gap, int16_t last_sample) {
+    int fade_samples = std::min<int>(pcm.size(), codec_->output_sample_rate() * PLAYBACK_FADE_MS / 1000);
+    if (fade_samples <= 0) {
+        return false;
+    }
+    if (after_gap) {
+        // 从静音淡入，避免起始处的爆音
+        for (int i = 0; i < fade_samples; i++) {
+            pcm[i] = pcm[i] * i / fade_samples;
+        }
+    } else if (std::abs(pcm[0] - last_sample) > PLAYBACK_DISCONTINUITY_THRESHOLD) {
+        // 相邻两帧不连续（解码器被重置或音源切换），从上一帧的末尾交叉淡入
+        for (int i = 0; i < fade_samples; i++) {
+            pcm[i] = (last_sample * (fade_samples - i) + pcm[i] * i) / fade_samples;
+        }
+        return true;
+    }
+    return false;
+}
+
+int AudioService::GetBufferedPlaybackMs() {
+    int ms = 0;
+    for (auto& task : audio_playback_queue_) {
+        ms += task->pcm.size() * 1000 / codec_->output_sample_rate();
+    }
+    for (auto& packet : audio_decode_queue_) {
+        ms += packet->frame_duration;
+    }
+    return ms;
+}
+
+void AudioService::UpdatePlaybackMetrics(int gap_ms) {
+    // 判断这一帧之前的空隙是否正好落在句子边界上
+    uint32_t frame = debug_statistics_.playback_count;
+    bool at_boundary = false;
+    while (!sentence_boundaries_.empty() && sentence_boundaries_.front() <= frame + 1) {
+        at_boundary = at_boundary || sentence_boundaries_.front() + 1 >= frame;
+        sentence_boundaries_.pop_front();
+    }
+    // 第一帧之前的等待是首包延迟，不算空隙
+    if (tts_metrics_.frames++ == 0) {
+        return;
+    }
+    if (gap_ms > 0) {
+        if (at_boundary) {
+            tts_metrics_.sentence_gaps++;
+            tts_metrics_.sentence_gap_ms += gap_ms;
+            tts_metrics_.max_sentence_gap_ms = std::max<uint32_t>(tts_metrics_.max_sentence_gap_ms, gap_ms);
+        } else {
+            tts_metrics_.underruns++;
+            tts_metrics_.underrun_ms += gap_ms;
         }
+#if CONFIG_USE_GAPLESS_TTS
+        tts_prebuffering_ = true;
 #endif
+    } else if (at_boundary) {
+        tts_metrics_.gapless_sentences++;
     }
+}
 
-    ESP_LOGW(TAG, "Audio output task stopped");
+void AudioService::StartTtsPlayback() {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    if (tts_active_ && !tts_stopping_) {
+        return;
+    }
+    if (tts_stopping_) {
+        // 上一段回复还没播完，先结束它的统计
+        FinishTtsPlaybackLocked();
+    }
+    tts_active_ = true;
+    tts_prebuffering_ = true;
+    tts_metrics_ = TtsPlaybackMetrics();
+    sentence_boundaries_.clear();
+}
+
+void AudioService::MarkTtsSentenceStart() {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    if (!tts_active_) {
+        return;
+    }
+    // 新句子的第一帧排在当前所有待播放音频之后
+    sentence_boundaries_.push_back(debug_statistics_.playback_count + audio_playback_queue_.size() + audio_decode_queue_.size());
+    tts_metrics_.sentences++;
+}
+
+void AudioService::StopTtsPlayback() {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    if (!tts_active_ || tts_stopping_) {
+        return;
+    }
+    // 服务器发完时解码队列和播放队列里还有音频，等它们播完再结束统计
+    tts_stopping_ = true;
+    audio_queue_cv_.notify_all();
+    FinishTtsPlaybackIfDrainedLocked();
+}
+
+void AudioService::FinishTtsPlaybackIfDrainedLocked() {
+    if (tts_stopping_ && !decoding_ && audio_decode_queue_.empty() && audio_playback_queue_.empty()) {
+        FinishTtsPlaybackLocked();
+    }
+}
+
+void AudioService::FinishTtsPlaybackLocked() {
+    tts_active_ = false;
+    tts_stopping_ = false;
+    tts_prebuffering_ = false;
+    auto& m = tts_metrics_;
+    ESP_LOGI(TAG, "TTS playback: output latency %d ms, %lu frames, %lu sentences, %lu gapless, %lu gaps (total %lu ms, max %lu ms), %lu underruns (%lu ms), %lu crossfades",
+        playback_clock_.output_latency_ms(), m.frames, m.sentences, m.gapless_sentences, m.sentence_gaps, m.sentence_gap_ms, m.max_sentence_gap_ms,
+        m.underruns, m.underrun_ms, m.crossfades);
 }
 
 void AudioService::OpusCodecTask() {
     while (true) {
         std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() {
+        const size_t preroll_frame = OPUS_FRAME_DURATION_MS * 16;
+        audio_queue_cv_.wait(lock, [this, preroll_frame]() {
             return service_stopped_ ||
                 (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
+                (preroll_ring_.Available(preroll_reader_) >= preroll_frame && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
                 (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
         });
         if (service_stopped_) {
@@ -308,6 +592,7 @@ void AudioService::OpusCodecTask() {
         if (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) {
             auto packet = std::move(audio_decode_queue_.front());
             audio_decode_queue_.pop_front();
+            decoding_ = true;
             audio_queue_cv_.notify_all();
             lock.unlock();
 
@@ -315,30 +600,61 @@ void AudioService::OpusCodecTask() {
             task->type = kAudioTaskTypeDecodeToPlaybackQueue;
             task->timestamp = packet->timestamp;
 
-            SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
-            if (opus_decoder_->Decode(std::move(packet->payload), task->pcm)) {
-                // Resample if the sample rate is different
-                if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
-                    int target_size = output_resampler_.GetOutputSamples(task->pcm.size());
-                    std::vector<int16_t> resampled(target_size);
-                    output_resampler_.Process(task->pcm.data(), task->pcm.size(), resampled.data());
-                    task->pcm = std::move(resampled);
+            bool decoded;
+            if (packet->format != kAudioStreamFormatOpus) {
+                decoded = DecodeStreamPacket(*packet, task->pcm);
+            } else {
+                SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
+                int64_t decode_start = esp_timer_get_time();
+                bool resample = opus_decoder_->sample_rate() != codec_->output_sample_rate();
+                if (resample) {
+                    // 预留重采样后的长度，解码和重采样都在同一个缓冲区内完成
+                    int frame_samples = opus_decoder_->sample_rate() * opus_decoder_->duration_ms() / 1000;
+                    task->pcm.reserve(std::max(frame_samples, output_resampler_.GetOutputSamples(frame_samples)));
+                }
+                decoded = opus_decoder_->Decode(std::move(packet->payload), task->pcm);
+                if (decoded) {
+                    // Resample if the sample rate is different
+                    if (resample) {
+                        size_t samples = task->pcm.size();
+                        task->pcm.resize(std::max<size_t>(samples, output_resampler_.GetOutputSamples(samples)));
+                        task->pcm.resize(output_resampler_.Process(task->pcm.data(), samples, task->pcm.data()));
+                    }
+                    // 解码和重采样的耗时随服务器下发的采样率变化，一起计入编解码任务的负载
+                    opus_tuner_.OnFrameDecoded(esp_timer_get_time() - decode_start, opus_decoder_->duration_ms());
                 }
+            }
 
+            if (!decoded) {
+                ESP_LOGE(TAG, "Failed to decode audio");
+                lock.lock();
+            } else if (task->pcm.empty()) {
+                // 数据块不足一帧，等待下一块
                 lock.lock();
-                audio_playback_queue_.push_back(std::move(task));
-                audio_queue_cv_.notify_all();
             } else {
-                ESP_LOGE(TAG, "Failed to decode audio");
                 lock.lock();
+                audio_playback_queue_.push_back(std::move(task));
+                audio_queue_cv_.notify_all();
             }
+            decoding_ = false;
             debug_statistics_.decode_count++;
+            if (tts_active_) {
+                // 最后一个包没有解出完整的帧时，播放任务不会再被唤醒
+                FinishTtsPlaybackIfDrainedLocked();
+            }
         }
         
+        /* Encode the pre-roll audio before anything captured later */
+        if (preroll_ring_.Available(preroll_reader_) >= preroll_frame && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) {
+            EncodePrerollFrame(lock);
+            continue;
+        }
+
         /* Encode the audio to send queue */
         if (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) {
             auto task = std::move(audio_encode_queue_.front());
             audio_encode_queue_.pop_front();
+            size_t queue_depth = audio_send_queue_.size();
             audio_queue_cv_.notify_all();
             lock.unlock();
 
@@ -346,7 +662,12 @@ void AudioService::OpusCodecTask() {
             packet->frame_duration = OPUS_FRAME_DURATION_MS;
             packet->sample_rate = 16000;
             packet->timestamp = task->timestamp;
-            if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
+            bool encoded = EncodeFrame(std::move(task->pcm), packet->payload, queue_depth);
+            if (task->type == kAudioTaskTypeEncodeToSendQueue) {
+                // 处理器输出的缓冲区用完后归还，减少每帧的内存分配
+                audio_processor_->Recycle(std::move(task->pcm));
+            }
+            if (!encoded) {
                 ESP_LOGE(TAG, "Failed to encode audio");
                 continue;
             }
@@ -371,6 +692,151 @@ void AudioService::OpusCodecTask() {
     ESP_LOGW(TAG, "Opus codec task stopped");
 }
 
+void AudioService::EncodePrerollFrame(std::unique_lock<std::mutex>& lock) {
+    std::vector<int16_t> pcm;
+    // 这一帧之后还缓存着多少音频，据此倒推它的采集时间
+    size_t buffered_samples = preroll_ring_.Available(preroll_reader_);
+    preroll_ring_.Read(preroll_reader_, pcm, OPUS_FRAME_DURATION_MS * 16);
+    uint32_t timestamp = GetCaptureTimestamp(preroll_write_time_, buffered_samples);
+    // 预录音期间发送队列是有意积压的，不作为网络拥塞的依据
+    size_t queue_depth = preroll_active_ ? 0 : audio_send_queue_.size();
+    audio_queue_cv_.notify_all();
+    lock.unlock();
+
+    auto packet = std::make_unique<AudioStreamPacket>();
+    packet->frame_duration = OPUS_FRAME_DURATION_MS;
+    packet->sample_rate = 16000;
+    packet->timestamp = timestamp;
+    if (!EncodeFrame(std::move(pcm), packet->payload, queue_depth)) {
+        ESP_LOGE(TAG, "Failed to encode audio");
+        lock.lock();
+        return;
+    }
+    debug_statistics_.encode_count++;
+
+    lock.lock();
+    audio_send_queue_.push_back(std::move(packet));
+    bool flushed = !preroll_active_;
+    lock.unlock();
+    // 通道打开之前只编码不发送
+    if (flushed && callbacks_.on_send_queue_available) {
+        callbacks_.on_send_queue_available();
+    }
+    lock.lock();
+}
+
+uint32_t AudioService::GetCaptureTimestamp(int64_t output_time, size_t samples) {
+#if CONFIG_USE_SERVER_AEC
+    // 处理器在 output_time 输出的最后 samples 个采样，还要再往前推一个喂入块才是采集时间
+    int64_t capture_time = output_time - (int64_t)(samples + audio_processor_->GetFeedSize()) * 1000000 / 16000;
+    return playback_clock_.GetTimestampAt(capture_time);
+#else
+    return 0;
+#endif
+}
+
+bool AudioService::EncodeFrame(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus, size_t queue_depth) {
+    int64_t start = esp_timer_get_time();
+    if (!opus_encoder_->Encode(std::move(pcm), opus)) {
+        return false;
+    }
+    if (opus_tuner_.OnFrameEncoded(esp_timer_get_time() - start, OPUS_FRAME_DURATION_MS, opus.size(), queue_depth)) {
+        opus_encoder_->SetComplexity(opus_tuner_.complexity());
+    }
+
+    if (opus_tuner_.frames() >= OPUS_TUNER_LOG_FRAMES) {
+        auto metrics = opus_tuner_.TakeMetrics();
+        ESP_LOGI(TAG, "Opus encoder: complexity %d, encode avg %lu us max %lu us, codec load %lu%%, %lu bps, send queue max %lu, %lu changes",
+            metrics.complexity, metrics.encode_us_avg, metrics.encode_us_max, metrics.load_percent,
+            metrics.bitrate_bps, metrics.queue_depth_max, metrics.changes);
+    }
+    return true;
+}
+
+bool AudioService::DecodeStreamPacket(AudioStreamPacket& packet, std::vector<int16_t>& pcm) {
+    AudioDecoder* decoder;
+    if (packet.format == kAudioStreamFormatMp3) {
+#if CONFIG_USE_MP3_DECODER
+        if (!mp3_decoder_) {
+            mp3_decoder_ = std::make_unique<Mp3Decoder>();
+        }
+        decoder = mp3_decoder_.get();
+#else
+        ESP_LOGE(TAG, "MP3 decoder is disabled");
+        return false;
+#endif
+    } else {
+        if (!pcm_decoder_) {
+            pcm_decoder_ = std::make_unique<PcmDecoder>();
+        }
+        if (packet.sample_rate > 0) {
+            pcm_decoder_->SetRawFormat(packet.sample_rate, 1);
+        }
+        decoder = pcm_decoder_.get();
+    }
+    if (stream_decoder_reset_.exchange(false)) {
+        if (mp3_decoder_) {
+            mp3_decoder_->Reset();
+        }
+        if (pcm_decoder_) {
+            pcm_decoder_->Reset();
+        }
+        stream_resampler_.Reset();
+    }
+
+    int64_t start_time = esp_timer_get_time();
+    std::vector<int16_t> decoded;
+    if (!decoder->Decode(packet.payload.data(), packet.payload.size(), decoded)) {
+        return false;
+    }
+    if (decoded.empty()) {
+        pcm.clear();
+        return true;
+    }
+    // 统计按解码器采样率计，要在 decoded 被移走之前取大小
+    size_t decoded_samples = decoded.size();
+    int input_rate = decoder->sample_rate();
+    int output_rate = codec_->output_sample_rate();
+    if (input_rate != output_rate) {
+        if (stream_resampler_.input_sample_rate() != input_rate || stream_resampler_.output_sample_rate() != output_rate) {
+            stream_resampler_.Configure(input_rate, output_rate);
+        }
+        stream_resampler_.Process(decoded, pcm);
+    } else {
+        pcm = std::move(decoded);
+    }
+    debug_statistics_.stream_decode_us += esp_timer_get_time() - start_time;
+    debug_statistics_.stream_decoded_samples += decoded_samples;
+    if (debug_statistics_.stream_decoded_samples >= (uint64_t)decoder->sample_rate() * 10) {
+        // 每 10 秒音频统计一次解码（含重采样）耗时
+        ESP_LOGI(TAG, "%s decode: %lld ms CPU per second of audio",
+            packet.format == kAudioStreamFormatMp3 ? "MP3" : "PCM",
+            debug_statistics_.stream_decode_us * decoder->sample_rate() / 1000 / (int64_t)debug_statistics_.stream_decoded_samples);
+        debug_statistics_.stream_decode_us = 0;
+        debug_statistics_.stream_decoded_samples = 0;
+    }
+    return true;
+}
+
+AudioStreamFormat AudioService::DetectStreamFormat(const std::string_view& data) {
+    auto bytes = reinterpret_cast<const uint8_t*>(data.data());
+    if (data.size() >= 12 && memcmp(bytes, "RIFF", 4) == 0 && memcmp(bytes + 8, "WAVE", 4) == 0) {
+        return kAudioStreamFormatPcm;
+    }
+    if (data.size() >= 3 && memcmp(bytes, "ID3", 3) == 0) {
+        return kAudioStreamFormatMp3;
+    }
+    if (data.size() >= 2 && bytes[0] == 0xFF && (bytes[1] & 0xE0) == 0xE0) {
+        // 同步字后的 layer 为 00 是 AAC ADTS 帧头，不是 MPEG 音频
+        if ((bytes[1] & 0x06) == 0) {
+            ESP_LOGW(TAG, "AAC (ADTS) is not supported");
+            return kAudioStreamFormatOpus;
+        }
+        return kAudioStreamFormatMp3;
+    }
+    return kAudioStreamFormatOpus;
+}
+
 void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
     if (opus_decoder_->sample_rate() == sample_rate && opus_decoder_->duration_ms() == frame_duration) {
         return;
@@ -379,8 +845,10 @@ void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
     opus_decoder_.reset();
     opus_decoder_ = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
 
+    // 滤波器按采样率组合缓存，只有帧长变化时保留重采样器的状态
     auto codec = Board::GetInstance().GetAudioCodec();
-    if (opus_decoder_->sample_rate() != codec->output_sample_rate()) {
+    if (opus_decoder_->sample_rate() != codec->output_sample_rate() &&
+        output_resampler_.input_sample_rate() != opus_decoder_->sample_rate()) {
         ESP_LOGI(TAG, "Resampling audio from %d to %d", opus_decoder_->sample_rate(), codec->output_sample_rate());
         output_resampler_.Configure(opus_decoder_->sample_rate(), codec->output_sample_rate());
     }
@@ -394,14 +862,9 @@ void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t
     /* Push the task to the encode queue */
     std::unique_lock<std::mutex> lock(audio_queue_mutex_);
 
-    /* If the task is to send queue, we need to set the timestamp */
-    if (type == kAudioTaskTypeEncodeToSendQueue && !timestamp_queue_.empty()) {
-        if (timestamp_queue_.size() <= MAX_TIMESTAMPS_IN_QUEUE) {
-            task->timestamp = timestamp_queue_.front();
-        } else {
-            ESP_LOGW(TAG, "Timestamp queue (%u) is full, dropping timestamp", timestamp_queue_.size());
-        }
-        timestamp_queue_.pop_front();
+    /* If the task is to send queue, tag it with the far-end audio that was playing when it was captured */
+    if (type == kAudioTaskTypeEncodeToSendQueue) {
+        task->timestamp = GetCaptureTimestamp(esp_timer_get_time(), task->pcm.size());
     }
 
     audio_queue_cv_.wait(lock, [this]() { return audio_encode_queue_.size() < MAX_ENCODE_TASKS_IN_QUEUE; });
@@ -474,7 +937,7 @@ void AudioService::EnableWakeWordDetection(bool enable) {
     }
 }
 
-void AudioService::EnableVoiceProcessing(bool enable) {
+void AudioService::EnableVoiceProcessing(bool enable, bool warmup) {
     ESP_LOGD(TAG, "%s voice processing", enable ? "Enabling" : "Disabling");
     if (enable) {
         if (!audio_processor_initialized_) {
@@ -484,12 +947,54 @@ void AudioService::EnableVoiceProcessing(bool enable) {
 
         /* We should make sure no audio is playing */
         ResetDecoder();
-        audio_input_need_warmup_ = true;
+        audio_input_need_warmup_ = warmup;
         audio_processor_->Start();
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
     } else {
         audio_processor_->Stop();
         xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
+
+        /* Drop the pre-roll audio if the audio channel was never opened */
+        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+        if (preroll_active_) {
+            preroll_active_ = false;
+            preroll_ring_.Detach(preroll_reader_);
+            audio_send_queue_.clear();
+            audio_queue_cv_.notify_all();
+        }
+    }
+}
+
+bool AudioService::StartPreroll() {
+    if (preroll_ring_.capacity() == 0) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+        audio_send_queue_.clear();
+        preroll_ring_.Attach(preroll_reader_, preroll_ring_.write_position());
+        preroll_reader_.overruns = 0;
+        preroll_active_ = true;
+    }
+    // 紧接唤醒词开始录音，不跳过预热时间
+    EnableVoiceProcessing(true, false);
+    return true;
+}
+
+void AudioService::FlushPreroll() {
+    {
+        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+        if (!preroll_active_) {
+            return;
+        }
+        preroll_active_ = false;
+        size_t buffered_ms = preroll_ring_.Available(preroll_reader_) / 16 + audio_send_queue_.size() * OPUS_FRAME_DURATION_MS;
+        ESP_LOGI(TAG, "Flush pre-roll audio: %u ms buffered, %u packets encoded, %lu overruns",
+            buffered_ms, audio_send_queue_.size(), preroll_reader_.overruns);
+        audio_queue_cv_.notify_all();
+    }
+    if (callbacks_.on_send_queue_available) {
+        callbacks_.on_send_queue_available();
     }
 }
 
@@ -527,6 +1032,30 @@ void AudioService::PlaySound(const std::string_view& ogg) {
         codec_->EnableOutput(true);
     }
 
+    // MP3 / WAV 按原样分块送入解码队列，无需预先转换为 Ogg Opus
+    auto format = DetectStreamFormat(ogg);
+    if (format != kAudioStreamFormatOpus) {
+        for (size_t offset = 0; offset < ogg.size(); offset += AUDIO_STREAM_CHUNK_SIZE) {
+            size_t size = std::min<size_t>(AUDIO_STREAM_CHUNK_SIZE, ogg.size() - offset);
+            auto packet = std::make_unique<AudioStreamPacket>();
+            packet->format = format;
+            packet->payload.assign(ogg.data() + offset, ogg.data() + offset + size);
+            PushPacketToDecodeQueue(std::move(packet), true);
+        }
+        return;
+    }
+
+    ParseOggOpus(ogg, [this](int sample_rate, const uint8_t* data, size_t size) {
+        auto packet = std::make_unique<AudioStreamPacket>();
+        packet->sample_rate = sample_rate;
+        packet->frame_duration = 60;
+        packet->payload.resize(size);
+        std::memcpy(packet->payload.data(), data, size);
+        PushPacketToDecodeQueue(std::move(packet), true);
+    });
+}
+
+bool AudioService::ParseOggOpus(const std::string_view& ogg, std::function<void(int sample_rate, const uint8_t* data, size_t size)> on_packet) {
     const uint8_t* buf = reinterpret_cast<const uint8_t*>(ogg.data());
     size_t size = ogg.size();
     size_t offset = 0;
@@ -607,16 +1136,12 @@ void AudioService::PlaySound(const std::string_view& ogg) {
             }
 
             // Audio packet (Opus)
-            auto packet = std::make_unique<AudioStreamPacket>();
-            packet->sample_rate = sample_rate;
-            packet->frame_duration = 60;
-            packet->payload.resize(pkt_len);
-            std::memcpy(packet->payload.data(), pkt_ptr, pkt_len);
-            PushPacketToDecodeQueue(std::move(packet), true);
+            on_packet(sample_rate, pkt_ptr, pkt_len);
         }
 
         offset = body_off + body_size;
     }
+    return seen_head;
 }
 
 bool AudioService::IsIdle() {
@@ -624,13 +1149,24 @@ bool AudioService::IsIdle() {
     return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_playback_queue_.empty() && audio_testing_queue_.empty();
 }
 
+int AudioService::GetOutputLatencyMs() {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    return playback_clock_.output_latency_ms();
+}
+
 void AudioService::ResetDecoder() {
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
     opus_decoder_->ResetState();
-    timestamp_queue_.clear();
+    stream_decoder_reset_ = true;
+    output_reset_ = true;
+    playback_clock_.Reset();
     audio_decode_queue_.clear();
     audio_playback_queue_.clear();
     audio_testing_queue_.clear();
+    if (tts_stopping_) {
+        // 打断时剩下的音频不会再播放，到此为止
+        FinishTtsPlaybackLocked();
+    }
     audio_queue_cv_.notify_all();
 }
 
@@ -670,6 +1206,14 @@ void AudioService::SetModelsList(srmodel_list_t* models_list) {
 
     if (wake_word_) {
         wake_word_->OnWakeWordDetected([this](const std::string& wake_word) {
+#if CONFIG_AUDIO_DEBUG_REPLAY
+            // 评测时只上报事件，不进入对话，并继续检测下一个唤醒词
+            if (audio_debugger_) {
+                audio_debugger_->ReportEvent("wake", wake_word);
+            }
+            wake_word_->Start();
+            return;
+#endif
             if (callbacks_.on_wake_word_detected) {
                 callbacks_.on_wake_word_detected(wake_word);
             }
@@ -6,6 +6,7 @@
 #include <condition_variable>
 #include <chrono>
 #include <mutex>
+#include <atomic>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -15,10 +16,18 @@
 
 #include <opus_encoder.h>
 #include <opus_decoder.h>
-#include <opus_resampler.h>
 
 #include "audio_codec.h"
 #include "audio_processor.h"
+#include "audio_capture_ring.h"
+#include "wake_word_gate.h"
+#include "opus_encoder_tuner.h"
+#include "polyphase_resampler.h"
+#include "playback_clock.h"
+#include "decoders/pcm_decoder.h"
+#if CONFIG_USE_MP3_DECODER
+#include "decoders/mp3_decoder.h"
+#endif
 #include "processors/audio_debugger.h"
 #include "wake_word.h"
 #include "protocol.h"
@@ -28,9 +37,18 @@
  * There are two types of audio data flow:
  * 1. (MIC) -> [Processors] -> {Encode Queue} -> [Opus Encoder] -> {Send Queue} -> (Server)
  * 2. (Server) -> {Decode Queue} -> [Opus Decoder] -> {Playback Queue} -> (Speaker)
+ *    MP3 / WAV sounds are queued as byte chunks and decoded by an AudioDecoder instead.
  *
  * We use one task for MIC / Speaker / Processors, and one task for Opus Encoder / Opus Decoder.
+ *
+ * The MIC is read once into {Capture Ring}, and the wake word, the processors and audio testing
+ * each consume it from their own cursor with their own feed size. An energy gate skips the wake
+ * word during silence and feeds it a short look-back from the ring when sound starts.
  * 
+ * After the wake word the processed audio goes to {Pre-roll Ring} while the audio channel is being
+ * opened. The Opus codec task encodes it lazily into the Send Queue, which is flushed once the
+ * channel is open.
+ *
  * Decode Queue and Send Queue are the main queues, because Opus packets are quite smaller than PCM packets.
  * 
  */
@@ -41,7 +59,28 @@
 #define MAX_DECODE_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define MAX_SEND_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
-#define MAX_TIMESTAMPS_IN_QUEUE 3
+#define AUDIO_STREAM_CHUNK_SIZE 1024
+#define PLAYBACK_GAP_THRESHOLD_MS 30
+#define PLAYBACK_FADE_MS 4
+#define PLAYBACK_DISCONTINUITY_THRESHOLD 2048
+#define TTS_PREBUFFER_TIMEOUT_MS 300
+#define AUDIO_CAPTURE_RING_MS 300
+#define AUDIO_INPUT_WARMUP_MS 120
+#define OPUS_TUNER_QUEUE_LIMIT (MAX_SEND_PACKETS_IN_QUEUE / 4)
+#define OPUS_TUNER_LOG_FRAMES (30000 / OPUS_FRAME_DURATION_MS)
+#define WAKE_WORD_GATE_LOOKBACK_MS 240
+#define WAKE_WORD_GATE_HANGOVER_MS 1500
+#define WAKE_WORD_GATE_LOG_INTERVAL_MS 60000
+
+static_assert(WAKE_WORD_GATE_LOOKBACK_MS < AUDIO_CAPTURE_RING_MS, "Look-back must fit in the capture ring");
+
+#ifndef CONFIG_AUDIO_PREROLL_MS
+#define CONFIG_AUDIO_PREROLL_MS 0
+#endif
+
+#ifndef CONFIG_TTS_PREBUFFER_MS
+#define CONFIG_TTS_PREBUFFER_MS 0
+#endif
 
 #define AUDIO_POWER_TIMEOUT_MS 15000
 #define AUDIO_POWER_CHECK_INTERVAL_MS 1000
@@ -72,11 +111,25 @@ struct AudioTask {
     uint32_t timestamp;
 };
 
+struct TtsPlaybackMetrics {
+    uint32_t frames = 0;
+    uint32_t sentences = 0;
+    uint32_t gapless_sentences = 0;     // Sentence boundaries played without a gap
+    uint32_t sentence_gaps = 0;
+    uint32_t sentence_gap_ms = 0;
+    uint32_t max_sentence_gap_ms = 0;
+    uint32_t underruns = 0;             // Gaps inside a sentence
+    uint32_t underrun_ms = 0;
+    uint32_t crossfades = 0;
+};
+
 struct DebugStatistics {
     uint32_t input_count = 0;
     uint32_t decode_count = 0;
     uint32_t encode_count = 0;
     uint32_t playback_count = 0;
+    int64_t stream_decode_us = 0;
+    uint64_t stream_decoded_samples = 0;
 };
 
 class AudioService {
@@ -95,17 +148,33 @@ public:
     bool IsWakeWordRunning() const { return xEventGroupGetBits(event_group_) & AS_EVENT_WAKE_WORD_RUNNING; }
     bool IsAudioProcessorRunning() const { return xEventGroupGetBits(event_group_) & AS_EVENT_AUDIO_PROCESSOR_RUNNING; }
     bool IsAfeWakeWord();
+    uint32_t GetPlaybackCount() const { return debug_statistics_.playback_count; }
 
     void EnableWakeWordDetection(bool enable);
-    void EnableVoiceProcessing(bool enable);
+    void EnableVoiceProcessing(bool enable, bool warmup = true);
     void EnableAudioTesting(bool enable);
     void EnableDeviceAec(bool enable);
+    // Start capturing before the audio channel is open, false if pre-roll is disabled
+    bool StartPreroll();
+    // Release the buffered audio to the send queue, the processor keeps running
+    void FlushPreroll();
+    bool IsPrerollActive() const { return preroll_active_; }
+    // Delay from a frame being written to the codec until it is heard
+    int GetOutputLatencyMs();
+
+    // Bracket one TTS response, the output pre-buffers and counts the gaps between sentences.
+    // The metrics are logged once the audio queued before StopTtsPlayback has played out
+    void StartTtsPlayback();
+    void MarkTtsSentenceStart();
+    void StopTtsPlayback();
 
     void SetCallbacks(AudioServiceCallbacks& callbacks);
 
     bool PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait = false);
     std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue();
     void PlaySound(const std::string_view& sound);
+    static AudioStreamFormat DetectStreamFormat(const std::string_view& data);
+    static bool ParseOggOpus(const std::string_view& ogg, std::function<void(int sample_rate, const uint8_t* data, size_t size)> on_packet);
     bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
     void SetModelsList(srmodel_list_t* models_list);
@@ -118,9 +187,21 @@ private:
     std::unique_ptr<AudioDebugger> audio_debugger_;
     std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
     std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
-    OpusResampler input_resampler_;
-    OpusResampler reference_resampler_;
-    OpusResampler output_resampler_;
+    std::unique_ptr<AudioDecoder> mp3_decoder_;
+    std::unique_ptr<PcmDecoder> pcm_decoder_;
+    std::atomic<bool> stream_decoder_reset_{false};  // Set by ResetDecoder, consumed by the codec task
+    PolyphaseResampler stream_resampler_;
+    OpusEncoderTuner opus_tuner_;
+    PolyphaseResampler input_resampler_;
+    PolyphaseResampler reference_resampler_;
+    PolyphaseResampler output_resampler_;
+    std::vector<int16_t> mic_buffer_;
+    std::vector<int16_t> reference_buffer_;
+    AudioCaptureRing capture_ring_;
+    AudioCaptureRing preroll_ring_;
+    AudioCaptureRing::Reader preroll_reader_;
+    WakeWordGate wake_word_gate_;
+    int64_t wake_word_gate_log_time_ = 0;
     DebugStatistics debug_statistics_;
     srmodel_list_t* models_list_ = nullptr;
 
@@ -138,13 +219,23 @@ private:
     std::deque<std::unique_ptr<AudioTask>> audio_encode_queue_;
     std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
     // For server AEC
-    std::deque<uint32_t> timestamp_queue_;
+    PlaybackClock playback_clock_;
 
     bool wake_word_initialized_ = false;
     bool audio_processor_initialized_ = false;
     bool voice_detected_ = false;
     bool service_stopped_ = true;
     bool audio_input_need_warmup_ = false;
+    bool preroll_active_ = false;
+    bool output_reset_ = false;
+    bool tts_active_ = false;
+    bool tts_prebuffering_ = false;
+    bool tts_stopping_ = false;  // The server finished sending, the queued audio is still playing
+    bool decoding_ = false;  // A packet was taken from the decode queue and is not in the playback queue yet
+    TtsPlaybackMetrics tts_metrics_;
+    std::deque<uint32_t> sentence_boundaries_;  // Playback count of the first frame of each sentence
+    uint32_t replay_feed_us_ = 0;
+    int64_t preroll_write_time_ = 0;
 
     esp_timer_handle_t audio_power_timer_ = nullptr;
     std::chrono::steady_clock::time_point last_input_time_;
@@ -154,6 +245,17 @@ private:
     void AudioOutputTask();
     void OpusCodecTask();
     void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
+    void EncodePrerollFrame(std::unique_lock<std::mutex>& lock);
+    // Far-end timestamp for the `samples` processed samples that end at `output_time`, called with the queue lock held
+    uint32_t GetCaptureTimestamp(int64_t output_time, size_t samples);
+    bool EncodeFrame(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus, size_t queue_depth);
+    bool DecodeStreamPacket(AudioStreamPacket& packet, std::vector<int16_t>& pcm);
+    bool SmoothDiscontinuity(std::vector<int16_t>& pcm, bool after_gap, int16_t last_sample);
+    int GetBufferedPlaybackMs();
+    void UpdatePlaybackMetrics(int gap_ms);
+    void FinishTtsPlaybackIfDrainedLocked();
+    void FinishTtsPlaybackLocked();
+    bool UpdateWakeWordGate(const std::vector<int16_t>& data);
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
     void CheckAndUpdateAudioPowerState();
 };
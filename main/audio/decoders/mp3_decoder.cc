@@ -0,0 +1,114 @@
+#include "mp3_decoder.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "Mp3Decoder"
+
+// 帧头、CRC 和边信息的最大长度，少于这些字节时等待下一块数据
+#define MIN_FRAME_BYTES 64
+#define ID3_HEADER_SIZE 10
+
+Mp3Decoder::~Mp3Decoder() {
+    if (decoder_ != nullptr) {
+        MP3FreeDecoder(decoder_);
+    }
+}
+
+void Mp3Decoder::Reset() {
+    if (decoder_ != nullptr) {
+        MP3FreeDecoder(decoder_);
+        decoder_ = nullptr;
+    }
+    buffer_.clear();
+    id3_remaining_ = 0;
+    sample_rate_ = 0;
+}
+
+bool Mp3Decoder::Decode(const uint8_t* data, size_t size, std::vector<int16_t>& pcm) {
+    if (decoder_ == nullptr) {
+        decoder_ = MP3InitDecoder();
+        if (decoder_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to create MP3 decoder");
+            return false;
+        }
+        frame_.resize(MAX_NCHAN * MAX_NGRAN * MAX_NSAMP);
+    }
+
+    // 跳过跨数据块的 ID3 标签（可能包含封面图片）
+    size_t skip = std::min<size_t>(id3_remaining_, size);
+    id3_remaining_ -= skip;
+    buffer_.insert(buffer_.end(), data + skip, data + size);
+
+    uint8_t* read_ptr = buffer_.data();
+    int bytes_left = buffer_.size();
+    while (bytes_left >= MIN_FRAME_BYTES) {
+        if (memcmp(read_ptr, "ID3", 3) == 0) {
+            uint32_t tag_size = ((read_ptr[6] & 0x7f) << 21) | ((read_ptr[7] & 0x7f) << 14) |
+                ((read_ptr[8] & 0x7f) << 7) | (read_ptr[9] & 0x7f);
+            uint32_t total = ID3_HEADER_SIZE + tag_size;
+            uint32_t in_buffer = std::min<uint32_t>(total, bytes_left);
+            id3_remaining_ = total - in_buffer;
+            read_ptr += in_buffer;
+            bytes_left -= in_buffer;
+            continue;
+        }
+
+        int offset = MP3FindSyncWord(read_ptr, bytes_left);
+        if (offset < 0) {
+            // 保留最后一个字节，同步字可能跨块
+            read_ptr += bytes_left - 1;
+            bytes_left = 1;
+            break;
+        }
+        read_ptr += offset;
+        bytes_left -= offset;
+        if (bytes_left < MIN_FRAME_BYTES) {
+            break;
+        }
+
+        uint8_t* frame_ptr = read_ptr;
+        int frame_left = bytes_left;
+        int err = MP3Decode(decoder_, &frame_ptr, &frame_left, frame_.data(), 0);
+        if (err == ERR_MP3_INDATA_UNDERFLOW) {
+            // 帧还不完整，等待下一块数据
+            break;
+        }
+        if (err == ERR_MP3_MAINDATA_UNDERFLOW) {
+            // 流开始时缺少前一帧的比特池，跳过这一帧
+            read_ptr = frame_ptr;
+            bytes_left = frame_left;
+            continue;
+        }
+        if (err != ERR_MP3_NONE) {
+            // 误判的同步字或损坏的帧，跳过一个字节重新同步
+            read_ptr++;
+            bytes_left--;
+            continue;
+        }
+        read_ptr = frame_ptr;
+        bytes_left = frame_left;
+
+        MP3FrameInfo info;
+        MP3GetLastFrameInfo(decoder_, &info);
+        if (info.samprate != sample_rate_) {
+            ESP_LOGI(TAG, "MP3 stream: %d Hz, %d channels, %d kbps", info.samprate, info.nChans, info.bitrate / 1000);
+            sample_rate_ = info.samprate;
+        }
+        int channels = std::max(1, info.nChans);
+        int frames = info.outputSamps / channels;
+        size_t start = pcm.size();
+        pcm.resize(start + frames);
+        if (channels == 2) {
+            for (int i = 0; i < frames; i++) {
+                pcm[start + i] = (frame_[i * 2] + frame_[i * 2 + 1]) / 2;
+            }
+        } else {
+            std::copy(frame_.begin(), frame_.begin() + frames, pcm.begin() + start);
+        }
+    }
+
+    buffer_.erase(buffer_.begin(), buffer_.begin() + (read_ptr - buffer_.data()));
+    return true;
+}
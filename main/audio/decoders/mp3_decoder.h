@@ -0,0 +1,28 @@
+#ifndef MP3_DECODER_H
+#define MP3_DECODER_H
+
+#include "audio_decoder.h"
+
+#include <mp3dec.h>
+
+// Fixed-point MP3 decoder (Helix), output is downmixed to mono
+class Mp3Decoder : public AudioDecoder {
+public:
+    Mp3Decoder() = default;
+    ~Mp3Decoder();
+    Mp3Decoder(const Mp3Decoder&) = delete;
+    Mp3Decoder& operator=(const Mp3Decoder&) = delete;
+
+    bool Decode(const uint8_t* data, size_t size, std::vector<int16_t>& pcm) override;
+    void Reset() override;
+    int sample_rate() const override { return sample_rate_; }
+
+private:
+    HMP3Decoder decoder_ = nullptr;
+    std::vector<uint8_t> buffer_;   // Bytes not decoded yet, at most a frame plus a chunk
+    std::vector<int16_t> frame_;
+    uint32_t id3_remaining_ = 0;    // Bytes of an ID3v2 tag still to skip
+    int sample_rate_ = 0;
+};
+
+#endif // MP3_DECODER_H
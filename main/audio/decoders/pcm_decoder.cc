@@ -0,0 +1,160 @@
+#include "pcm_decoder.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "PcmDecoder"
+
+// WAV 头（含 LIST 等附加块）超过这个长度就认为不是有效的 WAV
+#define MAX_HEADER_SIZE 4096
+
+static uint32_t ReadLe32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t ReadLe16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+void PcmDecoder::SetRawFormat(int sample_rate, int channels) {
+    raw_sample_rate_ = sample_rate;
+    raw_channels_ = channels;
+}
+
+void PcmDecoder::Reset() {
+    sample_rate_ = 0;
+    channels_ = 1;
+    in_data_ = false;
+    failed_ = false;
+    data_remaining_ = 0;
+    pending_.clear();
+}
+
+bool PcmDecoder::ParseHeader() {
+    const uint8_t* p = pending_.data();
+    size_t size = pending_.size();
+    if (size < 4) {
+        return false;
+    }
+    if (memcmp(p, "RIFF", 4) != 0) {
+        // 没有 RIFF 头，按原始 PCM 处理
+        sample_rate_ = raw_sample_rate_;
+        channels_ = raw_channels_;
+        data_remaining_ = UINT32_MAX;
+        in_data_ = true;
+        return true;
+    }
+    if (size < 12) {
+        return false;
+    }
+
+    size_t offset = 12;
+    int format = 0, bits = 0;
+    while (offset + 8 <= size) {
+        uint32_t chunk_size = ReadLe32(p + offset + 4);
+        if (memcmp(p + offset, "data", 4) == 0) {
+            if (format != 1 || bits != 16) {
+                ESP_LOGE(TAG, "Unsupported WAV format %d, %d bits", format, bits);
+                pending_.clear();
+                failed_ = true;
+                return false;
+            }
+            // 流式生成的 WAV 长度可能为 0 或 0xFFFFFFFF，一直播放到流结束
+            data_remaining_ = (chunk_size == 0 || chunk_size == UINT32_MAX) ? UINT32_MAX : chunk_size;
+            pending_.erase(pending_.begin(), pending_.begin() + offset + 8);
+            in_data_ = true;
+            ESP_LOGI(TAG, "WAV stream: %d Hz, %d channels", sample_rate_, channels_);
+            return true;
+        }
+        if (offset + 8 + chunk_size > size) {
+            break;
+        }
+        if (memcmp(p + offset, "fmt ", 4) == 0 && chunk_size >= 16) {
+            format = ReadLe16(p + offset + 8);
+            channels_ = std::max<int>(1, ReadLe16(p + offset + 10));
+            sample_rate_ = ReadLe32(p + offset + 12);
+            bits = ReadLe16(p + offset + 22);
+        }
+        offset += 8 + chunk_size + (chunk_size & 1);
+    }
+    if (size > MAX_HEADER_SIZE) {
+        ESP_LOGE(TAG, "WAV header not found in %u bytes", size);
+        pending_.clear();
+        failed_ = true;
+    }
+    return false;
+}
+
+void PcmDecoder::Output(const uint8_t* data, size_t size, std::vector<int16_t>& pcm) {
+    size_t frames = size / (2 * channels_);
+    size_t start = pcm.size();
+    pcm.resize(start + frames);
+    for (size_t i = 0; i < frames; i++) {
+        // 多声道下混为单声道
+        int32_t sum = 0;
+        for (int c = 0; c < channels_; c++) {
+            sum += (int16_t)ReadLe16(data + (i * channels_ + c) * 2);
+        }
+        pcm[start + i] = sum / channels_;
+    }
+}
+
+bool PcmDecoder::Decode(const uint8_t* data, size_t size, std::vector<int16_t>& pcm) {
+    if (failed_) {
+        return false;
+    }
+    while (size > 0) {
+        if (!in_data_) {
+            // 头部可能跨多个数据块，先缓存到 pending_ 中
+            size_t take = std::min<size_t>(size, MAX_HEADER_SIZE + 1 - std::min<size_t>(pending_.size(), MAX_HEADER_SIZE));
+            pending_.insert(pending_.end(), data, data + take);
+            data += take;
+            size -= take;
+            if (!ParseHeader()) {
+                if (failed_) {
+                    return false;
+                }
+                continue;
+            }
+            // pending_ 中剩下的是数据块的开头，放回输入一起处理
+            std::vector<uint8_t> head;
+            head.swap(pending_);
+            head.insert(head.end(), data, data + size);
+            return Decode(head.data(), head.size(), pcm);
+        }
+
+        size_t take = std::min<size_t>(size, data_remaining_);
+        size_t frame_bytes = 2 * channels_;
+        const uint8_t* p = data;
+        size_t left = take;
+        if (!pending_.empty()) {
+            // 补齐上一块剩下的半个采样帧
+            size_t need = std::min(frame_bytes - pending_.size(), left);
+            pending_.insert(pending_.end(), p, p + need);
+            p += need;
+            left -= need;
+            if (pending_.size() == frame_bytes) {
+                Output(pending_.data(), frame_bytes, pcm);
+                pending_.clear();
+            }
+        }
+        if (pending_.empty()) {
+            size_t whole = left / frame_bytes * frame_bytes;
+            Output(p, whole, pcm);
+            pending_.assign(p + whole, p + left);
+        }
+
+        data += take;
+        size -= take;
+        if (data_remaining_ != UINT32_MAX) {
+            data_remaining_ -= take;
+            if (data_remaining_ == 0) {
+                // 数据块结束，后面的字节可能是下一个 WAV 文件
+                in_data_ = false;
+                pending_.clear();
+            }
+        }
+    }
+    return true;
+}
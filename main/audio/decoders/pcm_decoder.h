@@ -0,0 +1,29 @@
+#ifndef PCM_DECODER_H
+#define PCM_DECODER_H
+
+#include "audio_decoder.h"
+
+// WAV (16-bit PCM) passthrough, streams without a RIFF header are raw PCM in the raw format
+class PcmDecoder : public AudioDecoder {
+public:
+    void SetRawFormat(int sample_rate, int channels);
+
+    bool Decode(const uint8_t* data, size_t size, std::vector<int16_t>& pcm) override;
+    void Reset() override;
+    int sample_rate() const override { return sample_rate_; }
+
+private:
+    int raw_sample_rate_ = 16000;
+    int raw_channels_ = 1;
+    int sample_rate_ = 0;
+    int channels_ = 1;
+    bool in_data_ = false;
+    bool failed_ = false;           // Unsupported stream, ignored until Reset()
+    uint32_t data_remaining_ = 0;   // Bytes left in the WAV data chunk, UINT32_MAX for raw / streamed WAV
+    std::vector<uint8_t> pending_;  // Header bytes, or a partial sample frame
+
+    bool ParseHeader();
+    void Output(const uint8_t* data, size_t size, std::vector<int16_t>& pcm);
+};
+
+#endif // PCM_DECODER_H
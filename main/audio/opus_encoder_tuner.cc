@@ -0,0 +1,100 @@
+#include "opus_encoder_tuner.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+
+#define TAG "OpusEncoderTuner"
+
+// 降低复杂度之前至少观察的帧数，提高之前需要更长时间的余量
+#define STEP_DOWN_FRAMES 8
+#define STEP_UP_FRAMES 50
+// 超过这个时间没有解码，认为服务器音频已经结束
+#define DECODE_IDLE_US 1000000
+
+void OpusEncoderTuner::Configure(int min_complexity, int max_complexity, int budget_percent, size_t queue_limit) {
+    min_complexity_ = std::clamp(min_complexity, 0, 10);
+    max_complexity_ = std::clamp(max_complexity, min_complexity_, 10);
+    // 从最低复杂度开始，确认有余量后再逐步提高
+    complexity_ = min_complexity_;
+    budget_permille_ = budget_percent * 10;
+    queue_limit_ = queue_limit;
+    encode_permille_ = 0;
+    decode_permille_ = 0;
+    frames_since_change_ = 0;
+}
+
+void OpusEncoderTuner::OnFrameDecoded(int64_t decode_us, int frame_duration_ms) {
+    if (frame_duration_ms <= 0) {
+        return;
+    }
+    int permille = decode_us / frame_duration_ms;
+    decode_permille_ += (permille - decode_permille_) / 8;
+    last_decode_time_ = esp_timer_get_time();
+}
+
+bool OpusEncoderTuner::OnFrameEncoded(int64_t encode_us, int frame_duration_ms, size_t payload_bytes, size_t queue_depth) {
+    if (frame_duration_ms <= 0) {
+        return false;
+    }
+    int permille = encode_us / frame_duration_ms;
+    encode_permille_ = frames_since_change_ == 0 ? permille : encode_permille_ + (permille - encode_permille_) / 8;
+    if (esp_timer_get_time() - last_decode_time_ > DECODE_IDLE_US) {
+        decode_permille_ = 0;
+    }
+    int load = encode_permille_ + decode_permille_;
+    frames_since_change_++;
+
+    frames_++;
+    encode_us_total_ += encode_us;
+    encode_us_max_ = std::max<uint32_t>(encode_us_max_, encode_us);
+    load_permille_total_ += load;
+    payload_bytes_ += payload_bytes;
+    duration_ms_ += frame_duration_ms;
+    queue_depth_max_ = std::max<uint32_t>(queue_depth_max_, queue_depth);
+
+    int target = complexity_;
+    if ((load > budget_permille_ || queue_depth >= queue_limit_) && frames_since_change_ >= STEP_DOWN_FRAMES) {
+        target = complexity_ - 1;
+    } else if (load < budget_permille_ / 2 && queue_depth <= 1 && frames_since_change_ >= STEP_UP_FRAMES) {
+        target = complexity_ + 1;
+    }
+    target = std::clamp(target, min_complexity_, max_complexity_);
+    if (target == complexity_) {
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Complexity %d -> %d, encode %d.%d%% + decode %d.%d%% of frame time, send queue %u",
+        complexity_, target, encode_permille_ / 10, encode_permille_ % 10,
+        decode_permille_ / 10, decode_permille_ % 10, queue_depth);
+    complexity_ = target;
+    frames_since_change_ = 0;
+    changes_++;
+    return true;
+}
+
+OpusEncoderTuner::Metrics OpusEncoderTuner::TakeMetrics() {
+    Metrics metrics;
+    metrics.complexity = complexity_;
+    metrics.frames = frames_;
+    if (frames_ > 0) {
+        metrics.encode_us_avg = encode_us_total_ / frames_;
+        metrics.load_percent = load_permille_total_ / frames_ / 10;
+    }
+    if (duration_ms_ > 0) {
+        metrics.bitrate_bps = payload_bytes_ * 8 * 1000 / duration_ms_;
+    }
+    metrics.encode_us_max = encode_us_max_;
+    metrics.queue_depth_max = queue_depth_max_;
+    metrics.changes = changes_;
+
+    frames_ = 0;
+    encode_us_total_ = 0;
+    encode_us_max_ = 0;
+    load_permille_total_ = 0;
+    payload_bytes_ = 0;
+    duration_ms_ = 0;
+    queue_depth_max_ = 0;
+    changes_ = 0;
+    return metrics;
+}
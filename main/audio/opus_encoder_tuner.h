@@ -0,0 +1,63 @@
+#ifndef OPUS_ENCODER_TUNER_H
+#define OPUS_ENCODER_TUNER_H
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Picks the Opus encoder complexity from what the codec task can afford.
+ *
+ * The codec task encodes the microphone and decodes the server audio, so the load is the
+ * smoothed encode time plus the recent decode time (which grows with the server's sample rate
+ * and frame duration), as a share of the real-time frame duration. Complexity steps down as soon
+ * as the load exceeds the budget or the send queue backs up (the sender and the Wi-Fi / 4G stack
+ * share the CPU with the codec), and steps up slowly while there is headroom, always within the
+ * Kconfig bounds.
+ */
+class OpusEncoderTuner {
+public:
+    struct Metrics {
+        int complexity = 0;
+        uint32_t frames = 0;
+        uint32_t encode_us_avg = 0;
+        uint32_t encode_us_max = 0;
+        uint32_t load_percent = 0;      // Encode + decode time as a share of the frame duration
+        uint32_t bitrate_bps = 0;
+        uint32_t queue_depth_max = 0;
+        uint32_t changes = 0;
+    };
+
+    void Configure(int min_complexity, int max_complexity, int budget_percent, size_t queue_limit);
+    int complexity() const { return complexity_; }
+
+    // Returns true if the complexity should be changed to complexity()
+    bool OnFrameEncoded(int64_t encode_us, int frame_duration_ms, size_t payload_bytes, size_t queue_depth);
+    void OnFrameDecoded(int64_t decode_us, int frame_duration_ms);
+
+    // Metrics since the last call
+    Metrics TakeMetrics();
+    uint32_t frames() const { return frames_; }
+
+private:
+    int min_complexity_ = 0;
+    int max_complexity_ = 0;
+    int complexity_ = 0;
+    int budget_permille_ = 250;
+    size_t queue_limit_ = 10;
+    int encode_permille_ = 0;
+    int decode_permille_ = 0;
+    int64_t last_decode_time_ = 0;
+    uint32_t frames_since_change_ = 0;
+
+    // Accumulated for metrics
+    uint32_t frames_ = 0;
+    uint64_t encode_us_total_ = 0;
+    uint32_t encode_us_max_ = 0;
+    uint64_t load_permille_total_ = 0;
+    uint64_t payload_bytes_ = 0;
+    uint64_t duration_ms_ = 0;
+    uint32_t queue_depth_max_ = 0;
+    uint32_t changes_ = 0;
+};
+
+#endif // OPUS_ENCODER_TUNER_H
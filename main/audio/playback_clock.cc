@@ -0,0 +1,69 @@
+#include "playback_clock.h"
+
+#include <algorithm>
+
+// 只保留最近这么长时间内播放的片段，足够覆盖采集和处理的延迟
+#define SEGMENT_HISTORY_US 1000000
+// 写入耗时超过一个 DMA 描述符的一半，说明 DMA 环形缓冲区已满
+#define BLOCKED_WRITE_RATIO 2
+// 输出延迟的平滑系数 1/8
+#define LATENCY_SMOOTHING 8
+
+void PlaybackClock::Configure(int sample_rate, int dma_frames, int dma_desc_frames) {
+    sample_rate_ = sample_rate;
+    dma_us_ = (int64_t)dma_frames * 1000000 / sample_rate;
+    dma_desc_us_ = (int64_t)dma_desc_frames * 1000000 / sample_rate;
+    output_latency_us_ = dma_us_;
+    render_end_us_ = 0;
+    segments_.clear();
+}
+
+void PlaybackClock::Reset() {
+    // DMA 里的音频还会继续播完，只丢弃时间戳
+    segments_.clear();
+}
+
+void PlaybackClock::OnOutput(uint32_t timestamp, size_t samples, int64_t start_us, int64_t end_us) {
+    int64_t duration_us = (int64_t)samples * 1000000 / sample_rate_;
+
+    int64_t render_start_us;
+    if (render_end_us_ > start_us) {
+        // DMA 里还有没播完的数据，接在后面播放
+        render_start_us = render_end_us_;
+    } else {
+        // 欠载之后 DMA 在播放静音，写入后一个描述符内开始播放
+        render_start_us = start_us + std::min(dma_desc_us_, duration_us);
+    }
+    int64_t render_end_us = render_start_us + duration_us;
+
+    // 写入返回时 DMA 里最多只有一个环形缓冲区；写入被阻塞说明缓冲区是满的，
+    // 最后一个采样在将近一个环形缓冲区之后才播放。超出范围时修正时钟漂移
+    int64_t max_end_us = end_us + dma_us_;
+    int64_t min_end_us = end_us - start_us > dma_desc_us_ / BLOCKED_WRITE_RATIO ? max_end_us - dma_desc_us_ : end_us;
+    int64_t corrected_end_us = std::clamp(render_end_us, min_end_us, max_end_us);
+    render_start_us += corrected_end_us - render_end_us;
+    render_end_us = corrected_end_us;
+    render_end_us_ = render_end_us;
+
+    int64_t latency_us = std::clamp<int64_t>(render_end_us - end_us, 0, dma_us_);
+    output_latency_us_ += (latency_us - output_latency_us_) / LATENCY_SMOOTHING;
+
+    if (timestamp > 0) {
+        segments_.push_back({ render_start_us, duration_us, timestamp });
+    }
+    while (!segments_.empty() && segments_.front().start_us + segments_.front().duration_us < end_us - SEGMENT_HISTORY_US) {
+        segments_.pop_front();
+    }
+}
+
+uint32_t PlaybackClock::GetTimestampAt(int64_t time_us) const {
+    for (auto it = segments_.rbegin(); it != segments_.rend(); ++it) {
+        if (time_us >= it->start_us) {
+            if (time_us >= it->start_us + it->duration_us) {
+                return 0;
+            }
+            return it->timestamp + (uint32_t)((time_us - it->start_us) / 1000);
+        }
+    }
+    return 0;
+}
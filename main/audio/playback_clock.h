@@ -0,0 +1,49 @@
+#ifndef PLAYBACK_CLOCK_H
+#define PLAYBACK_CLOCK_H
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+
+/*
+ * Tracks when played samples actually leave the speaker.
+ *
+ * A write to the codec returns once the samples are copied into the I2S DMA ring, so they
+ * are heard up to one DMA ring later. Every write is recorded as a segment with its far-end
+ * timestamp and the estimated time its first sample is rendered: right after the previous
+ * segment while the output is streaming, or when the write started after an underrun. A write
+ * that blocked means the ring was full, which pins the render time of the last sample to
+ * roughly one ring after the write returned and corrects drift between the codec clock and
+ * esp_timer. The measured DMA delay is the output latency reported to the caller.
+ */
+class PlaybackClock {
+public:
+    void Configure(int sample_rate, int dma_frames, int dma_desc_frames);
+    // Forget the far-end timestamps, the render position keeps tracking the DMA
+    void Reset();
+
+    // Record a write of `samples` frames that started at `start_us` and returned at `end_us`
+    void OnOutput(uint32_t timestamp, size_t samples, int64_t start_us, int64_t end_us);
+
+    // Far-end timestamp (ms) of the audio rendered at `time_us`, 0 if nothing was playing
+    uint32_t GetTimestampAt(int64_t time_us) const;
+
+    // Smoothed delay between a write returning and its last sample being rendered
+    int output_latency_ms() const { return output_latency_us_ / 1000; }
+
+private:
+    struct Segment {
+        int64_t start_us;
+        int64_t duration_us;
+        uint32_t timestamp;
+    };
+
+    int sample_rate_ = 16000;
+    int64_t dma_us_ = 0;
+    int64_t dma_desc_us_ = 0;
+    int64_t render_end_us_ = 0;
+    int64_t output_latency_us_ = 0;
+    std::deque<Segment> segments_;
+};
+
+#endif // PLAYBACK_CLOCK_H
@@ -0,0 +1,162 @@
+#include "polyphase_resampler.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <numeric>
+#include <mutex>
+#include <cmath>
+#include <cstring>
+
+#define TAG "PolyphaseResampler"
+
+// 每相抽头数随降采样比例增加，保证过渡带足够窄
+#define BASE_TAPS 20
+#define MAX_TAPS 48
+#define KAISER_BETA 6.0
+// 截止频率为较低采样率奈奎斯特频率的比例
+#define CUTOFF_RATIO 0.9
+// 缓存的 (输入, 输出) 采样率组合数
+#define FILTER_CACHE_SIZE 4
+
+static double BesselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+std::shared_ptr<const PolyphaseResampler::Filter> PolyphaseResampler::CreateFilter(int input_sample_rate, int output_sample_rate) {
+    auto filter = std::make_shared<Filter>();
+    int divisor = std::gcd(input_sample_rate, output_sample_rate);
+    filter->input_rate = input_sample_rate;
+    filter->output_rate = output_sample_rate;
+    filter->up = output_sample_rate / divisor;
+    filter->down = input_sample_rate / divisor;
+    int taps = BASE_TAPS * std::max(1, filter->down) / std::max(1, std::min(filter->up, filter->down));
+    filter->taps = (std::min(taps, MAX_TAPS) + 3) & ~3;
+
+    // 原型低通滤波器工作在 L 倍上采样率下，长度为 L * taps
+    int up = filter->up;
+    int length = up * filter->taps;
+    double cutoff = CUTOFF_RATIO * 0.5 * std::min(1.0, (double)up / filter->down) / up;
+    double center = (length - 1) / 2.0;
+    double i0_beta = BesselI0(KAISER_BETA);
+    std::vector<double> prototype(length);
+    for (int n = 0; n < length; n++) {
+        double x = n - center;
+        double sinc = x == 0 ? 2 * cutoff : sin(2 * M_PI * cutoff * x) / (M_PI * x);
+        double r = 2.0 * n / (length - 1) - 1.0;
+        prototype[n] = sinc * BesselI0(KAISER_BETA * sqrt(std::max(0.0, 1.0 - r * r))) / i0_beta;
+    }
+
+    // 拆成 L 相，每相单独归一化为单位直流增益，按时间正序存放便于顺序乘加
+    filter->coefficients.resize(length);
+    for (int phase = 0; phase < up; phase++) {
+        double sum = 0;
+        for (int k = 0; k < filter->taps; k++) {
+            sum += prototype[phase + k * up];
+        }
+        for (int k = 0; k < filter->taps; k++) {
+            double c = prototype[phase + k * up] / sum;
+            filter->coefficients[phase * filter->taps + filter->taps - 1 - k] = (int16_t)std::clamp(lround(c * 32768), -32768L, 32767L);
+        }
+    }
+    ESP_LOGI(TAG, "Filter %d -> %d Hz: %d phases x %d taps", input_sample_rate, output_sample_rate, up, filter->taps);
+    return filter;
+}
+
+std::shared_ptr<const PolyphaseResampler::Filter> PolyphaseResampler::GetFilter(int input_sample_rate, int output_sample_rate) {
+    static std::mutex mutex;
+    static std::vector<std::shared_ptr<const Filter>> cache;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = std::find_if(cache.begin(), cache.end(), [=](const std::shared_ptr<const Filter>& filter) {
+        return filter->input_rate == input_sample_rate && filter->output_rate == output_sample_rate;
+    });
+    std::shared_ptr<const Filter> filter;
+    if (it != cache.end()) {
+        filter = *it;
+        cache.erase(it);
+    } else {
+        filter = CreateFilter(input_sample_rate, output_sample_rate);
+        if (cache.size() >= FILTER_CACHE_SIZE) {
+            cache.erase(cache.begin());
+        }
+    }
+    // 最近使用的放在最后
+    cache.push_back(filter);
+    return filter;
+}
+
+void PolyphaseResampler::Configure(int input_sample_rate, int output_sample_rate) {
+    if (filter_ && filter_->input_rate == input_sample_rate && filter_->output_rate == output_sample_rate) {
+        Reset();
+        return;
+    }
+    filter_ = GetFilter(input_sample_rate, output_sample_rate);
+    Reset();
+}
+
+void PolyphaseResampler::Reset() {
+    work_.assign(filter_ ? filter_->taps - 1 : 0, 0);
+    position_ = 0;
+}
+
+int PolyphaseResampler::GetOutputSamples(int input_samples) const {
+    if (!filter_) {
+        return input_samples;
+    }
+    return ((int64_t)input_samples * filter_->up + filter_->down - 1) / filter_->down + 1;
+}
+
+// 4 路累加的 Q15 乘加，抽头数为 4 的倍数
+static inline int32_t DotProduct(const int16_t* samples, const int16_t* coefficients, int taps) {
+    int32_t acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+    for (int k = 0; k < taps; k += 4) {
+        acc0 += samples[k] * coefficients[k];
+        acc1 += samples[k + 1] * coefficients[k + 1];
+        acc2 += samples[k + 2] * coefficients[k + 2];
+        acc3 += samples[k + 3] * coefficients[k + 3];
+    }
+    return acc0 + acc1 + acc2 + acc3;
+}
+
+int PolyphaseResampler::Process(const int16_t* input, int input_samples, int16_t* output) {
+    if (!filter_) {
+        memmove(output, input, input_samples * sizeof(int16_t));
+        return input_samples;
+    }
+    const int taps = filter_->taps;
+    const int up = filter_->up;
+    const int down = filter_->down;
+    const int16_t* coefficients = filter_->coefficients.data();
+
+    // work_ = 上一块留下的 taps - 1 个样本 + 本块输入
+    size_t history = taps - 1;
+    work_.resize(history + input_samples);
+    memcpy(work_.data() + history, input, input_samples * sizeof(int16_t));
+
+    int written = 0;
+    int64_t end = (int64_t)input_samples * up;
+    const int16_t* samples = work_.data();
+    for (; position_ < end; position_ += down) {
+        int index = position_ / up;
+        int phase = position_ - (int64_t)index * up;
+        // 输出第 index 个输入样本及其之前 taps - 1 个样本的加权和
+        int32_t acc = DotProduct(samples + index, coefficients + phase * taps, taps);
+        output[written++] = (int16_t)std::clamp((acc + (1 << 14)) >> 15, -32768, 32767);
+    }
+    position_ -= end;
+
+    // 保留最后 taps - 1 个样本作为下一块的历史
+    memmove(work_.data(), work_.data() + input_samples, history * sizeof(int16_t));
+    work_.resize(history);
+    return written;
+}
+
+void PolyphaseResampler::Process(const std::vector<int16_t>& input, std::vector<int16_t>& output) {
+    output.resize(GetOutputSamples(input.size()));
+    output.resize(Process(input.data(), input.size(), output.data()));
+}
@@ -0,0 +1,55 @@
+#ifndef POLYPHASE_RESAMPLER_H
+#define POLYPHASE_RESAMPLER_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Fixed-point polyphase resampler for any rational ratio (16k <-> 24k / 48k, 44.1k MP3, ...).
+ *
+ * The windowed-sinc filter is split into L phases of `taps` Q15 coefficients each, where the
+ * ratio is L / M after reducing by the gcd. Filters are built once per (in, out) rate pair and
+ * shared from a small cache, so switching rates only swaps a pointer and resets the history.
+ *
+ * Input can arrive in blocks of any size, the filter history and the output phase carry across
+ * blocks. The input is copied behind the history first, so output may reuse the input buffer
+ * (in place) as long as it is large enough for the output.
+ */
+class PolyphaseResampler {
+public:
+    struct Filter {
+        int input_rate;
+        int output_rate;
+        int up;                     // L
+        int down;                   // M
+        int taps;                   // Coefficients per phase, a multiple of 4
+        std::vector<int16_t> coefficients;  // up * taps, each phase stored oldest sample first
+    };
+
+    void Configure(int input_sample_rate, int output_sample_rate);
+    void Reset();
+
+    // Upper bound of the output samples for the given input samples
+    int GetOutputSamples(int input_samples) const;
+    // Returns the number of output samples written
+    int Process(const int16_t* input, int input_samples, int16_t* output);
+    // Resample into output, reusing its capacity
+    void Process(const std::vector<int16_t>& input, std::vector<int16_t>& output);
+
+    int input_sample_rate() const { return filter_ ? filter_->input_rate : 0; }
+    int output_sample_rate() const { return filter_ ? filter_->output_rate : 0; }
+    bool configured() const { return filter_ != nullptr; }
+
+    static std::shared_ptr<const Filter> GetFilter(int input_sample_rate, int output_sample_rate);
+
+private:
+    std::shared_ptr<const Filter> filter_;
+    std::vector<int16_t> work_;     // taps - 1 history samples followed by the current block
+    int64_t position_ = 0;          // Next output position in 1/L input samples, relative to the block
+
+    static std::shared_ptr<const Filter> CreateFilter(int input_sample_rate, int output_sample_rate);
+};
+
+#endif // POLYPHASE_RESAMPLER_H
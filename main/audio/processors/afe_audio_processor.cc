@@ -1,7 +1,9 @@
 #include "afe_audio_processor.h"
 #include <esp_log.h>
+#include <algorithm>
 
 #define PROCESSOR_RUNNING 0x01
+#define OUTPUT_BUFFER_POOL_SIZE 4
 
 #define TAG "AfeAudioProcessor"
 
@@ -15,7 +17,7 @@ void AfeAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms, srm
     frame_samples_ = frame_duration_ms * 16000 / 1000;
 
     // Pre-allocate output buffer capacity
-    output_buffer_.reserve(frame_samples_);
+    output_buffer_ = TakeBuffer();
 
     int ref_num = codec_->input_reference() ? 1 : 0;
 
@@ -104,6 +106,10 @@ void AfeAudioProcessor::Stop() {
     if (afe_data_ != nullptr) {
         afe_iface_->reset_buffer(afe_data_);
     }
+    if (output_frames_ > 0) {
+        ESP_LOGI(TAG, "Output %lu frames with %lu buffer allocations (%.2f/s)", output_frames_, output_allocations_,
+            output_allocations_ * 1000.0f / (output_frames_ * (frame_samples_ / 16)));
+    }
 }
 
 bool AfeAudioProcessor::IsRunning() {
@@ -114,6 +120,30 @@ void AfeAudioProcessor::OnOutput(std::function<void(std::vector<int16_t>&& data)
     output_callback_ = callback;
 }
 
+std::vector<int16_t> AfeAudioProcessor::TakeBuffer() {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    if (!buffer_pool_.empty()) {
+        auto buffer = std::move(buffer_pool_.back());
+        buffer_pool_.pop_back();
+        buffer.clear();
+        return buffer;
+    }
+    output_allocations_++;
+    std::vector<int16_t> buffer;
+    buffer.reserve(frame_samples_);
+    return buffer;
+}
+
+void AfeAudioProcessor::Recycle(std::vector<int16_t>&& buffer) {
+    if (buffer.capacity() < (size_t)frame_samples_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    if (buffer_pool_.size() < OUTPUT_BUFFER_POOL_SIZE) {
+        buffer_pool_.push_back(std::move(buffer));
+    }
+}
+
 void AfeAudioProcessor::OnVadStateChange(std::function<void(bool speaking)> callback) {
     vad_state_change_callback_ = callback;
 }
@@ -150,22 +180,22 @@ void AfeAudioProcessor::AudioProcessorTask() {
         }
 
         if (output_callback_) {
+            // AFE 每次输出 512 个采样，按 Opus 帧长切分：一次输出可能跨两帧，只拷贝一次
+            const int16_t* data = res->data;
             size_t samples = res->data_size / sizeof(int16_t);
-            
-            // Add data to buffer
-            output_buffer_.insert(output_buffer_.end(), res->data, res->data + samples);
-            
-            // Output complete frames when buffer has enough data
-            while (output_buffer_.size() >= frame_samples_) {
-                if (output_buffer_.size() == frame_samples_) {
-                    // If buffer size equals frame size, move the entire buffer
+            while (samples > 0) {
+                if (output_buffer_.capacity() < (size_t)frame_samples_) {
+                    output_buffer_ = TakeBuffer();
+                }
+                size_t count = std::min(samples, frame_samples_ - output_buffer_.size());
+                output_buffer_.insert(output_buffer_.end(), data, data + count);
+                data += count;
+                samples -= count;
+
+                if (output_buffer_.size() == (size_t)frame_samples_) {
+                    output_frames_++;
                     output_callback_(std::move(output_buffer_));
-                    output_buffer_.clear();
-                    output_buffer_.reserve(frame_samples_);
-                } else {
-                    // If buffer size exceeds frame size, copy one frame and remove it
-                    output_callback_(std::vector<int16_t>(output_buffer_.begin(), output_buffer_.begin() + frame_samples_));
-                    output_buffer_.erase(output_buffer_.begin(), output_buffer_.begin() + frame_samples_);
+                    output_buffer_ = TakeBuffer();
                 }
             }
         }
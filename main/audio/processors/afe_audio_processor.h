@@ -9,6 +9,7 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <mutex>
 
 #include "audio_processor.h"
 #include "audio_codec.h"
@@ -27,6 +28,7 @@ public:
     void OnVadStateChange(std::function<void(bool speaking)> callback) override;
     size_t GetFeedSize() override;
     void EnableDeviceAec(bool enable) override;
+    void Recycle(std::vector<int16_t>&& buffer) override;
 
 private:
     EventGroupHandle_t event_group_ = nullptr;
@@ -37,9 +39,15 @@ private:
     AudioCodec* codec_ = nullptr;
     int frame_samples_ = 0;
     bool is_speaking_ = false;
+    // The frame being filled, AFE output is copied straight into it and emitted when full
     std::vector<int16_t> output_buffer_;
+    std::mutex pool_mutex_;
+    std::vector<std::vector<int16_t>> buffer_pool_;
+    uint32_t output_frames_ = 0;
+    uint32_t output_allocations_ = 0;
 
     void AudioProcessorTask();
+    std::vector<int16_t> TakeBuffer();
 };
 
 #endif 
\ No newline at end of file
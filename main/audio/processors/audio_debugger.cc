@@ -8,6 +8,7 @@
 #include <errno.h>
 #include <cstring>
 #include <string>
+#include <sys/time.h>
 #endif
 
 #define TAG "AudioDebugger"
@@ -65,4 +66,58 @@ void AudioDebugger::Feed(const std::vector<int16_t>& data) {
 #endif
 }
 
- 
\ No newline at end of file
+ 
+
+void AudioDebugger::SendText(const std::string& text) {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    if (udp_sockfd_ >= 0) {
+        sendto(udp_sockfd_, text.data(), text.size(), 0, (struct sockaddr*)&udp_server_addr_, sizeof(udp_server_addr_));
+    }
+#endif
+}
+
+void AudioDebugger::ReportEvent(const char* name, const std::string& value) {
+    // 事件位置以回放的采样帧计，主机据此计算检测延迟
+    SendText("EVT " + std::string(name) + " " + std::to_string(replay_position_) + " " + value);
+}
+
+AudioDebugger::ReplayCommand AudioDebugger::ReadReplay(std::vector<int16_t>& data, int frames, int channels, uint32_t last_feed_us) {
+#if CONFIG_AUDIO_DEBUG_REPLAY
+    if (udp_sockfd_ < 0) {
+        return kReplayNone;
+    }
+    struct timeval timeout = { .tv_sec = 1, .tv_usec = 0 };
+    setsockopt(udp_sockfd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // 设备按需拉取，主机控制回放速度（实时或加速）
+    std::string request = "READ " + std::to_string(frames) + " " + std::to_string(channels) + " " + std::to_string(last_feed_us);
+    data.resize(frames * channels);
+    size_t expected = data.size() * sizeof(int16_t);
+    char packet[16];
+    while (true) {
+        SendText(request);
+        struct iovec iov[2] = { { packet, 4 }, { data.data(), expected } };
+        struct msghdr msg = {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+        ssize_t received = recvmsg(udp_sockfd_, &msg, 0);
+        if (received < 0) {
+            // 主机尚未启动或丢包，重新请求
+            continue;
+        }
+        if (received == (ssize_t)(4 + expected) && memcmp(packet, "PCM ", 4) == 0) {
+            replay_position_ += frames;
+            return kReplayAudio;
+        }
+        if (received >= 4 && memcmp(packet, "STRT", 4) == 0) {
+            replay_position_ = 0;
+            bool vad = received > 4 && ((char*)data.data())[0] == 'V';
+            ESP_LOGI(TAG, "Replay started, evaluating %s", vad ? "VAD" : "wake word");
+            return vad ? kReplayStartVad : kReplayStartWakeWord;
+        }
+        ESP_LOGW(TAG, "Unexpected replay packet, %d bytes", (int)received);
+    }
+#else
+    return kReplayNone;
+#endif
+}
@@ -2,6 +2,7 @@
 #define AUDIO_DEBUGGER_H
 
 #include <vector>
+#include <string>
 #include <cstdint>
 
 #include <sys/socket.h>
@@ -14,9 +15,24 @@ public:
 
     void Feed(const std::vector<int16_t>& data);
 
+    // Replay mode: the host (scripts/audio_eval) sends labeled audio in place of the microphone
+    // and receives the detection events, see CONFIG_AUDIO_DEBUG_REPLAY
+    enum ReplayCommand {
+        kReplayNone,
+        kReplayAudio,
+        kReplayStartWakeWord,   // A new file starts, evaluate the wake word
+        kReplayStartVad,        // A new file starts, evaluate the audio processor VAD
+    };
+    // Request frames * channels samples from the host, blocks until the host answers
+    ReplayCommand ReadReplay(std::vector<int16_t>& data, int frames, int channels, uint32_t last_feed_us);
+    void ReportEvent(const char* name, const std::string& value);
+
 private:
     int udp_sockfd_ = -1;
     struct sockaddr_in udp_server_addr_;
+    uint64_t replay_position_ = 0;
+
+    void SendText(const std::string& text);
 };
 
 #endif 
\ No newline at end of file
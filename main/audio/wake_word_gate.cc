@@ -0,0 +1,108 @@
+#include "wake_word_gate.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cmath>
+
+#define TAG "WakeWordGate"
+
+// 噪声底的下限，避免全零输入时门限过于敏感
+#define NOISE_FLOOR_MIN_DB -70.0f
+// 噪声底下降立即跟随，上升很慢：安静时约 1.5 秒，有声音时约 15 秒，
+// 持续的平稳噪声（风扇等）最终会被当作噪声底，门限不会一直打开
+#define NOISE_FLOOR_RISE 0.02f
+#define NOISE_FLOOR_RISE_ACTIVE 0.002f
+// 打开后的迟滞，低于打开门限这么多才算安静
+#define HYSTERESIS_DB 3.0f
+// 过零率高于此值时，较低的能量也可以打开门限（清辅音起始）
+#define FRICATIVE_ZCR 0.25f
+
+void WakeWordGate::Configure(int sample_rate, float margin_db, int hangover_ms) {
+    sample_rate_ = sample_rate;
+    margin_db_ = margin_db;
+    hangover_samples_ = hangover_ms * sample_rate / 1000;
+    quiet_samples_ = 0;
+    // 从 0 dB 开始，第一块音频就把噪声底拉到实际水平
+    noise_floor_db_ = 0.0f;
+    // 启动时保持打开，直到噪声底稳定下来
+    open_ = true;
+    stats_ = Stats();
+}
+
+bool WakeWordGate::Process(const int16_t* data, size_t frames, int channels) {
+    if (frames == 0) {
+        return open_;
+    }
+
+    // 分成 4 路独立累加，便于编译器展开和流水线并行
+    int64_t energy[4] = { 0, 0, 0, 0 };
+    int crossings = 0;
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        int32_t s0 = data[(i + 0) * channels];
+        int32_t s1 = data[(i + 1) * channels];
+        int32_t s2 = data[(i + 2) * channels];
+        int32_t s3 = data[(i + 3) * channels];
+        energy[0] += s0 * s0;
+        energy[1] += s1 * s1;
+        energy[2] += s2 * s2;
+        energy[3] += s3 * s3;
+        crossings += ((s0 ^ s1) < 0) + ((s1 ^ s2) < 0) + ((s2 ^ s3) < 0);
+        if (i + 4 < frames) {
+            crossings += (s3 ^ data[(i + 4) * channels]) < 0;
+        }
+    }
+    for (; i < frames; i++) {
+        int32_t s = data[i * channels];
+        energy[0] += s * s;
+        if (i + 1 < frames) {
+            crossings += (s ^ data[(i + 1) * channels]) < 0;
+        }
+    }
+
+    float mean_square = (float)(energy[0] + energy[1] + energy[2] + energy[3]) / frames;
+    float level_db = 10.0f * log10f(mean_square / (32768.0f * 32768.0f) + 1e-10f);
+    float zcr = (float)crossings / frames;
+
+    float threshold = noise_floor_db_ + margin_db_;
+    bool active;
+    if (open_) {
+        active = level_db > threshold - HYSTERESIS_DB;
+    } else {
+        active = level_db > threshold || (level_db > threshold - margin_db_ / 2 && zcr > FRICATIVE_ZCR);
+    }
+
+    if (active) {
+        quiet_samples_ = 0;
+        if (!open_) {
+            open_ = true;
+            stats_.openings++;
+            ESP_LOGD(TAG, "Open: level %.1f dB, floor %.1f dB, zcr %.2f", level_db, noise_floor_db_, zcr);
+        }
+    } else {
+        quiet_samples_ += frames;
+        if (open_ && quiet_samples_ >= hangover_samples_) {
+            open_ = false;
+            ESP_LOGD(TAG, "Close: floor %.1f dB", noise_floor_db_);
+        }
+    }
+
+    if (level_db < noise_floor_db_) {
+        noise_floor_db_ = level_db;
+    } else {
+        noise_floor_db_ += (level_db - noise_floor_db_) * (active ? NOISE_FLOOR_RISE_ACTIVE : NOISE_FLOOR_RISE);
+    }
+    noise_floor_db_ = std::max(noise_floor_db_, NOISE_FLOOR_MIN_DB);
+
+    stats_.chunks++;
+    if (open_) {
+        stats_.open_chunks++;
+    }
+    return open_;
+}
+
+WakeWordGate::Stats WakeWordGate::TakeStats() {
+    Stats stats = stats_;
+    stats_ = Stats();
+    return stats;
+}
@@ -0,0 +1,44 @@
+#ifndef WAKE_WORD_GATE_H
+#define WAKE_WORD_GATE_H
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Cheap energy / zero-crossing gate in front of the wake word engine.
+ *
+ * Every captured chunk is measured (mean energy of the mic channel and zero-crossing rate)
+ * against an adaptive noise floor. The gate opens when a chunk is clearly above the floor, or
+ * moderately above it with a high zero-crossing rate (fricative onsets like "x" in "xiao"),
+ * and closes after a hangover of quiet chunks. While it is closed the caller skips wakenet
+ * and keeps a short look-back in the capture ring, which is fed first when the gate opens.
+ */
+class WakeWordGate {
+public:
+    struct Stats {
+        uint32_t chunks = 0;
+        uint32_t open_chunks = 0;
+        uint32_t openings = 0;
+    };
+
+    void Configure(int sample_rate, float margin_db, int hangover_ms);
+
+    // Measure a chunk of interleaved samples (the mic is channel 0), returns true if the gate is open
+    bool Process(const int16_t* data, size_t frames, int channels);
+    bool is_open() const { return open_; }
+    float noise_floor_db() const { return noise_floor_db_; }
+
+    // Statistics since the last call
+    Stats TakeStats();
+
+private:
+    int sample_rate_ = 16000;
+    float margin_db_ = 9.0f;
+    int hangover_samples_ = 0;
+    int quiet_samples_ = 0;
+    float noise_floor_db_ = 0.0f;
+    bool open_ = true;
+    Stats stats_;
+};
+
+#endif // WAKE_WORD_GATE_H
@@ -9,6 +9,7 @@
 #include "alarm_manager.h"
 #include "pomodoro_timer.h"
 #include "meditation_timer.h"
+#include "briefing_cache.h"
 #include "mcp_server.h"
 #include <cJSON.h>
 
@@ -353,13 +354,24 @@ private:
         });
         
         alarm_mgr.OnAlarmDismissed([&app](AlarmType type) {
-            app.Schedule([&app]() {
+            app.Schedule([&app, type]() {
                 auto display = Board::GetInstance().GetDisplay();
                 display->SetStatus(Lang::Strings::STANDBY);
                 display->SetEmotion("neutral");
                 display->SetChatMessage("system", "");
+
+                if (type == kAlarmTypeWakeUp) {
+                    // 优先播放预取的新闻播报，未命中缓存时再实时请求大模型生成
+                    if (!BriefingCache::GetInstance().Play(app.GetAudioService())) {
+                        app.WakeWordInvoke("播报今天的新闻");
+                    }
+                }
             });
         });
+
+        alarm_mgr.OnBriefingPrefetch(BRIEFING_PREFETCH_LEAD_MINUTES, []() {
+            BriefingCache::GetInstance().StartPrefetch();
+        });
         
         // 起床唤醒 - 设置时间
         mcp_server.AddTool("self.alarm.set_wake_up_time",
@@ -466,6 +478,18 @@ private:
                 return std::string(enable ? "起床唤醒已启用" : "起床唤醒已禁用");
             });
         
+        // 起床唤醒 - 设置新闻播报地址
+        mcp_server.AddTool("self.alarm.set_briefing_url",
+            "设置起床新闻播报音频（Ogg Opus）的下载地址。设备会在闹钟响铃前提前下载并缓存，关闭闹钟后立即播放。",
+            PropertyList({
+                Property("url", kPropertyTypeString)
+            }),
+            [](const PropertyList& properties) -> ReturnValue {
+                auto url = properties["url"].value<std::string>();
+                BriefingCache::GetInstance().SetUrl(url);
+                return std::string("新闻播报地址已设置");
+            });
+
         // 起床唤醒 - 延迟提醒
         mcp_server.AddTool("self.alarm.snooze_wake_up_alarm",
             "延迟起床唤醒几分钟后再次提醒。",
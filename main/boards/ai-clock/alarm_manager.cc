@@ -53,6 +53,7 @@ bool AlarmManager::SetWakeUpAlarm(int hour, int minute, AlarmRingIntensity inten
     wake_up_state_ = kAlarmStateEnabled;
     wake_up_snooze_minutes_ = 0;
     wake_up_snooze_until_ = 0;
+    briefing_prefetch_requested_ = false;
     
     SaveConfig();
     ESP_LOGI(TAG, "Wake up alarm set to %02d:%02d, intensity: %s", 
@@ -201,9 +202,17 @@ void AlarmManager::CheckAlarms() {
     
     // 检查起床闹钟
     if (wake_up_state_ == kAlarmStateEnabled && wake_up_hour_ >= 0 && wake_up_minute_ >= 0) {
+        // 响铃前提前预取新闻播报，关闭闹钟时即可立即播放
+        if (on_briefing_prefetch_ && !briefing_prefetch_requested_ &&
+            CalculateSecondsToTime(wake_up_hour_, wake_up_minute_) <= briefing_prefetch_lead_minutes_ * 60) {
+            briefing_prefetch_requested_ = true;
+            ESP_LOGI(TAG, "Prefetching briefing for wake up alarm at %02d:%02d", wake_up_hour_, wake_up_minute_);
+            on_briefing_prefetch_();
+        }
         if (tm_now->tm_hour == wake_up_hour_ && tm_now->tm_min == wake_up_minute_) {
             if (wake_up_state_ != kAlarmStateRinging) {
                 wake_up_state_ = kAlarmStateRinging;
+                briefing_prefetch_requested_ = false;
                 if (on_wake_up_triggered_) {
                     on_wake_up_triggered_(wake_up_intensity_);
                 }
@@ -294,6 +303,11 @@ void AlarmManager::OnAlarmDismissed(std::function<void(AlarmType)> callback) {
     on_alarm_dismissed_ = callback;
 }
 
+void AlarmManager::OnBriefingPrefetch(int lead_minutes, std::function<void()> callback) {
+    briefing_prefetch_lead_minutes_ = lead_minutes;
+    on_briefing_prefetch_ = callback;
+}
+
 // void AlarmManager::StartNewsBroadcast() {
 //     news_broadcasting_ = true;
 //     ESP_LOGI(TAG, "News broadcast started");
@@ -64,6 +64,8 @@ public:
     void OnSleepAlarmStart(std::function<void()> callback);
     void OnSleepAlarmStop(std::function<void()> callback);
     void OnAlarmDismissed(std::function<void(AlarmType)> callback);
+    // 起床闹钟响铃前 lead_minutes 分钟触发，用于预取新闻播报
+    void OnBriefingPrefetch(int lead_minutes, std::function<void()> callback);
     
     // 获取闹钟状态
     AlarmState GetWakeUpAlarmState() const { return wake_up_state_; }
@@ -106,6 +108,8 @@ private:
     
     // 新闻播报
     bool news_broadcasting_ = false;
+    int briefing_prefetch_lead_minutes_ = 0;
+    bool briefing_prefetch_requested_ = false;
     
     // 定时器
     esp_timer_handle_t check_timer_ = nullptr;
@@ -116,6 +120,7 @@ private:
     std::function<void()> on_sleep_start_;
     std::function<void()> on_sleep_stop_;
     std::function<void(AlarmType)> on_alarm_dismissed_;
+    std::function<void()> on_briefing_prefetch_;
     
     // 计算到指定时间的秒数
     int64_t CalculateSecondsToTime(int hour, int minute);
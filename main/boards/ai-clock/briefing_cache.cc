@@ -0,0 +1,287 @@
+#include "briefing_cache.h"
+#include "config.h"
+#include "board.h"
+#include "settings.h"
+#include "system_info.h"
+#include "audio_service.h"
+#include "assets/lang_config.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "BriefingCache"
+
+
+BriefingCache::~BriefingCache() {
+    FreeData();
+}
+
+void BriefingCache::FreeData() {
+    if (data_ != nullptr) {
+        heap_caps_free(data_);
+        data_ = nullptr;
+    }
+    data_size_ = 0;
+    packets_.clear();
+    fetched_at_ = 0;
+}
+
+void BriefingCache::SetUrl(const std::string& url) {
+    Settings settings("alarm", true);
+    settings.SetString("briefing_url", url);
+    Invalidate();
+}
+
+std::string BriefingCache::GetUrl() {
+    Settings settings("alarm", false);
+    return settings.GetString("briefing_url");
+}
+
+bool BriefingCache::IsReady() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return IsReadyLocked();
+}
+
+bool BriefingCache::IsPrefetching() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return prefetching_;
+}
+
+bool BriefingCache::IsReadyLocked() {
+    if (packets_.empty()) {
+        return false;
+    }
+    // 缓存过旧（例如闹钟被推迟了很久）则视为无效
+    return esp_timer_get_time() - fetched_at_ < BRIEFING_MAX_AGE_MINUTES * 60 * 1000000LL;
+}
+
+void BriefingCache::Invalidate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (playing_) {
+        // 正在播放时由播放任务在结束后释放
+        fetched_at_ = 0;
+        return;
+    }
+    FreeData();
+}
+
+void BriefingCache::StartPrefetch() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (prefetching_) {
+        ESP_LOGW(TAG, "Prefetch is already running");
+        return;
+    }
+
+    prefetching_ = true;
+    auto ret = xTaskCreate([](void* arg) {
+        BriefingCache* cache = (BriefingCache*)arg;
+        cache->Prefetch();
+        std::lock_guard<std::mutex> lock(cache->mutex_);
+        cache->prefetching_ = false;
+        vTaskDelete(NULL);
+    }, "briefing_prefetch", 8192, this, 2, nullptr);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create prefetch task");
+        prefetching_ = false;
+    }
+}
+
+bool BriefingCache::Prefetch() {
+    std::string url = GetUrl();
+    if (url.empty()) {
+        ESP_LOGW(TAG, "Briefing URL is not set, skip prefetch");
+        return false;
+    }
+
+    auto start_time = esp_timer_get_time();
+    auto& board = Board::GetInstance();
+    auto http = board.GetNetwork()->CreateHttp(4);
+    http->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
+    http->SetHeader("Client-Id", board.GetUuid());
+    http->SetHeader("User-Agent", SystemInfo::GetUserAgent());
+    http->SetHeader("Accept-Language", Lang::CODE);
+    http->SetHeader("Accept", "audio/ogg, audio/mpeg, audio/wav");
+
+    if (!http->Open("GET", url)) {
+        ESP_LOGE(TAG, "Failed to open HTTP connection");
+        return false;
+    }
+    if (http->GetStatusCode() != 200) {
+        ESP_LOGE(TAG, "Failed to get briefing, status code: %d", http->GetStatusCode());
+        return false;
+    }
+
+    // Content-Length 未知（chunked）时按上限分配，下载完成后再收缩
+    size_t content_length = http->GetBodyLength();
+    if (content_length > BRIEFING_MAX_SIZE) {
+        ESP_LOGE(TAG, "Briefing size (%u) is larger than limit (%u)", content_length, BRIEFING_MAX_SIZE);
+        return false;
+    }
+    size_t capacity = content_length > 0 ? content_length : BRIEFING_MAX_SIZE;
+    uint8_t* data = (uint8_t*)heap_caps_malloc(capacity, MALLOC_CAP_SPIRAM);
+    if (data == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes in PSRAM", capacity);
+        return false;
+    }
+
+    size_t total_read = 0;
+    while (total_read < capacity) {
+        int ret = http->Read((char*)data + total_read, capacity - total_read);
+        if (ret < 0) {
+            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
+            heap_caps_free(data);
+            return false;
+        }
+        if (ret == 0) {
+            break;
+        }
+        total_read += ret;
+    }
+    if (content_length == 0 && total_read == capacity) {
+        // chunked 响应填满了上限，再读一个字节确认没有被截断
+        char extra;
+        if (http->Read(&extra, 1) > 0) {
+            ESP_LOGE(TAG, "Briefing is larger than limit (%u), the chunked body would be truncated", BRIEFING_MAX_SIZE);
+            http->Close();
+            heap_caps_free(data);
+            return false;
+        }
+    }
+    http->Close();
+
+    if (content_length > 0 && total_read != content_length) {
+        ESP_LOGE(TAG, "Downloaded size (%u) does not match expected size (%u)", total_read, content_length);
+        heap_caps_free(data);
+        return false;
+    }
+    if (total_read < capacity) {
+        auto shrunk = (uint8_t*)heap_caps_realloc(data, total_read, MALLOC_CAP_SPIRAM);
+        if (shrunk != nullptr) {
+            data = shrunk;
+        }
+    }
+
+    // 预先解析 Ogg 页，记录每个 Opus 包的位置，播放时无需再解析容器
+    std::vector<OpusPacketIndex> packets;
+    int sample_rate = 16000;
+    auto ogg = std::string_view(reinterpret_cast<const char*>(data), total_read);
+    bool valid = AudioService::ParseOggOpus(ogg, [&](int rate, const uint8_t* pkt, size_t size) {
+        sample_rate = rate;
+        packets.push_back(OpusPacketIndex{
+            .offset = static_cast<uint32_t>(pkt - data),
+            .size = static_cast<uint16_t>(size)
+        });
+    });
+    auto format = kAudioStreamFormatOpus;
+    if (!valid || packets.empty()) {
+        // MP3 / WAV 直接按固定大小分块播放，由设备端解码
+        format = AudioService::DetectStreamFormat(ogg);
+        if (format == kAudioStreamFormatOpus) {
+            ESP_LOGE(TAG, "The briefing is not a valid Ogg Opus, MP3 or WAV stream");
+            heap_caps_free(data);
+            return false;
+        }
+        packets.clear();
+        for (size_t offset = 0; offset < total_read; offset += AUDIO_STREAM_CHUNK_SIZE) {
+            packets.push_back(OpusPacketIndex{
+                .offset = static_cast<uint32_t>(offset),
+                .size = static_cast<uint16_t>(std::min<size_t>(AUDIO_STREAM_CHUNK_SIZE, total_read - offset))
+            });
+        }
+    }
+
+    size_t packet_count = packets.size();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (playing_) {
+            ESP_LOGW(TAG, "Briefing is playing, drop the prefetched data");
+            heap_caps_free(data);
+            return false;
+        }
+        FreeData();
+        data_ = data;
+        data_size_ = total_read;
+        sample_rate_ = sample_rate;
+        format_ = format;
+        packets_ = std::move(packets);
+        fetched_at_ = esp_timer_get_time();
+    }
+
+    ESP_LOGI(TAG, "Briefing prefetched: %u bytes, %u %s packets, took %d ms",
+        total_read, packet_count, format == kAudioStreamFormatOpus ? "Opus" : (format == kAudioStreamFormatMp3 ? "MP3" : "WAV"),
+        int((esp_timer_get_time() - start_time) / 1000));
+    return true;
+}
+
+bool BriefingCache::Play(AudioService& audio_service) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (playing_) {
+        ESP_LOGW(TAG, "Briefing is already playing");
+        return true;
+    }
+    if (!IsReadyLocked()) {
+        ESP_LOGW(TAG, "Briefing cache miss");
+        return false;
+    }
+
+    playing_ = true;
+    play_requested_at_ = esp_timer_get_time();
+    audio_service_ = &audio_service;
+    // 播放可能持续数分钟，放到独立任务中向解码队列推送，避免阻塞主循环
+    auto ret = xTaskCreate([](void* arg) {
+        BriefingCache* cache = (BriefingCache*)arg;
+        cache->PlayTask();
+        vTaskDelete(NULL);
+    }, "briefing_play", 4096, this, 3, nullptr);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create play task");
+        playing_ = false;
+        return false;
+    }
+    return true;
+}
+
+void BriefingCache::PlayTask() {
+    auto& audio_service = *audio_service_;
+    // 清掉仍在队列中的闹铃声音，让播报立即开始
+    audio_service.ResetDecoder();
+    uint32_t playback_count = audio_service.GetPlaybackCount();
+    bool first_audio_measured = false;
+
+    for (size_t i = 0; i < packets_.size(); i++) {
+        auto packet = std::make_unique<AudioStreamPacket>();
+        packet->sample_rate = sample_rate_;
+        packet->frame_duration = 60;
+        packet->format = format_;
+        packet->payload.assign(data_ + packets_[i].offset, data_ + packets_[i].offset + packets_[i].size);
+        audio_service.PushPacketToDecodeQueue(std::move(packet), true);
+
+        // 先推入少量包，等待第一帧真正写入 codec 后统计首帧延迟
+        if (!first_audio_measured && (i == 2 || i + 1 == packets_.size())) {
+            bool started = false;
+            for (int wait_ms = 0; wait_ms < 2000; wait_ms += 5) {
+                if (audio_service.GetPlaybackCount() != playback_count) {
+                    started = true;
+                    break;
+                }
+                vTaskDelay(pdMS_TO_TICKS(5));
+            }
+            first_audio_measured = true;
+            if (started) {
+                ESP_LOGI(TAG, "Briefing time to first audio: %d ms",
+                    int((esp_timer_get_time() - play_requested_at_) / 1000));
+            } else {
+                ESP_LOGW(TAG, "Briefing playback did not start within 2000 ms");
+            }
+        }
+    }
+
+    ESP_LOGI(TAG, "Briefing playback queued, %u packets", packets_.size());
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 每次播报只用一次，下次闹钟前重新获取
+    FreeData();
+    playing_ = false;
+}
@@ -0,0 +1,68 @@
+#ifndef BRIEFING_CACHE_H
+#define BRIEFING_CACHE_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+#include "protocol.h"
+
+class AudioService;
+
+// 起床新闻播报缓存：闹钟响铃前在后台下载 Ogg Opus（或 MP3 / WAV）音频到 PSRAM，
+// 并预先解析出包索引，关闭闹钟后即可直接送入解码队列播放。
+class BriefingCache {
+public:
+    static BriefingCache& GetInstance() {
+        static BriefingCache instance;
+        return instance;
+    }
+
+    BriefingCache(const BriefingCache&) = delete;
+    BriefingCache& operator=(const BriefingCache&) = delete;
+
+    void SetUrl(const std::string& url);
+    std::string GetUrl();
+
+    // 在后台任务中预取播报音频，不阻塞调用者（可在 esp_timer 回调中调用）
+    void StartPrefetch();
+    bool IsReady();
+    bool IsPrefetching();
+
+    // 播放缓存的播报，缓存无效时返回 false
+    bool Play(AudioService& audio_service);
+    void Invalidate();
+
+private:
+    BriefingCache() = default;
+    ~BriefingCache();
+
+    struct OpusPacketIndex {
+        uint32_t offset;
+        uint16_t size;
+    };
+
+    std::mutex mutex_;
+    uint8_t* data_ = nullptr;     // PSRAM 中的原始音频数据
+    size_t data_size_ = 0;
+    int sample_rate_ = 16000;
+    AudioStreamFormat format_ = kAudioStreamFormatOpus;
+    std::vector<OpusPacketIndex> packets_;
+    int64_t fetched_at_ = 0;      // esp_timer 时间，微秒
+    int64_t play_requested_at_ = 0;
+    // 在创建任务之前于 mutex_ 内置位，任务结束时在同一把锁内清除
+    bool prefetching_ = false;
+    bool playing_ = false;
+    AudioService* audio_service_ = nullptr;
+
+    bool IsReadyLocked();
+    bool Prefetch();
+    void PlayTask();
+    void FreeData();
+};
+
+#endif // BRIEFING_CACHE_H
@@ -39,5 +39,10 @@
 #define DISPLAY_BACKLIGHT_PIN GPIO_NUM_NC
 #define DISPLAY_BACKLIGHT_OUTPUT_INVERT true
 
+// 起床新闻播报预取：闹钟响铃前多少分钟开始下载，缓存上限与有效期
+#define BRIEFING_PREFETCH_LEAD_MINUTES 10
+#define BRIEFING_MAX_SIZE (1024 * 1024)
+#define BRIEFING_MAX_AGE_MINUTES 120
+
 
 #endif // _BOARD_CONFIG_H_
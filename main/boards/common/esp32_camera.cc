@@ -5,8 +5,10 @@
 #include <unistd.h>
 #include <errno.h>
 #include <esp_heap_caps.h>
+#include <esp_timer.h>
 #include <cstdio>
 #include <cstring>
+#include <atomic>
 
 #include "esp_imgfx_color_convert.h"
 #include "esp_video_device.h"
@@ -54,6 +56,11 @@
 
 #define TAG "Esp32Camera"
 
+// 软件旋转时直接从 V4L2 的 mmap 缓冲区旋转到帧副本，不再需要额外的整帧缓冲区
+#if defined(CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE) && !defined(CONFIG_SOC_PPA_SUPPORTED)
+#define ROTATE_FROM_MMAP_BUFFER 1
+#endif
+
 #if defined(CONFIG_CAMERA_SENSOR_SWAP_PIXEL_BYTE_ORDER) || defined(CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP)
 #warning \
     "CAMERA_SENSOR_SWAP_PIXEL_BYTE_ORDER or CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP is enabled, which may cause image corruption in YUV422 format!"
@@ -274,7 +281,8 @@ Esp32Camera::Esp32Camera(const esp_video_init_config_t& config) {
 
     // 申请缓冲并mmap
     struct v4l2_requestbuffers req = {};
-    req.count = strcmp(video_device_name, ESP_VIDEO_MIPI_CSI_DEVICE_NAME) == 0 ? 2 : 1;
+    // 双缓冲：读取一帧的同时驱动可以继续向另一个缓冲区写入，两次拍照之间缓冲区一直复用
+    req.count = 2;
     req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     req.memory = V4L2_MEMORY_MMAP;
     if (ioctl(video_fd_, VIDIOC_REQBUFS, &req) != 0) {
@@ -374,6 +382,11 @@ Esp32Camera::~Esp32Camera() {
         close(video_fd_);
         video_fd_ = -1;
     }
+    if (frame_.data) {
+        heap_caps_free(frame_.data);
+        frame_.data = nullptr;
+        frame_.capacity = 0;
+    }
     sensor_format_ = 0;
     esp_video_deinit();
 }
@@ -383,6 +396,81 @@ void Esp32Camera::SetExplainUrl(const std::string& url, const std::string& token
     explain_token_ = token;
 }
 
+bool Esp32Camera::EnsureFrameCapacity(size_t len) {
+    if (frame_.data != nullptr && frame_.capacity >= len) {
+        return true;
+    }
+    if (frame_.data) {
+        heap_caps_free(frame_.data);
+        frame_.data = nullptr;
+        frame_.capacity = 0;
+    }
+    // 64 字节对齐以便直接作为软件旋转的输出
+    frame_.data = (uint8_t*)heap_caps_aligned_alloc(64, len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (frame_.data == nullptr) {
+        return false;
+    }
+    frame_.capacity = len;
+    return true;
+}
+
+// 按整数步长抽样生成 RGB565 预览图，宽度不超过 max_width，只支持常见的非压缩格式
+uint8_t* Esp32Camera::CreatePreview(uint16_t max_width, uint16_t* out_width, uint16_t* out_height) {
+    int step = max_width > 0 ? (frame_.width + max_width - 1) / max_width : 1;
+    if (step < 1) {
+        step = 1;
+    }
+    uint16_t w = frame_.width / step;
+    uint16_t h = frame_.height / step;
+    uint16_t* dst = (uint16_t*)heap_caps_malloc(w * h * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (dst == nullptr) {
+        return nullptr;
+    }
+
+    auto rgb_to_565 = [](int r, int g, int b) -> uint16_t {
+        r = r < 0 ? 0 : (r > 255 ? 255 : r);
+        g = g < 0 ? 0 : (g > 255 ? 255 : g);
+        b = b < 0 ? 0 : (b > 255 ? 255 : b);
+        return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+    };
+
+    uint16_t* d = dst;
+    for (int y = 0; y < h; y++) {
+        int sy = y * step;
+        for (int x = 0; x < w; x++) {
+            int sx = x * step;
+            switch (frame_.format) {
+                case V4L2_PIX_FMT_RGB565:
+                    *d++ = ((const uint16_t*)frame_.data)[sy * frame_.width + sx];
+                    break;
+                case V4L2_PIX_FMT_RGB24: {
+                    const uint8_t* p = frame_.data + (sy * frame_.width + sx) * 3;
+                    *d++ = rgb_to_565(p[0], p[1], p[2]);
+                    break;
+                }
+                case V4L2_PIX_FMT_GREY: {
+                    uint8_t v = frame_.data[sy * frame_.width + sx];
+                    *d++ = rgb_to_565(v, v, v);
+                    break;
+                }
+                default: {
+                    // YUYV: 每两个像素共用一组 U/V，BT.601 整数近似
+                    const uint8_t* p = frame_.data + (sy * frame_.width + (sx & ~1)) * 2;
+                    int yy = p[(sx & 1) * 2] - 16;
+                    int u = p[1] - 128;
+                    int v = p[3] - 128;
+                    int c = 298 * yy;
+                    *d++ = rgb_to_565((c + 409 * v + 128) >> 8, (c - 100 * u - 208 * v + 128) >> 8, (c + 516 * u + 128) >> 8);
+                    break;
+                }
+            }
+        }
+    }
+    *out_width = w;
+    *out_height = h;
+    return (uint8_t*)dst;
+}
+
 bool Esp32Camera::Capture() {
     if (encoder_thread_.joinable()) {
         encoder_thread_.join();
@@ -392,6 +480,8 @@ bool Esp32Camera::Capture() {
         return false;
     }
 
+    int64_t start_time = esp_timer_get_time();
+    int64_t convert_start_time = start_time;
     for (int i = 0; i < 3; i++) {
         struct v4l2_buffer buf = {};
         buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -401,15 +491,12 @@ bool Esp32Camera::Capture() {
             return false;
         }
         if (i == 2) {
-            // 保存帧副本到PSRAM
-            if (frame_.data) {
-                heap_caps_free(frame_.data);
-                frame_.data = nullptr;
-                frame_.format = 0;
-            }
+            convert_start_time = esp_timer_get_time();
+            capture_timing_.dequeue_us = convert_start_time - start_time;
+            // 保存帧副本到PSRAM，缓冲区在多次拍照之间复用
+            frame_.format = 0;
             frame_.len = buf.bytesused;
-            frame_.data = (uint8_t*)heap_caps_malloc(frame_.len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-            if (!frame_.data) {
+            if (!EnsureFrameCapacity(frame_.len)) {
                 ESP_LOGE(TAG, "alloc frame copy failed: need allocate %d bytes", buf.bytesused);
                 if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
                     ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
@@ -445,7 +532,7 @@ bool Esp32Camera::Capture() {
                         dst16[i] = __builtin_bswap16(src16[i]);
                     }
                 }
-#else
+#elif !defined(ROTATE_FROM_MMAP_BUFFER)
                     memcpy(frame_.data, mmap_buffers_[buf.index].start,
                            MIN(mmap_buffers_[buf.index].length, frame_.len));
 #endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
@@ -463,7 +550,7 @@ bool Esp32Camera::Capture() {
                             dst16[i] = __builtin_bswap16(src16[i]);
                         }
                     }
-#else
+#elif !defined(ROTATE_FROM_MMAP_BUFFER)
                     memcpy(frame_.data, mmap_buffers_[buf.index].start,
                            MIN(mmap_buffers_[buf.index].length, frame_.len));
 #endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
@@ -473,7 +560,11 @@ bool Esp32Camera::Capture() {
                     // 大端序的 RGB565 需要转换为小端序
                     // 目前 esp_video 的大小端都会返回格式为 RGB565，不会返回格式为 RGB565X，此 case 用于未来版本兼容
                     auto src16 = (uint16_t*)mmap_buffers_[buf.index].start;
+#ifdef ROTATE_FROM_MMAP_BUFFER
+                    auto dst16 = src16;  // 原地转换，之后由旋转写入帧副本
+#else
                     auto dst16 = (uint16_t*)frame_.data;
+#endif  // ROTATE_FROM_MMAP_BUFFER
                     size_t pixel_count = (size_t)frame_.width * (size_t)frame_.height;
                     for (size_t i = 0; i < pixel_count; i++) {
                         dst16[i] = __builtin_bswap16(src16[i]);
@@ -491,6 +582,8 @@ bool Esp32Camera::Capture() {
 
 #ifdef CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
 #ifndef CONFIG_SOC_PPA_SUPPORTED
+#ifdef CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
+            // 字节序转换已经写入帧副本，需要单独的旋转输出缓冲区
             uint8_t* rotate_dst =
                 (uint8_t*)heap_caps_aligned_alloc(64, frame_.len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
             if (rotate_dst == nullptr) {
@@ -501,6 +594,10 @@ bool Esp32Camera::Capture() {
                 return false;
             }
             uint8_t* rotate_src = (uint8_t*)frame_.data;
+#else
+            uint8_t* rotate_dst = (uint8_t*)frame_.data;
+            uint8_t* rotate_src = (uint8_t*)mmap_buffers_[buf.index].start;
+#endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
 
             esp_imgfx_rotate_cfg_t rotate_cfg = {
                 .in_res =
@@ -552,7 +649,9 @@ bool Esp32Camera::Capture() {
             imgfx_err = esp_imgfx_rotate_process(rotate_handle, &rotate_input_data, &rotate_output_data);
             if (imgfx_err != ESP_IMGFX_ERR_OK) {
                 ESP_LOGE(TAG, "esp_imgfx_rotate_process failed");
+#ifdef CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
                 heap_caps_free(rotate_dst);
+#endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
                 rotate_dst = nullptr;
                 if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
                     ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
@@ -562,9 +661,12 @@ bool Esp32Camera::Capture() {
                 return false;
             }
 
+#ifdef CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
             frame_.data = rotate_dst;
+            frame_.capacity = frame_.len;
 
             heap_caps_free(rotate_src);
+#endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
             rotate_src = nullptr;
 
             esp_imgfx_rotate_close(rotate_handle);
@@ -636,6 +738,7 @@ bool Esp32Camera::Capture() {
                     heap_caps_free(frame_.data);
                     frame_.data = rotate_src;
                     frame_.len = frame_.width * frame_.height * 3;
+                    frame_.capacity = frame_.len;
                     break;
                 }
                 default:
@@ -715,6 +818,7 @@ bool Esp32Camera::Capture() {
 
             frame_.data = rotate_dst;
             frame_.len = frame_.width * frame_.height * 2;
+            frame_.capacity = frame_.len;
             frame_.format = V4L2_PIX_FMT_RGB565;
             heap_caps_free(rotate_src);
             rotate_src = nullptr;
@@ -727,6 +831,10 @@ bool Esp32Camera::Capture() {
         }
     }
 
+    int64_t preview_start_time = esp_timer_get_time();
+    capture_timing_.convert_us = preview_start_time - convert_start_time;
+    capture_timing_.preview_us = 0;
+
     // 显示预览图片
     auto display = dynamic_cast<LvglDisplay*>(Board::GetInstance().GetDisplay());
     if (display != nullptr) {
@@ -742,10 +850,22 @@ bool Esp32Camera::Capture() {
         uint8_t* data = nullptr;
 
         switch (frame_.format) {
-            // LVGL 显示 YUV 系的图像似乎都有问题，暂时转换为 RGB565 显示
+            // 预览图直接从帧副本抽样缩小到屏幕宽度，不再生成整帧的 RGB565 副本
+            // LVGL 显示 YUV 系的图像似乎都有问题，统一转换为 RGB565 显示
             case V4L2_PIX_FMT_YUYV:
-            case V4L2_PIX_FMT_YUV420:
-            case V4L2_PIX_FMT_RGB24: {
+            case V4L2_PIX_FMT_RGB24:
+            case V4L2_PIX_FMT_RGB565:
+            case V4L2_PIX_FMT_GREY:
+                data = CreatePreview(display->width(), &w, &h);
+                if (data == nullptr) {
+                    ESP_LOGE(TAG, "Failed to allocate memory for preview image");
+                    return false;
+                }
+                lvgl_image_size = w * h * 2;
+                stride = w * 2;
+                break;
+
+            case V4L2_PIX_FMT_YUV420: {
                 color_format = LV_COLOR_FORMAT_RGB565;
                 data = (uint8_t*)heap_caps_malloc(w * h * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
                 if (data == nullptr) {
@@ -790,16 +910,6 @@ bool Esp32Camera::Capture() {
                 break;
             }
 
-            case V4L2_PIX_FMT_RGB565:
-                data = (uint8_t*)heap_caps_malloc(w * h * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-                if (data == nullptr) {
-                    ESP_LOGE(TAG, "Failed to allocate memory for preview image");
-                    return false;
-                }
-                memcpy(data, frame_.data, frame_.len);
-                lvgl_image_size = frame_.len;  // fallthrough 时兼顾 YUYV 与 RGB565
-                break;
-
 #ifdef CONFIG_XIAOZHI_CAMERA_ALLOW_JPEG_INPUT
             case V4L2_PIX_FMT_JPEG: {
                 uint8_t* out_data = nullptr;  // out data is allocated by jpeg_to_image
@@ -834,6 +944,8 @@ bool Esp32Camera::Capture() {
 
         auto image = std::make_unique<LvglAllocatedImage>(data, lvgl_image_size, w, h, stride, color_format);
         display->SetPreviewImage(std::move(image));
+        capture_timing_.preview_us = esp_timer_get_time() - preview_start_time;
+        ESP_LOGI(TAG, "Preview %ux%u from %ux%u frame", w, h, frame_.width, frame_.height);
     }
     return true;
 }
@@ -900,42 +1012,67 @@ std::string Esp32Camera::Explain(const std::string& question) {
         throw std::runtime_error("Image explain URL or token is not set");
     }
 
-    // 创建局部的 JPEG 队列, 40 entries is about to store 512 * 40 = 20480 bytes of JPEG data
-    QueueHandle_t jpeg_queue = xQueueCreate(40, sizeof(JpegChunk));
-    if (jpeg_queue == nullptr) {
+    // 创建局部的 JPEG 队列，编码器每编码一行 MCU 输出一块，队列满时编码线程等待上传
+    struct EncodeContext {
+        QueueHandle_t queue;
+        std::atomic<bool> cancelled{false};
+    } context;
+    context.queue = xQueueCreate(40, sizeof(JpegChunk));
+    if (context.queue == nullptr) {
         ESP_LOGE(TAG, "Failed to create JPEG queue");
         throw std::runtime_error("Failed to create JPEG queue");
     }
 
-    // We spawn a thread to encode the image to JPEG using optimized encoder (cost about 500ms and 8KB SRAM)
-    encoder_thread_ = std::thread([this, jpeg_queue]() {
+    // 取消编码：编码线程不再入队，先腾出队列空间让可能阻塞的发送返回，等线程结束后释放剩余的块
+    auto cancel_encoder = [this, &context]() {
+        context.cancelled = true;
+        JpegChunk chunk;
+        while (xQueueReceive(context.queue, &chunk, 0) == pdPASS) {
+            heap_caps_free(chunk.data);
+        }
+        encoder_thread_.join();
+        while (xQueueReceive(context.queue, &chunk, 0) == pdPASS) {
+            heap_caps_free(chunk.data);
+        }
+        vQueueDelete(context.queue);
+    };
+
+    int64_t start_time = esp_timer_get_time();
+    int64_t encode_time_us = 0;
+
+    // We spawn a thread to encode the image to JPEG band by band, so encoding overlaps with the upload
+    encoder_thread_ = std::thread([this, &context, &encode_time_us]() {
+        int64_t encode_start_time = esp_timer_get_time();
         uint16_t w = frame_.width ? frame_.width : 320;
         uint16_t h = frame_.height ? frame_.height : 240;
         v4l2_pix_fmt_t enc_fmt = frame_.format;
         bool ok = image_to_jpeg_cb(
             frame_.data, frame_.len, w, h, enc_fmt, 80,
             [](void* arg, size_t index, const void* data, size_t len) -> size_t {
-                auto jpeg_queue = static_cast<QueueHandle_t>(arg);
-                JpegChunk chunk = {.data = nullptr, .len = len};
-                if (index == 0 && data != nullptr && len > 0) {
+                auto context = static_cast<EncodeContext*>(arg);
+                if (context->cancelled) {
+                    return len;
+                }
+                JpegChunk chunk = {.data = nullptr, .len = 0, .failed = false};
+                if (data != nullptr && len > 0) {
                     chunk.data = (uint8_t*)heap_caps_aligned_alloc(16, len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
                     if (chunk.data == nullptr) {
                         ESP_LOGE(TAG, "Failed to allocate %zu bytes for JPEG chunk", len);
-                        chunk.len = 0;
+                        chunk.failed = true;
                     } else {
                         memcpy(chunk.data, data, len);
+                        chunk.len = len;
                     }
-                } else {
-                    chunk.len = 0;  // Sentinel or error
                 }
-                xQueueSend(jpeg_queue, &chunk, portMAX_DELAY);
+                xQueueSend(context->queue, &chunk, portMAX_DELAY);
                 return len;
             },
-            jpeg_queue);
+            &context);
+        encode_time_us = esp_timer_get_time() - encode_start_time;
 
-        if (!ok) {
-            JpegChunk chunk = {.data = nullptr, .len = 0};
-            xQueueSend(jpeg_queue, &chunk, portMAX_DELAY);
+        if (!ok && !context.cancelled) {
+            JpegChunk chunk = {.data = nullptr, .len = 0, .failed = true};
+            xQueueSend(context.queue, &chunk, portMAX_DELAY);
         }
     });
 
@@ -954,19 +1091,10 @@ std::string Esp32Camera::Explain(const std::string& question) {
     http->SetHeader("Transfer-Encoding", "chunked");
     if (!http->Open("POST", explain_url_)) {
         ESP_LOGE(TAG, "Failed to connect to explain URL");
-        // Clear the queue
-        encoder_thread_.join();
-        JpegChunk chunk;
-        while (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) == pdPASS) {
-            if (chunk.data != nullptr) {
-                heap_caps_free(chunk.data);
-            } else {
-                break;
-            }
-        }
-        vQueueDelete(jpeg_queue);
+        cancel_encoder();
         throw std::runtime_error("Failed to connect to explain URL");
     }
+    int64_t connected_time = esp_timer_get_time();
 
     {
         // 第一块：question字段
@@ -992,10 +1120,13 @@ std::string Esp32Camera::Explain(const std::string& question) {
     bool saw_terminator = false;
     while (true) {
         JpegChunk chunk;
-        if (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) != pdPASS) {
+        if (xQueueReceive(context.queue, &chunk, portMAX_DELAY) != pdPASS) {
             ESP_LOGE(TAG, "Failed to receive JPEG chunk");
             break;
         }
+        if (chunk.failed) {
+            break;
+        }
         if (chunk.data == nullptr) {
             saw_terminator = true;
             break;  // The last chunk
@@ -1004,13 +1135,21 @@ std::string Esp32Camera::Explain(const std::string& question) {
         total_sent += chunk.len;
         heap_caps_free(chunk.data);
     }
+    if (!saw_terminator) {
+        // 编码失败，不再等待后续的块，上传中断的请求
+        http->Close();
+        cancel_encoder();
+        ESP_LOGE(TAG, "JPEG encoder failed after %u bytes", (unsigned)total_sent);
+        throw std::runtime_error("Failed to encode image to JPEG");
+    }
+    int64_t uploaded_time = esp_timer_get_time();
     // Wait for the encoder thread to finish
     encoder_thread_.join();
     // 清理队列
-    vQueueDelete(jpeg_queue);
+    vQueueDelete(context.queue);
 
-    if (!saw_terminator || total_sent == 0) {
-        ESP_LOGE(TAG, "JPEG encoder failed or produced empty output");
+    if (total_sent == 0) {
+        ESP_LOGE(TAG, "JPEG encoder produced empty output");
         throw std::runtime_error("Failed to encode image to JPEG");
     }
 
@@ -1030,6 +1169,16 @@ std::string Esp32Camera::Explain(const std::string& question) {
 
     std::string result = http->ReadAll();
     http->Close();
+    int64_t end_time = esp_timer_get_time();
+
+    // 编码与上传并行，upload 包含等待编码的时间
+    ESP_LOGI(TAG, "Explain timing: capture %d ms (dequeue %d, convert %d, preview %d), connect %d ms, "
+             "encode %d ms, upload %d ms, server %d ms, total %d ms",
+             int((capture_timing_.dequeue_us + capture_timing_.convert_us + capture_timing_.preview_us) / 1000),
+             int(capture_timing_.dequeue_us / 1000), int(capture_timing_.convert_us / 1000),
+             int(capture_timing_.preview_us / 1000), int((connected_time - start_time) / 1000),
+             int(encode_time_us / 1000), int((uploaded_time - connected_time) / 1000),
+             int((end_time - uploaded_time) / 1000), int((end_time - start_time) / 1000));
 
     // Get remain task stack size
     size_t remain_stack_size = uxTaskGetStackHighWaterMark(nullptr);
@@ -17,6 +17,7 @@
 struct JpegChunk {
     uint8_t* data;
     size_t len;
+    bool failed;    // 编码失败标记，与 data == nullptr 的结束标记区分
 };
 
 class Esp32Camera : public Camera {
@@ -24,10 +25,17 @@ private:
     struct FrameBuffer {
         uint8_t *data = nullptr;
         size_t len = 0;
+        size_t capacity = 0;    // 帧副本在多次拍照之间复用，只有变大时才重新分配
         uint16_t width = 0;
         uint16_t height = 0;
         v4l2_pix_fmt_t format = 0;
     } frame_;
+    // 最近一次 Capture 各阶段耗时，在 Explain 时一并输出
+    struct CaptureTiming {
+        int64_t dequeue_us = 0;
+        int64_t convert_us = 0;
+        int64_t preview_us = 0;
+    } capture_timing_;
     v4l2_pix_fmt_t sensor_format_ = 0;
 #ifdef CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
     uint16_t sensor_width_ = 0;
@@ -41,6 +49,9 @@ private:
     std::string explain_token_;
     std::thread encoder_thread_;
 
+    bool EnsureFrameCapacity(size_t len);
+    uint8_t* CreatePreview(uint16_t max_width, uint16_t* out_width, uint16_t* out_height);
+
 public:
     Esp32Camera(const esp_video_init_config_t& config);
     ~Esp32Camera();
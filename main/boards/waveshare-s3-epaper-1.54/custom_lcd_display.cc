@@ -13,6 +13,8 @@
 
 #define BYTES_PER_PIXEL (LV_COLOR_FORMAT_GET_SIZE(LV_COLOR_FORMAT_RGB565))
 #define BUFF_SIZE (EXAMPLE_LCD_WIDTH * EXAMPLE_LCD_HEIGHT * BYTES_PER_PIXEL)
+/* 连续局部刷新的次数，超过后全刷一次清除残影 */
+#define EPD_FULL_REFRESH_INTERVAL 30
 
 const uint8_t WF_Full_1IN54[159] =
 {											
@@ -72,7 +74,22 @@ void CustomLcdDisplay::lvgl_flush_cb(lv_display_t *disp, const lv_area_t *area,
             buffer++;
         }
     }
-    driver->EPD_DisplayPart();
+    // 时钟等内容通常一分钟才变化一次，画面与屏幕上一致时不再驱动墨水屏
+    if (memcmp(driver->buffer, driver->shown_buffer, driver->lcd_spi_data.buffer_len) == 0) {
+        driver->skipped_refresh_count++;
+        lv_disp_flush_ready(disp);
+        return;
+    }
+    if (++driver->partial_refresh_count >= EPD_FULL_REFRESH_INTERVAL) {
+        ESP_LOGI(TAG, "Full refresh after %d partial refreshes, %lu unchanged frames skipped",
+            driver->partial_refresh_count, driver->skipped_refresh_count);
+        driver->EPD_RefreshFull();
+        driver->partial_refresh_count = 0;
+        driver->skipped_refresh_count = 0;
+    } else {
+        driver->EPD_DisplayPart();
+    }
+    memcpy(driver->shown_buffer, driver->buffer, driver->lcd_spi_data.buffer_len);
     lv_disp_flush_ready(disp);
 }
 
@@ -98,6 +115,8 @@ CustomLcdDisplay::CustomLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_p
 
     buffer = (uint8_t *) heap_caps_malloc(lcd_spi_data.buffer_len, MALLOC_CAP_SPIRAM);
     assert(buffer);
+    shown_buffer = (uint8_t *) heap_caps_malloc(lcd_spi_data.buffer_len, MALLOC_CAP_SPIRAM);
+    assert(shown_buffer);
     display_ = lv_display_create(width, height); /* 以水平和垂直分辨率（像素）进行基本初始化 */
     lv_display_set_flush_cb(display_, lvgl_flush_cb);
     lv_display_set_user_data(display_, this);
@@ -113,6 +132,7 @@ CustomLcdDisplay::CustomLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_p
     EPD_Display();
     EPD_DisplayPartBaseImage();
     EPD_Init_Partial(); // 局部刷新初始化
+    memcpy(shown_buffer, buffer, lcd_spi_data.buffer_len);
 
     lvgl_port_unlock();
     if (display_ == nullptr) {
@@ -126,7 +146,14 @@ CustomLcdDisplay::CustomLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_p
 }
 
 CustomLcdDisplay::~CustomLcdDisplay() {
-    
+    if (shown_buffer != NULL) {
+        heap_caps_free(shown_buffer);
+        shown_buffer = NULL;
+    }
+    if (buffer != NULL) {
+        heap_caps_free(buffer);
+        buffer = NULL;
+    }
 }
 
 void CustomLcdDisplay::spi_gpio_init() {
@@ -388,6 +415,12 @@ void CustomLcdDisplay::EPD_DisplayPart() {
     EPD_TurnOnDisplayPart();
 }
 
+void CustomLcdDisplay::EPD_RefreshFull() {
+    EPD_Init();
+    EPD_DisplayPartBaseImage();
+    EPD_Init_Partial();
+}
+
 void CustomLcdDisplay::EPD_DrawColorPixel(uint16_t x, uint16_t y, uint8_t color) {
     if (x >= Width || y >= Height) {
         ESP_LOGE("EPD", "Out of bounds pixel: (%d,%d)", x, y);
@@ -39,6 +39,7 @@ public:
     void EPD_Init_Partial();
     void EPD_DisplayPart();
     void EPD_DrawColorPixel(uint16_t x, uint16_t y,uint8_t color);
+    void EPD_RefreshFull();  /* 全刷一次清除残影，之后恢复局部刷新 */
     
 private:
     const custom_lcd_spi_t lcd_spi_data;
@@ -46,6 +47,9 @@ private:
     const int Height;
     spi_device_handle_t spi;
     uint8_t *buffer = NULL;
+    uint8_t *shown_buffer = NULL;   /* 屏幕当前显示的内容，用于跳过未变化的刷新 */
+    int partial_refresh_count = 0;
+    uint32_t skipped_refresh_count = 0;
     
     static void lvgl_flush_cb(lv_display_t * disp, const lv_area_t * area, uint8_t * color_p);
     
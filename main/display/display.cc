@@ -40,6 +40,13 @@ void Display::SetEmotion(const char* emotion) {
     ESP_LOGW(TAG, "SetEmotion: %s", emotion);
 }
 
+void Display::SetEmotionId(EmotionId emotion_id) {
+    const char* emotion = EmotionTable::GetInstance().GetName(emotion_id);
+    if (emotion != nullptr) {
+        SetEmotion(emotion);
+    }
+}
+
 void Display::SetChatMessage(const char* role, const char* content) {
     ESP_LOGW(TAG, "Role:%s", role);
     ESP_LOGW(TAG, "     %s", content);
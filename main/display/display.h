@@ -34,6 +34,8 @@ public:
     virtual void ShowNotification(const char* notification, int duration_ms = 3000);
     virtual void ShowNotification(const std::string &notification, int duration_ms = 3000);
     virtual void SetEmotion(const char* emotion);
+    // Emotion already resolved with EmotionTable::Find, so the name is not hashed again
+    virtual void SetEmotionId(EmotionId emotion_id);
     virtual void SetChatMessage(const char* role, const char* content);
     virtual void SetTheme(Theme* theme);
     virtual Theme* GetTheme() { return current_theme_; }
@@ -2,6 +2,7 @@
 #include "gif/lvgl_gif.h"
 #include "settings.h"
 #include "lvgl_theme.h"
+#include "emotion_table.h"
 #include "assets/lang_config.h"
 
 #include <vector>
@@ -11,6 +12,7 @@
 #include <esp_err.h>
 #include <esp_lvgl_port.h>
 #include <esp_psram.h>
+#include <esp_timer.h>
 #include <cstring>
 
 #include "board.h"
@@ -499,42 +501,119 @@ void LcdDisplay::SetupUI() {
 #else
 #define  MAX_MESSAGES 20
 #endif
-void LcdDisplay::SetChatMessage(const char* role, const char* content) {
-    DisplayLockGuard lock(this);
-    if (content_ == nullptr) {
-        return;
+#define CHAT_SCROLL_ANIM_MIN_INTERVAL_US (500 * 1000)
+
+static uint32_t HashText(const char* text) {
+    uint32_t hash = 0x811C9DC5;
+    for (; *text != '\0'; text++) {
+        hash ^= static_cast<uint8_t>(*text);
+        hash *= 0x01000193;
     }
-    
-    // Check if message count exceeds limit
+    return hash;
+}
+
+lv_coord_t LcdDisplay::GetCachedTextWidth(const char* content, const lv_font_t* font) {
+    uint32_t hash = HashText(content);
+    auto& entry = text_width_cache_[hash % text_width_cache_.size()];
+    if (entry.width >= 0 && entry.hash == hash) {
+        text_width_cache_hits_++;
+        return entry.width;
+    }
+    text_width_cache_misses_++;
+    entry.hash = hash;
+    entry.width = lv_txt_get_width(content, strlen(content), font, 0);
+    return entry.width;
+}
+
+LcdDisplay::ChatBubble* LcdDisplay::FindChatBubble(lv_obj_t* container) {
+    for (auto& chat_bubble : chat_bubbles_) {
+        if (chat_bubble.container == container) {
+            return &chat_bubble;
+        }
+    }
+    return nullptr;
+}
+
+// 从池中取一个气泡：优先使用隐藏的空闲气泡，池未满时新建，否则复用最旧的消息
+LcdDisplay::ChatBubble* LcdDisplay::AcquireChatBubble() {
+    for (auto& chat_bubble : chat_bubbles_) {
+        if (lv_obj_has_flag(chat_bubble.container, LV_OBJ_FLAG_HIDDEN)) {
+            lv_obj_remove_flag(chat_bubble.container, LV_OBJ_FLAG_HIDDEN);
+            lv_obj_move_to_index(chat_bubble.container, -1);
+            return &chat_bubble;
+        }
+    }
+
     uint32_t child_count = lv_obj_get_child_cnt(content_);
     if (child_count >= MAX_MESSAGES) {
-        // Delete the oldest message (first child object)
         lv_obj_t* first_child = lv_obj_get_child(content_, 0);
-        lv_obj_t* last_child = lv_obj_get_child(content_, child_count - 1);
-        if (first_child != nullptr) {
-            lv_obj_del(first_child);
+        auto oldest = FindChatBubble(first_child);
+        if (oldest != nullptr) {
+            lv_obj_move_to_index(oldest->container, -1);
+            return oldest;
         }
-        // Scroll to the last message immediately
-        if (last_child != nullptr) {
-            lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
+        // 最旧的是图片预览等非池对象，直接删除
+        lv_obj_del(first_child);
+    }
+    if (chat_bubbles_.size() >= MAX_MESSAGES) {
+        // 池已满：删除预览不算腾出池位置，复用最旧的气泡，保证池不会超过预留容量
+        child_count = lv_obj_get_child_cnt(content_);
+        for (uint32_t i = 0; i < child_count; i++) {
+            auto oldest = FindChatBubble(lv_obj_get_child(content_, i));
+            if (oldest != nullptr) {
+                lv_obj_move_to_index(oldest->container, -1);
+                return oldest;
+            }
         }
     }
-    
-    // Collapse system messages (if it's a system message, check if the last message is also a system message)
-    if (strcmp(role, "system") == 0) {
+
+    auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
+    ChatBubble chat_bubble;
+    // 所有消息都放在透明的全宽容器中，便于按角色对齐
+    chat_bubble.container = lv_obj_create(content_);
+    lv_obj_set_width(chat_bubble.container, LV_HOR_RES);
+    lv_obj_set_height(chat_bubble.container, LV_SIZE_CONTENT);
+    lv_obj_set_style_bg_opa(chat_bubble.container, LV_OPA_TRANSP, 0);
+    lv_obj_set_style_border_width(chat_bubble.container, 0, 0);
+    lv_obj_set_style_pad_all(chat_bubble.container, 0, 0);
+    lv_obj_set_scrollbar_mode(chat_bubble.container, LV_SCROLLBAR_MODE_OFF);
+
+    chat_bubble.bubble = lv_obj_create(chat_bubble.container);
+    lv_obj_set_style_radius(chat_bubble.bubble, 8, 0);
+    lv_obj_set_scrollbar_mode(chat_bubble.bubble, LV_SCROLLBAR_MODE_OFF);
+    lv_obj_set_style_border_width(chat_bubble.bubble, 0, 0);
+    lv_obj_set_style_pad_all(chat_bubble.bubble, lvgl_theme->spacing(4), 0);
+    lv_obj_set_style_bg_opa(chat_bubble.bubble, LV_OPA_70, 0);
+    lv_obj_set_height(chat_bubble.bubble, LV_SIZE_CONTENT);
+    lv_obj_set_style_flex_grow(chat_bubble.bubble, 0, 0);
+
+    chat_bubble.label = lv_label_create(chat_bubble.bubble);
+    lv_label_set_long_mode(chat_bubble.label, LV_LABEL_LONG_WRAP);
+
+    // 预留容量，保证池中已有气泡的指针不会失效
+    chat_bubbles_.reserve(MAX_MESSAGES);
+    chat_bubbles_.push_back(chat_bubble);
+    return &chat_bubbles_.back();
+}
+
+void LcdDisplay::SetChatMessage(const char* role, const char* content) {
+    DisplayLockGuard lock(this);
+    if (content_ == nullptr) {
+        return;
+    }
+    auto start_time = esp_timer_get_time();
+
+    // Collapse system messages: reuse the last bubble if it is also a system message
+    ChatBubble* chat_bubble = nullptr;
+    bool is_system = strcmp(role, "system") == 0;
+    if (is_system) {
+        uint32_t child_count = lv_obj_get_child_cnt(content_);
         if (child_count > 0) {
-            // Get the last message container
-            lv_obj_t* last_container = lv_obj_get_child(content_, child_count - 1);
-            if (last_container != nullptr && lv_obj_get_child_cnt(last_container) > 0) {
-                // Get the bubble inside the container
-                lv_obj_t* last_bubble = lv_obj_get_child(last_container, 0);
-                if (last_bubble != nullptr) {
-                    // Check if bubble type is system message
-                    void* bubble_type_ptr = lv_obj_get_user_data(last_bubble);
-                    if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "system") == 0) {
-                        // If the last message is also a system message, delete it
-                        lv_obj_del(last_container);
-                    }
+            auto last = FindChatBubble(lv_obj_get_child(content_, child_count - 1));
+            if (last != nullptr && !lv_obj_has_flag(last->container, LV_OBJ_FLAG_HIDDEN)) {
+                void* bubble_type_ptr = lv_obj_get_user_data(last->bubble);
+                if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "system") == 0) {
+                    chat_bubble = last;
                 }
             }
         }
@@ -544,147 +623,81 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     }
 
     // Avoid empty message boxes
-    if(strlen(content) == 0) {
+    if (strlen(content) == 0) {
+        if (chat_bubble != nullptr) {
+            // 隐藏的气泡留在池中等待复用
+            lv_obj_add_flag(chat_bubble->container, LV_OBJ_FLAG_HIDDEN);
+        }
         return;
     }
 
+    if (chat_bubble == nullptr) {
+        chat_bubble = AcquireChatBubble();
+    }
+
     auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
     auto text_font = lvgl_theme->text_font()->font();
-
-    // Create a message bubble
-    lv_obj_t* msg_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(msg_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(msg_bubble, 0, 0);
-    lv_obj_set_style_pad_all(msg_bubble, lvgl_theme->spacing(4), 0);
-
-    // Create the message text
-    lv_obj_t* msg_text = lv_label_create(msg_bubble);
-    lv_label_set_text(msg_text, content);
-    
-    // Calculate actual text width
-    lv_coord_t text_width = lv_txt_get_width(content, strlen(content), text_font, 0);
-
-    // Calculate bubble width
-    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 85% of screen width
-    lv_coord_t min_width = 20;  
-    lv_coord_t bubble_width;
-    
-    // Ensure text width is not less than minimum width
-    if (text_width < min_width) {
-        text_width = min_width;
+    lv_label_set_text(chat_bubble->label, content);
+
+    // Calculate bubble width, 85% of screen width at most
+    lv_coord_t text_width = GetCachedTextWidth(content, text_font);
+    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;
+    lv_coord_t min_width = 20;
+    lv_coord_t bubble_width = std::clamp(text_width, min_width, max_width);
+    lv_obj_set_width(chat_bubble->label, bubble_width);
+    lv_obj_set_width(chat_bubble->bubble, LV_SIZE_CONTENT);
+
+    // 角色不变时样式无需重设
+    const char* bubble_type = strcmp(role, "user") == 0 ? "user" : (is_system ? "system" : "assistant");
+    if (lv_obj_get_user_data(chat_bubble->bubble) != (void*)bubble_type) {
+        lv_obj_set_user_data(chat_bubble->bubble, (void*)bubble_type);
+        if (bubble_type[0] == 'u') {
+            // User messages are right-aligned with green background
+            lv_obj_set_style_bg_color(chat_bubble->bubble, lvgl_theme->user_bubble_color(), 0);
+            lv_obj_set_style_text_color(chat_bubble->label, lvgl_theme->text_color(), 0);
+            lv_obj_align(chat_bubble->bubble, LV_ALIGN_RIGHT_MID, -25, 0);
+        } else if (bubble_type[0] == 's') {
+            // System messages are center-aligned with light gray background
+            lv_obj_set_style_bg_color(chat_bubble->bubble, lvgl_theme->system_bubble_color(), 0);
+            lv_obj_set_style_text_color(chat_bubble->label, lvgl_theme->system_text_color(), 0);
+            lv_obj_align(chat_bubble->bubble, LV_ALIGN_CENTER, 0, 0);
+        } else {
+            // Assistant messages are left-aligned with white background
+            lv_obj_set_style_bg_color(chat_bubble->bubble, lvgl_theme->assistant_bubble_color(), 0);
+            lv_obj_set_style_text_color(chat_bubble->label, lvgl_theme->text_color(), 0);
+            lv_obj_align(chat_bubble->bubble, LV_ALIGN_LEFT_MID, 0, 0);
+        }
     }
 
-    // If text width is less than max width, use text width
-    if (text_width < max_width) {
-        bubble_width = text_width; 
-    } else {
-        bubble_width = max_width;
-    }
-    
-    // Set message text width
-    lv_obj_set_width(msg_text, bubble_width);  // Subtract padding
-    lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
-
-    // Set bubble width
-    lv_obj_set_width(msg_bubble, bubble_width);
-    lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-
-    // Set alignment and style based on message role
-    if (strcmp(role, "user") == 0) {
-        // User messages are right-aligned with green background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->user_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->text_color(), 0);
-        
-        // Set custom attribute to mark bubble type
-        lv_obj_set_user_data(msg_bubble, (void*)"user");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "assistant") == 0) {
-        // Assistant messages are left-aligned with white background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->assistant_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->text_color(), 0);
-        
-        // Set custom attribute to mark bubble type
-        lv_obj_set_user_data(msg_bubble, (void*)"assistant");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "system") == 0) {
-        // System messages are center-aligned with light gray background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->system_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->system_text_color(), 0);
-        
-        // Set custom attribute to mark bubble type
-        lv_obj_set_user_data(msg_bubble, (void*)"system");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    }
-    
-    // Create a full-width container for user messages to ensure right alignment
-    if (strcmp(role, "user") == 0) {
-        // Create a full-width container
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // Make container transparent and borderless
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // Move the message bubble into this container
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // Right align the bubble in the container
-        lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
-        
-        // Auto-scroll to this container
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else if (strcmp(role, "system") == 0) {
-        // Create full-width container for system messages to ensure center alignment
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        lv_obj_set_parent(msg_bubble, container);
-        lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else {
-        // For assistant messages
-        // Left align assistant messages
-        lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
+    // 连续快速到达的句子不做滚动动画，避免动画互相打断造成掉帧
+    auto now = esp_timer_get_time();
+    bool animate = now - last_chat_message_time_ > CHAT_SCROLL_ANIM_MIN_INTERVAL_US;
+    last_chat_message_time_ = now;
+    lv_obj_scroll_to_view_recursive(chat_bubble->container, animate ? LV_ANIM_ON : LV_ANIM_OFF);
 
-        // Auto-scroll to the message bubble
-        lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
-    }
-    
     // Store reference to the latest message label
-    chat_message_label_ = msg_text;
+    chat_message_label_ = chat_bubble->label;
+
+    chat_message_count_++;
+    chat_message_time_us_ += esp_timer_get_time() - start_time;
+    if (chat_message_count_ % 20 == 0) {
+        lv_mem_monitor_t mon;
+        lv_mem_monitor(&mon);
+        ESP_LOGI(TAG, "Chat: %lu messages, avg %lu us, %u bubbles, width cache %lu/%lu hits, LVGL heap used %u%% free %u",
+            chat_message_count_, (uint32_t)(chat_message_time_us_ / chat_message_count_), chat_bubbles_.size(),
+            text_width_cache_hits_, text_width_cache_hits_ + text_width_cache_misses_, mon.used_pct, mon.free_size);
+        auto cbin_font = dynamic_cast<LvglCBinFont*>(lvgl_theme->text_font().get());
+        if (cbin_font != nullptr && cbin_font->glyph_cache() != nullptr && cbin_font->glyph_cache()->enabled()) {
+            auto glyph_cache = cbin_font->glyph_cache();
+            auto stats = glyph_cache->GetStats();
+            uint32_t rendered = stats.bitmap_hits + stats.bitmap_misses + stats.bitmap_bypasses;
+            ESP_LOGI(TAG, "Glyph cache: metrics %lu/%lu hits, bitmaps %lu/%lu hits, %lu bypassed, %lu fallbacks, %u KB, render %lu us (%lu us/glyph)",
+                stats.dsc_hits, stats.dsc_hits + stats.dsc_misses, stats.bitmap_hits,
+                stats.bitmap_hits + stats.bitmap_misses, stats.bitmap_bypasses, stats.fallbacks, stats.bytes / 1024,
+                (uint32_t)stats.render_time_us, rendered > 0 ? (uint32_t)(stats.render_time_us / rendered) : 0);
+            glyph_cache->ResetStats();
+        }
+    }
 }
 
 void LcdDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
@@ -971,6 +984,18 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
 #endif
 
 void LcdDisplay::SetEmotion(const char* emotion) {
+    // 只查表不登记，未知名称走字体图标的字符串查找，不会占满表项
+    ShowEmotion(EmotionTable::GetInstance().Find(emotion), emotion);
+}
+
+void LcdDisplay::SetEmotionId(EmotionId emotion_id) {
+    const char* emotion = EmotionTable::GetInstance().GetName(emotion_id);
+    if (emotion != nullptr) {
+        ShowEmotion(emotion_id, emotion);
+    }
+}
+
+void LcdDisplay::ShowEmotion(EmotionId emotion_id, const char* emotion) {
     // Stop any running GIF animation
     if (gif_controller_) {
         DisplayLockGuard lock(this);
@@ -982,10 +1007,13 @@ void LcdDisplay::SetEmotion(const char* emotion) {
         return;
     }
 
+    // 图片和字体图标都按 ID 查表
+    auto& emotion_table = EmotionTable::GetInstance();
     auto emoji_collection = static_cast<LvglTheme*>(current_theme_)->emoji_collection();
-    auto image = emoji_collection != nullptr ? emoji_collection->GetEmojiImage(emotion) : nullptr;
+    auto image = emoji_collection != nullptr ? emoji_collection->GetEmojiImage(emotion_id) : nullptr;
     if (image == nullptr) {
-        const char* utf8 = font_awesome_get_utf8(emotion);
+        const char* utf8 = emotion_id != EmotionTable::kInvalidId ?
+            emotion_table.GetFontAwesomeUtf8(emotion_id) : font_awesome_get_utf8(emotion);
         if (utf8 != nullptr && emoji_label_ != nullptr) {
             DisplayLockGuard lock(this);
             lv_label_set_text(emoji_label_, utf8);
@@ -996,9 +1024,13 @@ void LcdDisplay::SetEmotion(const char* emotion) {
     }
 
     DisplayLockGuard lock(this);
-    if (image->IsGif()) {
-        // Create new GIF controller
-        gif_controller_ = std::make_unique<LvglGif>(image->image_dsc());
+    if (image->IsGif() || image->IsRleAnimation()) {
+        // Create new animation controller, RLA emojis are pre-transcoded GIFs
+        if (image->IsGif()) {
+            gif_controller_ = std::make_unique<LvglGif>(image->image_dsc());
+        } else {
+            gif_controller_ = std::make_unique<LvglRleAnimation>(image->image_dsc());
+        }
         
         if (gif_controller_->IsLoaded()) {
             // Set up frame update callback
@@ -1014,7 +1046,7 @@ void LcdDisplay::SetEmotion(const char* emotion) {
             lv_obj_add_flag(emoji_label_, LV_OBJ_FLAG_HIDDEN);
             lv_obj_remove_flag(emoji_image_, LV_OBJ_FLAG_HIDDEN);
         } else {
-            ESP_LOGE(TAG, "Failed to load GIF for emotion: %s", emotion);
+            ESP_LOGE(TAG, "Failed to load animation for emotion: %s", emotion);
             gif_controller_.reset();
         }
     } else {
@@ -1093,6 +1125,11 @@ void LcdDisplay::SetTheme(Theme* theme) {
     // Set content background opacity
     lv_obj_set_style_bg_opa(content_, LV_OPA_TRANSP, 0);
 
+    // 字体可能随主题变化，清空宽度缓存
+    for (auto& entry : text_width_cache_) {
+        entry.width = -1;
+    }
+
     // Iterate through all children of content (message containers or bubbles)
     uint32_t child_count = lv_obj_get_child_cnt(content_);
     for (uint32_t i = 0; i < child_count; i++) {
@@ -3,6 +3,7 @@
 
 #include "lvgl_display.h"
 #include "gif/lvgl_gif.h"
+#include "lvgl_rle_animation.h"
 
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
@@ -10,6 +11,8 @@
 
 #include <atomic>
 #include <memory>
+#include <array>
+#include <vector>
 
 #define PREVIEW_IMAGE_DURATION_MS 5000
 
@@ -29,25 +32,49 @@ protected:
     lv_obj_t* preview_image_ = nullptr;
     lv_obj_t* emoji_label_ = nullptr;
     lv_obj_t* emoji_image_ = nullptr;
-    std::unique_ptr<LvglGif> gif_controller_ = nullptr;
+    std::unique_ptr<LvglAnimation> gif_controller_ = nullptr;
     lv_obj_t* emoji_box_ = nullptr;
     lv_obj_t* chat_message_label_ = nullptr;
     esp_timer_handle_t preview_timer_ = nullptr;
     std::unique_ptr<LvglImage> preview_image_cached_ = nullptr;
     bool hide_subtitle_ = false;  // Control whether to hide chat messages/subtitles
 
+    // 消息气泡对象池，达到 MAX_MESSAGES 后循环复用最旧的气泡
+    struct ChatBubble {
+        lv_obj_t* container;
+        lv_obj_t* bubble;
+        lv_obj_t* label;
+    };
+    struct TextWidthCacheEntry {
+        uint32_t hash = 0;
+        lv_coord_t width = -1;
+    };
+    std::vector<ChatBubble> chat_bubbles_;
+    std::array<TextWidthCacheEntry, 32> text_width_cache_;
+    int64_t last_chat_message_time_ = 0;
+    uint32_t chat_message_count_ = 0;
+    int64_t chat_message_time_us_ = 0;
+    uint32_t text_width_cache_hits_ = 0;
+    uint32_t text_width_cache_misses_ = 0;
+
     void InitializeLcdThemes();
     void SetupUI();
+    ChatBubble* FindChatBubble(lv_obj_t* container);
+    ChatBubble* AcquireChatBubble();
+    lv_coord_t GetCachedTextWidth(const char* content, const lv_font_t* font);
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
 protected:
+    void ShowEmotion(EmotionId emotion_id, const char* emotion);
+
     // Add protected constructor
     LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel, int width, int height);
     
 public:
     ~LcdDisplay();
     virtual void SetEmotion(const char* emotion) override;
+    virtual void SetEmotionId(EmotionId emotion_id) override;
     virtual void SetChatMessage(const char* role, const char* content) override; 
     virtual void SetPreviewImage(std::unique_ptr<LvglImage> image) override;
 
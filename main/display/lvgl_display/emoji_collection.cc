@@ -1,28 +1,46 @@
 #include "emoji_collection.h"
 
 #include <esp_log.h>
-#include <unordered_map>
 #include <string>
 
 #define TAG "EmojiCollection"
 
 void EmojiCollection::AddEmoji(const std::string& name, LvglImage* image) {
-    emoji_collection_[name] = image;
+    EmotionId id = EmotionTable::GetInstance().Intern(name.c_str());
+    if (id == EmotionTable::kInvalidId) {
+        ESP_LOGE(TAG, "Failed to add emoji: %s", name.c_str());
+        delete image;
+        return;
+    }
+    if (id >= emoji_collection_.size()) {
+        emoji_collection_.resize(id + 1, nullptr);
+    }
+    delete emoji_collection_[id];
+    emoji_collection_[id] = image;
 }
 
 const LvglImage* EmojiCollection::GetEmojiImage(const char* name) {
-    auto it = emoji_collection_.find(name);
-    if (it != emoji_collection_.end()) {
-        return it->second;
+    EmotionId id = EmotionTable::GetInstance().Find(name);
+    if (id == EmotionTable::kInvalidId) {
+        ESP_LOGW(TAG, "Emoji not found: %s", name);
+        return nullptr;
+    }
+    return GetEmojiImage(id);
+}
+
+const LvglImage* EmojiCollection::GetEmojiImage(EmotionId id) {
+    if (id < emoji_collection_.size() && emoji_collection_[id] != nullptr) {
+        return emoji_collection_[id];
     }
 
-    ESP_LOGW(TAG, "Emoji not found: %s", name);
+    auto name = EmotionTable::GetInstance().GetName(id);
+    ESP_LOGW(TAG, "Emoji not found: %s", name != nullptr ? name : "(invalid)");
     return nullptr;
 }
 
 EmojiCollection::~EmojiCollection() {
-    for (auto it = emoji_collection_.begin(); it != emoji_collection_.end(); ++it) {
-        delete it->second;
+    for (auto image : emoji_collection_) {
+        delete image;
     }
     emoji_collection_.clear();
 }
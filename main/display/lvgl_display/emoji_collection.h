@@ -2,12 +2,13 @@
 #define EMOJI_COLLECTION_H
 
 #include "lvgl_image.h"
+#include "emotion_table.h"
 
 #include <lvgl.h>
 
-#include <map>
 #include <string>
 #include <memory>
+#include <vector>
 
 
 // Define interface for emoji collection
@@ -15,10 +16,12 @@ class EmojiCollection {
 public:
     virtual void AddEmoji(const std::string& name, LvglImage* image);
     virtual const LvglImage* GetEmojiImage(const char* name);
+    virtual const LvglImage* GetEmojiImage(EmotionId id);
     virtual ~EmojiCollection();
 
 private:
-    std::map<std::string, LvglImage*> emoji_collection_;
+    // Indexed by EmotionId, nullptr if the collection has no image for the emotion
+    std::vector<LvglImage*> emoji_collection_;
 };
 
 class Twemoji32 : public EmojiCollection {
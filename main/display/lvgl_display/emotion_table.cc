@@ -0,0 +1,103 @@
+#include "emotion_table.h"
+
+#include <esp_log.h>
+#include <font_awesome.h>
+#include <cstring>
+
+#define TAG "EmotionTable"
+
+// 服务器常用的表情，启动时预先登记
+static const char* const kBuiltinEmotions[] = {
+    "neutral", "happy", "laughing", "funny", "sad", "angry", "crying", "loving",
+    "embarrassed", "surprised", "shocked", "thinking", "winking", "cool", "relaxed",
+    "delicious", "kissy", "confident", "sleepy", "silly", "confused",
+};
+
+EmotionTable::EmotionTable() {
+    for (auto& slot : slots_) {
+        slot.id = kInvalidId;
+    }
+    for (auto name : kBuiltinEmotions) {
+        Intern(name);
+    }
+}
+
+uint32_t EmotionTable::Hash(const char* name) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (const char* p = name; *p != '\0'; p++) {
+        hash ^= (uint8_t)*p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+EmotionId EmotionTable::FindLocked(const char* name, uint32_t hash, size_t* free_slot) {
+    // 线性探测，表的装载率不超过 50%
+    size_t index = hash & (kSlotCount - 1);
+    for (size_t i = 0; i < kSlotCount; i++) {
+        const Slot& slot = slots_[index];
+        if (slot.id == kInvalidId) {
+            if (free_slot != nullptr) {
+                *free_slot = index;
+            }
+            return kInvalidId;
+        }
+        if (slot.hash == hash && entries_[slot.id].name == name) {
+            return slot.id;
+        }
+        index = (index + 1) & (kSlotCount - 1);
+    }
+    return kInvalidId;
+}
+
+EmotionId EmotionTable::Find(const char* name) {
+    if (name == nullptr) {
+        return kInvalidId;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    return FindLocked(name, Hash(name), nullptr);
+}
+
+EmotionId EmotionTable::Intern(const char* name) {
+    if (name == nullptr || name[0] == '\0') {
+        return kInvalidId;
+    }
+    uint32_t hash = Hash(name);
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t free_slot = kSlotCount;
+    EmotionId id = FindLocked(name, hash, &free_slot);
+    if (id != kInvalidId) {
+        return id;
+    }
+    if (entries_.size() >= kMaxEmotions || free_slot == kSlotCount) {
+        ESP_LOGW(TAG, "Emotion table is full, %s is not interned", name);
+        return kInvalidId;
+    }
+
+    id = entries_.size();
+    entries_.push_back(Entry{name, font_awesome_get_utf8(name)});
+    slots_[free_slot] = Slot{hash, id};
+    return id;
+}
+
+const char* EmotionTable::GetName(EmotionId id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (id >= entries_.size()) {
+        return nullptr;
+    }
+    return entries_[id].name.c_str();
+}
+
+const char* EmotionTable::GetFontAwesomeUtf8(EmotionId id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (id >= entries_.size()) {
+        return nullptr;
+    }
+    return entries_[id].utf8;
+}
+
+size_t EmotionTable::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
@@ -0,0 +1,66 @@
+#ifndef EMOTION_TABLE_H
+#define EMOTION_TABLE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+
+typedef uint16_t EmotionId;
+
+/**
+ * Interned emotion names.
+ * Every emotion name gets a small integer ID the first time it is seen, later lookups
+ * hash the name into a fixed open-addressed table without allocating. The font awesome
+ * fallback glyph of each name is resolved once when it is interned.
+ */
+class EmotionTable {
+public:
+    static constexpr EmotionId kInvalidId = 0xFFFF;
+    static constexpr size_t kMaxEmotions = 128;
+
+    static EmotionTable& GetInstance() {
+        static EmotionTable instance;
+        return instance;
+    }
+
+    EmotionTable(const EmotionTable&) = delete;
+    EmotionTable& operator=(const EmotionTable&) = delete;
+
+    // Look up an interned name, never allocates
+    EmotionId Find(const char* name);
+    // Look up or intern a name, returns kInvalidId when the table is full
+    EmotionId Intern(const char* name);
+
+    // The returned pointers stay valid for the lifetime of the program
+    const char* GetName(EmotionId id);
+    const char* GetFontAwesomeUtf8(EmotionId id);
+
+    size_t size();
+
+private:
+    EmotionTable();
+    ~EmotionTable() = default;
+
+    static constexpr size_t kSlotCount = kMaxEmotions * 2;
+
+    struct Slot {
+        uint32_t hash;
+        EmotionId id;
+    };
+
+    struct Entry {
+        std::string name;
+        const char* utf8;   // font awesome fallback, nullptr if there is none
+    };
+
+    std::mutex mutex_;
+    Slot slots_[kSlotCount];
+    std::deque<Entry> entries_;  // deque keeps name pointers stable while growing
+
+    static uint32_t Hash(const char* name);
+    EmotionId FindLocked(const char* name, uint32_t hash, size_t* free_slot);
+};
+
+#endif // EMOTION_TABLE_H
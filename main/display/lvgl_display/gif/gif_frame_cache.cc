@@ -0,0 +1,92 @@
+#include "gif_frame_cache.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <cstring>
+
+#define TAG "GifFrameCache"
+
+#ifndef CONFIG_GIF_FRAME_CACHE_SIZE_KB
+#define CONFIG_GIF_FRAME_CACHE_SIZE_KB 0
+#endif
+
+GifFrameSet::GifFrameSet(const void* source, size_t source_size, uint16_t width, uint16_t height)
+    : source(source), source_size(source_size), width(width), height(height) {
+}
+
+GifFrameSet::~GifFrameSet() {
+    for (auto& frame : frames) {
+        heap_caps_free(frame.pixels);
+    }
+}
+
+bool GifFrameSet::AddFrame(const uint8_t* canvas, uint32_t delay_ms, size_t max_bytes) {
+    if (bytes() + frame_size() > max_bytes) {
+        return false;
+    }
+    auto pixels = (uint8_t*)heap_caps_malloc(frame_size(), MALLOC_CAP_SPIRAM);
+    if (pixels == nullptr) {
+        return false;
+    }
+    memcpy(pixels, canvas, frame_size());
+    frames.push_back(Frame{pixels, delay_ms});
+    return true;
+}
+
+GifFrameCache::GifFrameCache() {
+    budget_ = (size_t)CONFIG_GIF_FRAME_CACHE_SIZE_KB * 1024;
+    // 没有 PSRAM 时不缓存，避免占用内部 RAM
+    if (budget_ > 0 && heap_caps_get_total_size(MALLOC_CAP_SPIRAM) == 0) {
+        ESP_LOGW(TAG, "No PSRAM, GIF frame cache disabled");
+        budget_ = 0;
+    }
+}
+
+std::shared_ptr<GifFrameSet> GifFrameCache::Find(const void* source, size_t source_size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if ((*it)->source == source && (*it)->source_size == source_size) {
+            entries_.splice(entries_.begin(), entries_, it);
+            hits_++;
+            return entries_.front();
+        }
+    }
+    misses_++;
+    return nullptr;
+}
+
+void GifFrameCache::Insert(std::shared_ptr<GifFrameSet> frame_set) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t bytes = frame_set->bytes();
+    if (bytes == 0 || bytes > max_entry_bytes()) {
+        return;
+    }
+    for (auto& entry : entries_) {
+        if (entry->source == frame_set->source && entry->source_size == frame_set->source_size) {
+            return;
+        }
+    }
+
+    EvictLocked(bytes);
+    entries_.push_front(frame_set);
+    used_ += bytes;
+    ESP_LOGI(TAG, "Cached %u frames (%ux%u, %u KB), total %u/%u KB in %u entries, hits %lu, misses %lu",
+        frame_set->frames.size(), frame_set->width, frame_set->height, bytes / 1024,
+        used_ / 1024, budget_ / 1024, entries_.size(), hits_, misses_);
+}
+
+void GifFrameCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    used_ = 0;
+}
+
+void GifFrameCache::EvictLocked(size_t needed) {
+    // 正在播放的表情持有 shared_ptr，从缓存移除后内存在播放结束时释放
+    while (!entries_.empty() && used_ + needed > budget_) {
+        auto& victim = entries_.back();
+        used_ -= victim->bytes();
+        ESP_LOGD(TAG, "Evict GIF %p, %u KB", victim->source, victim->bytes() / 1024);
+        entries_.pop_back();
+    }
+}
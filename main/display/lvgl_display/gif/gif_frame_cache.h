@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * One complete loop of a GIF, decoded to ARGB8888 frames in PSRAM
+ */
+struct GifFrameSet {
+    struct Frame {
+        uint8_t* pixels;
+        uint32_t delay_ms;
+    };
+
+    GifFrameSet(const void* source, size_t source_size, uint16_t width, uint16_t height);
+    ~GifFrameSet();
+
+    GifFrameSet(const GifFrameSet&) = delete;
+    GifFrameSet& operator=(const GifFrameSet&) = delete;
+
+    // Copy the canvas as a new frame, returns false if the set would exceed max_bytes
+    bool AddFrame(const uint8_t* canvas, uint32_t delay_ms, size_t max_bytes);
+
+    size_t frame_size() const { return (size_t)width * height * 4; }
+    size_t bytes() const { return frame_size() * frames.size(); }
+
+    const void* source;
+    size_t source_size;
+    uint16_t width;
+    uint16_t height;
+    std::vector<Frame> frames;
+};
+
+/**
+ * LRU cache of decoded GIF loops, keyed by the GIF data address.
+ * Looping emotions are decoded once and then played back as plain frame switches.
+ */
+class GifFrameCache {
+public:
+    static GifFrameCache& GetInstance() {
+        static GifFrameCache instance;
+        return instance;
+    }
+
+    GifFrameCache(const GifFrameCache&) = delete;
+    GifFrameCache& operator=(const GifFrameCache&) = delete;
+
+    bool enabled() const { return budget_ > 0; }
+    // A single GIF may take at most half of the budget, so switching between two emotions never thrashes
+    size_t max_entry_bytes() const { return budget_ / 2; }
+
+    std::shared_ptr<GifFrameSet> Find(const void* source, size_t source_size);
+    void Insert(std::shared_ptr<GifFrameSet> frame_set);
+    void Clear();
+
+private:
+    GifFrameCache();
+    ~GifFrameCache() = default;
+
+    void EvictLocked(size_t needed);
+
+    std::mutex mutex_;
+    std::list<std::shared_ptr<GifFrameSet>> entries_;  // front is the most recently used
+    size_t budget_ = 0;
+    size_t used_ = 0;
+    uint32_t hits_ = 0;
+    uint32_t misses_ = 0;
+};
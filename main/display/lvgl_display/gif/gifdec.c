@@ -22,7 +22,7 @@ typedef struct Table {
     Entry * entries;
 } Table;
 
-#if LV_GIF_CACHE_DECODE_DATA
+#if GIFDEC_USE_LZW_CACHE
 #define LZW_MAXBITS                 12
 #define LZW_TABLE_SIZE              (1 << LZW_MAXBITS)
 #define LZW_CACHE_SIZE              (LZW_TABLE_SIZE * 4)
@@ -116,7 +116,7 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
         ESP_LOGW(TAG, "Zero size image");
         goto fail;
     }
-#if LV_GIF_CACHE_DECODE_DATA
+#if GIFDEC_USE_LZW_CACHE
     if(0 == (INT_MAX - sizeof(gd_GIF) - LZW_CACHE_SIZE) / width / height / 5){
         ESP_LOGW(TAG, "Image dimensions are too large");
         goto fail;
@@ -145,7 +145,7 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
         memset(gif->frame, gif->bgindex, gif->width * gif->height);
     }
     bgcolor = &gif->palette->colors[gif->bgindex * 3];
-    #if LV_GIF_CACHE_DECODE_DATA
+    #if GIFDEC_USE_LZW_CACHE
     gif->lzw_cache = gif->frame + width * height;
     #endif
 
@@ -299,6 +299,7 @@ read_ext(gd_GIF * gif)
     }
 }
 
+#if !GIFDEC_USE_LZW_CACHE
 static uint16_t
 get_key(gd_GIF *gif, int key_size, uint8_t *sub_len, uint8_t *shift, uint8_t *byte)
 {
@@ -327,14 +328,57 @@ get_key(gd_GIF *gif, int key_size, uint8_t *sub_len, uint8_t *shift, uint8_t *by
     *shift = (*shift + key_size) % 8;
     return key;
 }
+#endif
+
+#if GIFDEC_USE_LZW_CACHE
+/* LZW 位读取器：用 32 位累加器一次取出整个 key，替代 get_key 的逐位拼接。
+ * 内存中的 GIF 直接按下标取字节，省去每字节一次 memcpy。 */
+typedef struct {
+    uint32_t acc;
+    int bits;
+    uint8_t sub_len;
+} lzw_reader_t;
+
+static inline uint8_t
+lzw_read_byte(gd_GIF *gif)
+{
+    uint8_t byte;
+
+    if (!gif->is_file) {
+        return (uint8_t) gif->data[gif->f_rw_p++];
+    }
+    f_gif_read(gif, &byte, 1);
+    return byte;
+}
+
+static inline uint16_t
+lzw_read_key(gd_GIF *gif, lzw_reader_t *reader, int key_size)
+{
+    uint16_t key;
+
+    while (reader->bits < key_size) {
+        if (reader->sub_len == 0) {
+            reader->sub_len = lzw_read_byte(gif); /* Must be nonzero! */
+            if (reader->sub_len == 0) return 0x1000;
+        }
+        reader->acc |= (uint32_t) lzw_read_byte(gif) << reader->bits;
+        reader->bits += 8;
+        reader->sub_len--;
+    }
+    key = reader->acc & ((1 << key_size) - 1);
+    reader->acc >>= key_size;
+    reader->bits -= key_size;
+    return key;
+}
 
-#if LV_GIF_CACHE_DECODE_DATA
 /* Decompress image pixels.
  * Return 0 on success or -1 on out-of-memory (w.r.t. LZW code table) or parse error. */
 static int
 read_image_data(gd_GIF *gif, int interlace)
 {
-    uint8_t sub_len, shift, byte;
+    uint8_t byte;
+    lzw_reader_t reader = {0};
+    int run;
     int ret = 0;
     int key_size;
     int y, pass, linesize;
@@ -368,7 +412,6 @@ read_image_data(gd_GIF *gif, int interlace)
     ptr_base = &gif->frame[gif->fy * linesize + gif->fx];
     ptr_row_start = ptr_base;
     ptr = ptr_row_start;
-    sub_len = shift = 0;
     /* decoder */
     pass = 0;
     y = 0;
@@ -386,14 +429,18 @@ read_image_data(gd_GIF *gif, int interlace)
     sp = p_stack;
 
     while (frm_off < frm_size) {
-        /* copy data to frame buffer */
+        /* copy data to frame buffer, one row segment at a time */
         while (sp > p_stack) {
-            if(frm_off >= frm_size){
+            run = MIN(sp - p_stack, gif->fw - (ptr - ptr_row_start));
+            run = MIN(run, frm_size - frm_off);
+            if(run <= 0){
                 ESP_LOGW(TAG, "LZW table token overflows the frame buffer");
                 return -1;
             }
-            *ptr++ = *(--sp);
-            frm_off += 1;
+            frm_off += run;
+            while (run--) {
+                *ptr++ = *(--sp);
+            }
             /* read one line */
             if ((ptr - ptr_row_start) == gif->fw) {
                 if (interlace) {
@@ -426,7 +473,7 @@ read_image_data(gd_GIF *gif, int interlace)
             }
         }
 
-        key = get_key(gif, curr_size, &sub_len, &shift, &byte);
+        key = lzw_read_key(gif, &reader, curr_size);
 
         if (key == stop_code || key >= LZW_TABLE_SIZE)
             break;
@@ -473,7 +520,7 @@ read_image_data(gd_GIF *gif, int interlace)
         }
     }
 
-    if (key == stop_code) f_gif_read(gif, &sub_len, 1); /* Must be zero! */
+    /* The reader may stop inside a sub-block, always resume after the image data. */
     f_gif_seek(gif, end, LV_FS_SEEK_SET);
     return ret;
 }
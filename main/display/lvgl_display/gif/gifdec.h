@@ -9,6 +9,14 @@ extern "C" {
 
 #include <stdint.h>
 
+/* 默认使用查表 + 栈的 LZW 解码器（LVGL 中 LV_GIF_CACHE_DECODE_DATA 的实现），
+ * 每个 GIF 额外占用 16KB，但比逐像素回溯字典链快得多。定义为 0 可恢复旧实现。 */
+#ifndef GIFDEC_FAST_LZW
+#define GIFDEC_FAST_LZW 1
+#endif
+
+#define GIFDEC_USE_LZW_CACHE (LV_GIF_CACHE_DECODE_DATA || GIFDEC_FAST_LZW)
+
 typedef struct _gd_Palette {
     int size;
     uint8_t colors[0x100 * 3];
@@ -46,7 +54,7 @@ typedef struct _gd_GIF {
     uint16_t fx, fy, fw, fh;
     uint8_t bgindex;
     uint8_t * canvas, * frame;
-#if LV_GIF_CACHE_DECODE_DATA
+#if GIFDEC_USE_LZW_CACHE
     uint8_t *lzw_cache;
 #endif
 } gd_GIF;
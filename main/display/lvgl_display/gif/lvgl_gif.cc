@@ -1,16 +1,35 @@
 #include "lvgl_gif.h"
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <cstring>
 
 #define TAG "LvglGif"
 
 LvglGif::LvglGif(const lv_img_dsc_t* img_dsc)
-    : gif_(nullptr), timer_(nullptr), last_call_(0), playing_(false), loaded_(false) {
+    : gif_(nullptr), source_(nullptr), source_size_(0), frame_index_(0), decode_time_us_(0),
+      timer_(nullptr), last_call_(0), playing_(false), loaded_(false) {
+    memset(&img_dsc_, 0, sizeof(img_dsc_));
     if (!img_dsc || !img_dsc->data) {
         ESP_LOGE(TAG, "Invalid image descriptor");
         return;
     }
 
+    source_ = img_dsc->data;
+    source_size_ = img_dsc->data_size;
+    auto& cache = GifFrameCache::GetInstance();
+    if (cache.enabled()) {
+        cached_frames_ = cache.Find(source_, source_size_);
+    }
+    if (cached_frames_) {
+        // 命中帧缓存，直接切换已解码的帧，不再打开解码器
+        InitImageDsc(cached_frames_->width, cached_frames_->height, cached_frames_->frames[0].pixels);
+        loaded_ = true;
+        ESP_LOGD(TAG, "GIF loaded from frame cache: %dx%d, %u frames",
+            cached_frames_->width, cached_frames_->height, cached_frames_->frames.size());
+        return;
+    }
+
+    int64_t start_time = esp_timer_get_time();
     gif_ = gd_open_gif_data(img_dsc->data);
     if (!gif_) {
         ESP_LOGE(TAG, "Failed to open GIF from image descriptor");
@@ -18,21 +37,19 @@ LvglGif::LvglGif(const lv_img_dsc_t* img_dsc)
     }
 
     // Setup LVGL image descriptor
-    memset(&img_dsc_, 0, sizeof(img_dsc_));
-    img_dsc_.header.magic = LV_IMAGE_HEADER_MAGIC;
-    img_dsc_.header.flags = LV_IMAGE_FLAGS_MODIFIABLE;
-    img_dsc_.header.cf = LV_COLOR_FORMAT_ARGB8888;
-    img_dsc_.header.w = gif_->width;
-    img_dsc_.header.h = gif_->height;
-    img_dsc_.header.stride = gif_->width * 4;
-    img_dsc_.data = gif_->canvas;
-    img_dsc_.data_size = gif_->width * gif_->height * 4;
+    InitImageDsc(gif_->width, gif_->height, gif_->canvas);
 
     // Render first frame
     if (gif_->canvas) {
         gd_render_frame(gif_, gif_->canvas);
     }
 
+    // 第一轮播放时顺便记录解码后的帧，放不下单个表情预算的 GIF 不记录
+    if (cache.enabled() && (size_t)gif_->width * gif_->height * 4 <= cache.max_entry_bytes()) {
+        recording_ = std::make_shared<GifFrameSet>(source_, source_size_, gif_->width, gif_->height);
+        decode_time_us_ = esp_timer_get_time() - start_time;
+    }
+
     loaded_ = true;
     ESP_LOGD(TAG, "GIF loaded from image descriptor: %dx%d", gif_->width, gif_->height);
 }
@@ -52,7 +69,7 @@ const lv_img_dsc_t* LvglGif::image_dsc() const {
 
 // Animation control methods
 void LvglGif::Start() {
-    if (!loaded_ || !gif_) {
+    if (!loaded_ || (!gif_ && !cached_frames_)) {
         ESP_LOGW(TAG, "GIF not loaded, cannot start");
         return;
     }
@@ -86,7 +103,7 @@ void LvglGif::Pause() {
 }
 
 void LvglGif::Resume() {
-    if (!loaded_ || !gif_) {
+    if (!loaded_ || (!gif_ && !cached_frames_)) {
         ESP_LOGW(TAG, "GIF not loaded, cannot resume");
         return;
     }
@@ -104,7 +121,14 @@ void LvglGif::Stop() {
         lv_timer_pause(timer_);
     }
 
-    if (gif_) {
+    if (cached_frames_) {
+        frame_index_ = 0;
+        img_dsc_.data = cached_frames_->frames[0].pixels;
+        lv_image_cache_drop(&img_dsc_);
+        ESP_LOGD(TAG, "GIF animation stopped and rewound");
+    } else if (gif_) {
+        // 回到开头后已记录的帧不再构成完整的一轮
+        recording_.reset();
         gd_rewind(gif_);
         NextFrame();
         ESP_LOGD(TAG, "GIF animation stopped and rewound");
@@ -120,7 +144,14 @@ bool LvglGif::IsLoaded() const {
 }
 
 int32_t LvglGif::GetLoopCount() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
+        return -1;
+    }
+    if (cached_frames_) {
+        // 只有无限循环的 GIF 才会进入帧缓存
+        return 0;
+    }
+    if (!gif_) {
         return -1;
     }
     return gif_->loop_count;
@@ -128,24 +159,24 @@ int32_t LvglGif::GetLoopCount() const {
 
 void LvglGif::SetLoopCount(int32_t count) {
     if (!loaded_ || !gif_) {
-        ESP_LOGW(TAG, "GIF not loaded, cannot set loop count");
+        ESP_LOGW(TAG, "GIF not loaded or playing from frame cache, cannot set loop count");
         return;
     }
     gif_->loop_count = count;
 }
 
 uint16_t LvglGif::width() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         return 0;
     }
-    return gif_->width;
+    return img_dsc_.header.w;
 }
 
 uint16_t LvglGif::height() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         return 0;
     }
-    return gif_->height;
+    return img_dsc_.header.h;
 }
 
 void LvglGif::SetFrameCallback(std::function<void()> callback) {
@@ -153,7 +184,16 @@ void LvglGif::SetFrameCallback(std::function<void()> callback) {
 }
 
 void LvglGif::NextFrame() {
-    if (!loaded_ || !gif_ || !playing_) {
+    if (!loaded_ || !playing_) {
+        return;
+    }
+
+    if (cached_frames_) {
+        NextCachedFrame();
+        return;
+    }
+
+    if (!gif_) {
         return;
     }
 
@@ -166,6 +206,8 @@ void LvglGif::NextFrame() {
     last_call_ = lv_tick_get();
 
     // Get next frame
+    uint32_t position = gif_->f_rw_p;
+    int64_t start_time = esp_timer_get_time();
     int has_next = gd_get_frame(gif_);
     if (has_next == 0) {
         // Animation finished, pause timer
@@ -179,6 +221,16 @@ void LvglGif::NextFrame() {
     // Render current frame
     if (gif_->canvas) {
         gd_render_frame(gif_, gif_->canvas);
+
+        if (recording_) {
+            decode_time_us_ += esp_timer_get_time() - start_time;
+            if (has_next == 1) {
+                // 读到结尾后解码器会跳回第一帧，读取位置变小说明第一轮已经结束
+                RecordFrame(gif_->f_rw_p < position);
+            } else {
+                recording_.reset();
+            }
+        }
         
         // Call frame callback if set
         if (frame_callback_) {
@@ -187,6 +239,62 @@ void LvglGif::NextFrame() {
     }
 }
 
+void LvglGif::NextCachedFrame() {
+    auto& frames = cached_frames_->frames;
+    uint32_t elapsed = lv_tick_elaps(last_call_);
+    if (elapsed < frames[frame_index_].delay_ms) {
+        return;
+    }
+
+    last_call_ = lv_tick_get();
+    frame_index_ = (frame_index_ + 1) % frames.size();
+    img_dsc_.data = frames[frame_index_].pixels;
+    // 描述符不变但数据地址变了，丢弃 LVGL 可能缓存的旧帧
+    lv_image_cache_drop(&img_dsc_);
+
+    if (frame_callback_) {
+        frame_callback_();
+    }
+}
+
+void LvglGif::RecordFrame(bool loop_restarted) {
+    if (!loop_restarted) {
+        if (!recording_->AddFrame(gif_->canvas, gif_->gce.delay * 10, GifFrameCache::GetInstance().max_entry_bytes())) {
+            ESP_LOGD(TAG, "GIF does not fit in the frame cache, stop recording");
+            recording_.reset();
+        }
+        return;
+    }
+
+    // 刚解码出的是下一轮的首帧，此前记录的帧即完整的一轮
+    auto frame_set = std::move(recording_);
+    if (gif_->loop_count != 0 || frame_set->frames.empty()) {
+        return;
+    }
+    ESP_LOGI(TAG, "GIF %dx%d: %u frames decoded in %d ms", frame_set->width, frame_set->height,
+        frame_set->frames.size(), int(decode_time_us_ / 1000));
+    GifFrameCache::GetInstance().Insert(frame_set);
+
+    // 之后的循环直接切换缓存帧，释放解码器占用的内存
+    cached_frames_ = frame_set;
+    frame_index_ = 0;
+    img_dsc_.data = cached_frames_->frames[0].pixels;
+    lv_image_cache_drop(&img_dsc_);
+    gd_close_gif(gif_);
+    gif_ = nullptr;
+}
+
+void LvglGif::InitImageDsc(uint16_t width, uint16_t height, const uint8_t* data) {
+    img_dsc_.header.magic = LV_IMAGE_HEADER_MAGIC;
+    img_dsc_.header.flags = LV_IMAGE_FLAGS_MODIFIABLE;
+    img_dsc_.header.cf = LV_COLOR_FORMAT_ARGB8888;
+    img_dsc_.header.w = width;
+    img_dsc_.header.h = height;
+    img_dsc_.header.stride = width * 4;
+    img_dsc_.data = data;
+    img_dsc_.data_size = width * height * 4;
+}
+
 void LvglGif::Cleanup() {
     // Stop and delete timer
     if (timer_) {
@@ -200,6 +308,8 @@ void LvglGif::Cleanup() {
         gif_ = nullptr;
     }
 
+    cached_frames_.reset();
+    recording_.reset();
     playing_ = false;
     loaded_ = false;
     
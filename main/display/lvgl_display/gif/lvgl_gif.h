@@ -1,52 +1,56 @@
 #pragma once
 
 #include "../lvgl_image.h"
+#include "../lvgl_animation.h"
 #include "gifdec.h"
+#include "gif_frame_cache.h"
 #include <lvgl.h>
 #include <memory>
 #include <functional>
 
 /**
  * C++ implementation of LVGL GIF widget
- * Provides GIF animation functionality using gifdec library
+ * Provides GIF animation functionality using gifdec library.
+ * Looping GIFs are recorded into GifFrameCache during the first loop,
+ * later instances of the same GIF play the cached frames without decoding.
  */
-class LvglGif {
+class LvglGif : public LvglAnimation {
 public:
     explicit LvglGif(const lv_img_dsc_t* img_dsc);
     virtual ~LvglGif();
 
-    // LvglImage interface implementation
-    virtual const lv_img_dsc_t* image_dsc() const;
+    // LvglAnimation interface implementation
+    virtual const lv_img_dsc_t* image_dsc() const override;
 
     /**
      * Start/restart GIF animation
      */
-    void Start();
+    virtual void Start() override;
 
     /**
      * Pause GIF animation
      */
-    void Pause();
+    virtual void Pause() override;
 
     /**
      * Resume GIF animation
      */
-    void Resume();
+    virtual void Resume() override;
 
     /**
      * Stop GIF animation and rewind to first frame
      */
-    void Stop();
+    virtual void Stop() override;
 
     /**
      * Check if GIF is currently playing
      */
-    bool IsPlaying() const;
+    virtual bool IsPlaying() const override;
 
     /**
      * Check if GIF was loaded successfully
      */
-    bool IsLoaded() const;
+    virtual bool IsLoaded() const override;
 
     /**
      * Get loop count
@@ -61,17 +65,27 @@ public:
     /**
      * Get GIF dimensions
      */
-    uint16_t width() const;
-    uint16_t height() const;
+    virtual uint16_t width() const override;
+    virtual uint16_t height() const override;
 
     /**
      * Set frame update callback
      */
-    void SetFrameCallback(std::function<void()> callback);
+    virtual void SetFrameCallback(std::function<void()> callback) override;
 
 private:
-    // GIF decoder instance
+    // GIF decoder instance, nullptr when playing from the frame cache
     gd_GIF* gif_;
+
+    // Source GIF data, used as the frame cache key
+    const void* source_;
+    size_t source_size_;
+
+    // Decoded frames being played back, and frames recorded during the first loop
+    std::shared_ptr<GifFrameSet> cached_frames_;
+    std::shared_ptr<GifFrameSet> recording_;
+    size_t frame_index_;
+    int64_t decode_time_us_;
     
     // LVGL image descriptor
     lv_img_dsc_t img_dsc_;
@@ -93,6 +107,21 @@ private:
      * Update to next frame
      */
     void NextFrame();
+
+    /**
+     * Switch to the next cached frame
+     */
+    void NextCachedFrame();
+
+    /**
+     * Record the rendered canvas, commit the frame set at the end of the first loop
+     */
+    void RecordFrame(bool loop_restarted);
+
+    /**
+     * Fill the LVGL image descriptor
+     */
+    void InitImageDsc(uint16_t width, uint16_t height, const uint8_t* data);
     
     /**
      * Cleanup resources
@@ -3,6 +3,7 @@
 #include <esp_log.h>
 #include <stddef.h>
 #include <string.h>
+#include <sys/param.h>
 #include <utility>
 
 #include "esp_jpeg_common.h"
@@ -327,7 +328,7 @@ static bool encode_with_hw_jpeg(const uint8_t* src, size_t src_len, uint16_t wid
 
     if (cb) {
         cb(cb_arg, 0, outbuf, (size_t)out_len);
-        cb(cb_arg, 1, NULL, 0);
+        cb(cb_arg, (size_t)out_len, NULL, 0);
         free(outbuf);
         if (jpg_out)
             *jpg_out = NULL;
@@ -405,7 +406,7 @@ static bool encode_with_esp_new_jpeg(const uint8_t* src, size_t src_len, uint16_
 
     if (cb) {
         cb(cb_arg, 0, outbuf, (size_t)out_len);
-        cb(cb_arg, 1, NULL, 0);  // 结束信号
+        cb(cb_arg, (size_t)out_len, NULL, 0);  // 结束信号
         free(outbuf);
         if (jpg_out)
             *jpg_out = NULL;
@@ -424,6 +425,222 @@ static bool encode_with_esp_new_jpeg(const uint8_t* src, size_t src_len, uint16_
     return true;
 }
 
+// 把第 y 行开始的 rows 行源图像转换为编码器输入格式，写入 band（band_rows 行），不足的行复制最后一行补齐
+static bool convert_band(const uint8_t* src, uint16_t width, int y, int rows, int band_rows, v4l2_pix_fmt_t format,
+                         uint16_t height, uint8_t* staging, esp_imgfx_color_convert_handle_t convert_handle,
+                         uint8_t* band, int band_row_bytes) {
+    switch (format) {
+        case V4L2_PIX_FMT_GREY:
+        case V4L2_PIX_FMT_YUYV:
+            memcpy(band, src + (size_t)y * band_row_bytes, (size_t)rows * band_row_bytes);
+            break;
+        case V4L2_PIX_FMT_UYVY: {
+            // src: Cb, Y0, Cr, Y1 -> dst: Y0, Cb, Y1, Cr
+            const uint8_t* s = src + (size_t)y * band_row_bytes;
+            uint8_t* d = band;
+            for (int i = 0; i < rows * band_row_bytes; i += 4) {
+                d[0] = s[1];
+                d[1] = s[0];
+                d[2] = s[3];
+                d[3] = s[2];
+                s += 4;
+                d += 4;
+            }
+            break;
+        }
+        case V4L2_PIX_FMT_YUV422P: {
+            const uint8_t* y_plane = src;
+            const uint8_t* u_plane = y_plane + (int)width * (int)height;
+            const uint8_t* v_plane = u_plane + ((int)width / 2) * (int)height;
+            uint8_t* dst = band;
+            for (int row = y; row < y + rows; row++) {
+                const uint8_t* y_row = y_plane + row * (int)width;
+                const uint8_t* u_row = u_plane + row * ((int)width / 2);
+                const uint8_t* v_row = v_plane + row * ((int)width / 2);
+                for (int x = 0; x < width; x += 2) {
+                    dst[0] = y_row[x + 0];
+                    dst[1] = u_row[x / 2];
+                    dst[2] = y_row[x + 1];
+                    dst[3] = v_row[x / 2];
+                    dst += 4;
+                }
+            }
+            break;
+        }
+        default: {
+            // RGB 系列通过 esp_imgfx 按分段转换为 YUYV，转换器按整段打开，最后一段先在 staging 中补齐
+            int src_bpp = format == V4L2_PIX_FMT_RGB24 ? 3 : 2;
+            size_t src_row_bytes = (size_t)width * src_bpp;
+            const uint8_t* band_src = src + (size_t)y * src_row_bytes;
+            if (rows < band_rows) {
+                memcpy(staging, band_src, rows * src_row_bytes);
+                for (int row = rows; row < band_rows; row++) {
+                    memcpy(staging + row * src_row_bytes, staging + (rows - 1) * src_row_bytes, src_row_bytes);
+                }
+                band_src = staging;
+            }
+            esp_imgfx_data_t convert_input_data = {
+                .data = const_cast<uint8_t*>(band_src),
+                .data_len = static_cast<uint32_t>(band_rows * src_row_bytes),
+            };
+            esp_imgfx_data_t convert_output_data = {
+                .data = band,
+                .data_len = static_cast<uint32_t>(band_rows * band_row_bytes),
+            };
+            if (esp_imgfx_color_convert_process(convert_handle, &convert_input_data, &convert_output_data) != ESP_IMGFX_ERR_OK) {
+                ESP_LOGE(TAG, "esp_imgfx_color_convert_process failed");
+                return false;
+            }
+            return true;
+        }
+    }
+    for (int row = rows; row < band_rows; row++) {
+        memcpy(band + row * band_row_bytes, band + (rows - 1) * band_row_bytes, band_row_bytes);
+    }
+    return true;
+}
+
+// 按 MCU 行分段编码：每次只转换一个分段并立即输出压缩数据，不需要整帧的中间缓冲区和输出缓冲区
+// 宽度不是 MCU 宽度的整数倍时编码器的分段带有填充，无法按行直接拷贝，置位 *unsupported 由调用者整帧编码
+static bool encode_with_esp_new_jpeg_blocks(const uint8_t* src, size_t src_len, uint16_t width, uint16_t height,
+                                            v4l2_pix_fmt_t format, uint8_t quality, jpg_out_cb cb, void* cb_arg,
+                                            bool* unsupported) {
+    *unsupported = false;
+    if (quality < 1)
+        quality = 1;
+    if (quality > 100)
+        quality = 100;
+
+    jpeg_pixel_format_t enc_src_type = JPEG_PIXEL_FORMAT_YCbYCr;
+    esp_imgfx_pixel_fmt_t in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB888;
+    bool use_imgfx = false;
+    size_t expected_len = (size_t)width * height * 2;
+    switch (format) {
+        case V4L2_PIX_FMT_GREY:
+            enc_src_type = JPEG_PIXEL_FORMAT_GRAY;
+            expected_len = (size_t)width * height;
+            break;
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_UYVY:
+        case V4L2_PIX_FMT_YUV422P:
+            break;
+        case V4L2_PIX_FMT_RGB24:
+            in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB888;
+            expected_len = (size_t)width * height * 3;
+            use_imgfx = true;
+            break;
+        case V4L2_PIX_FMT_RGB565:
+            in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_LE;
+            use_imgfx = true;
+            break;
+        case V4L2_PIX_FMT_RGB565X:
+            in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_BE;
+            use_imgfx = true;
+            break;
+        default:
+            ESP_LOGE(TAG, "unsupported format: 0x%08x", format);
+            return false;
+    }
+    if (src_len < expected_len) {
+        ESP_LOGE(TAG, "source too short: %u < %u", (unsigned)src_len, (unsigned)expected_len);
+        return false;
+    }
+
+    jpeg_enc_config_t cfg = DEFAULT_JPEG_ENC_CONFIG();
+    cfg.width = width;
+    cfg.height = height;
+    cfg.src_type = enc_src_type;
+    cfg.subsampling = (enc_src_type == JPEG_PIXEL_FORMAT_GRAY) ? JPEG_SUBSAMPLE_GRAY : JPEG_SUBSAMPLE_420;
+    cfg.quality = quality;
+    cfg.rotate = JPEG_ROTATE_0D;
+    cfg.task_enable = false;
+
+    jpeg_enc_handle_t h = NULL;
+    jpeg_error_t ret = jpeg_enc_open(&cfg, &h);
+    if (ret != JPEG_ERR_OK) {
+        ESP_LOGE(TAG, "jpeg_enc_open failed: %d", (int)ret);
+        return false;
+    }
+
+    // 一个分段是一行 MCU（420 为 16 行，灰度为 8 行）
+    int band_row_bytes = (int)width * (enc_src_type == JPEG_PIXEL_FORMAT_GRAY ? 1 : 2);
+    int block_size = jpeg_enc_get_block_size(h);
+    if (block_size <= 0 || block_size % band_row_bytes != 0) {
+        ESP_LOGW(TAG, "block size %d does not fit %u px rows, encode the whole frame", block_size, width);
+        jpeg_enc_close(h);
+        *unsupported = true;
+        return false;
+    }
+    int band_rows = block_size / band_row_bytes;
+
+    // 单个分段的压缩数据不会超过其原始大小的两倍，首段还包含约 600 字节的文件头
+    size_t out_cap = (size_t)block_size * 2 + 2048;
+    uint8_t* band = (uint8_t*)jpeg_calloc_align(block_size, 16);
+    uint8_t* outbuf = (uint8_t*)malloc_psram(out_cap);
+    uint8_t* staging = nullptr;
+    esp_imgfx_color_convert_handle_t convert_handle = nullptr;
+    bool ok = band != nullptr && outbuf != nullptr;
+    if (!ok) {
+        ESP_LOGE(TAG, "alloc band buffers failed");
+    }
+    if (ok && use_imgfx) {
+        esp_imgfx_color_convert_cfg_t convert_cfg = {
+            .in_res = {.width = static_cast<int16_t>(width),
+                        .height = static_cast<int16_t>(band_rows)},
+            .in_pixel_fmt = in_pixel_fmt,
+            .out_pixel_fmt = ESP_IMGFX_PIXEL_FMT_YUYV,
+            .color_space_std = ESP_IMGFX_COLOR_SPACE_STD_BT601,
+        };
+        if (esp_imgfx_color_convert_open(&convert_cfg, &convert_handle) != ESP_IMGFX_ERR_OK || convert_handle == nullptr) {
+            ESP_LOGE(TAG, "esp_imgfx_color_convert_open failed");
+            convert_handle = nullptr;
+            ok = false;
+        }
+        if (ok && height % band_rows != 0) {
+            staging = (uint8_t*)malloc_psram((size_t)width * band_rows * (format == V4L2_PIX_FMT_RGB24 ? 3 : 2));
+            ok = staging != nullptr;
+        }
+    }
+
+    size_t written = 0;
+    for (int y = 0; ok && y < height; y += band_rows) {
+        int rows = MIN(band_rows, height - y);
+        if (!convert_band(src, width, y, rows, band_rows, format, height, staging, convert_handle, band, band_row_bytes)) {
+            ok = false;
+            break;
+        }
+        int out_len = 0;
+        ret = jpeg_enc_process_with_block(h, band, block_size, outbuf, (int)out_cap, &out_len);
+        if (ret < JPEG_ERR_OK) {
+            ESP_LOGE(TAG, "jpeg_enc_process_with_block failed: %d", (int)ret);
+            ok = false;
+            break;
+        }
+        if (out_len > 0) {
+            cb(cb_arg, written, outbuf, (size_t)out_len);
+            written += out_len;
+        }
+    }
+
+    if (convert_handle != nullptr) {
+        esp_imgfx_color_convert_close(convert_handle);
+    }
+    jpeg_enc_close(h);
+    if (staging) {
+        free(staging);
+    }
+    if (outbuf) {
+        free(outbuf);
+    }
+    if (band) {
+        jpeg_free_align(band);
+    }
+    if (ok) {
+        cb(cb_arg, written, NULL, 0);  // 结束信号
+    }
+    return ok;
+}
+
 bool image_to_jpeg(uint8_t* src, size_t src_len, uint16_t width, uint16_t height, v4l2_pix_fmt_t format,
                    uint8_t quality, uint8_t** out, size_t* out_len) {
 #ifdef CONFIG_XIAOZHI_CAMERA_ALLOW_JPEG_INPUT
@@ -453,7 +670,7 @@ bool image_to_jpeg_cb(uint8_t* src, size_t src_len, uint16_t width, uint16_t hei
 #ifdef CONFIG_XIAOZHI_CAMERA_ALLOW_JPEG_INPUT
     if (format == V4L2_PIX_FMT_JPEG) {
         cb(arg, 0, src, src_len);
-        cb(arg, 1, nullptr, 0); // end signal
+        cb(arg, src_len, nullptr, 0); // end signal
         return true;
     }
 #endif // CONFIG_XIAOZHI_CAMERA_ALLOW_JPEG_INPUT
@@ -463,5 +680,13 @@ bool image_to_jpeg_cb(uint8_t* src, size_t src_len, uint16_t width, uint16_t hei
     }
     // Fallback to esp_new_jpeg
 #endif
+    bool unsupported = false;
+    if (encode_with_esp_new_jpeg_blocks(src, src_len, width, height, format, quality, cb, arg, &unsupported)) {
+        return true;
+    }
+    if (!unsupported) {
+        return false;
+    }
+    // 分段编码失败前没有输出任何数据，可以安全地改为整帧编码
     return encode_with_esp_new_jpeg(src, src_len, width, height, format, quality, NULL, NULL, cb, arg);
 }
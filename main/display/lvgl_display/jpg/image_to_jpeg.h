@@ -15,7 +15,8 @@ extern "C" {
 #endif
 
 // JPEG输出回调函数类型
-// arg: 用户自定义参数, index: 当前数据索引, data: JPEG数据块, len: 数据块长度
+// arg: 用户自定义参数, index: 数据块在 JPEG 文件中的偏移, data: JPEG数据块, len: 数据块长度
+// 数据输出完毕后会以 data = NULL, len = 0 再调用一次作为结束信号
 // 返回: 实际处理的字节数
 typedef size_t (*jpg_out_cb)(void *arg, size_t index, const void *data, size_t len);
 
@@ -46,8 +47,8 @@ bool image_to_jpeg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height
  * 
  * 使用回调函数处理JPEG输出数据，适合流式传输或分块处理：
  * - 节省约8KB的SRAM使用（静态变量改为堆分配）
- * - 支持流式输出，无需预分配大缓冲区
- * - 通过回调函数逐块处理JPEG数据
+ * - 软件编码按 MCU 行（16 行）分段转换和编码，只需要一个分段的输入和输出缓冲区
+ * - 每个分段编码完成后立即通过回调输出，回调会被调用多次
  * 
  * @param src       源图像数据
  * @param src_len   源图像数据长度
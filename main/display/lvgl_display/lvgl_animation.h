@@ -0,0 +1,31 @@
+#pragma once
+
+#include <lvgl.h>
+#include <cstdint>
+#include <functional>
+
+/**
+ * Common interface of animated emoji players (GIF, RLA)
+ */
+class LvglAnimation {
+public:
+    virtual ~LvglAnimation() = default;
+
+    // Current frame, valid until the next frame callback
+    virtual const lv_img_dsc_t* image_dsc() const = 0;
+
+    virtual void Start() = 0;
+    virtual void Pause() = 0;
+    virtual void Resume() = 0;
+    // Stop the animation and rewind to the first frame
+    virtual void Stop() = 0;
+
+    virtual bool IsPlaying() const = 0;
+    virtual bool IsLoaded() const = 0;
+
+    virtual uint16_t width() const = 0;
+    virtual uint16_t height() const = 0;
+
+    // Called after a new frame is ready
+    virtual void SetFrameCallback(std::function<void()> callback) = 0;
+};
@@ -15,6 +15,10 @@
 
 #define TAG "Display"
 
+// 超过该时间没有任何无效区域，刷新定时器切换到空闲周期
+#define REFRESH_IDLE_TIMEOUT_US     (3 * 1000 * 1000)
+#define REFRESH_IDLE_PERIOD_MS      200
+
 LvglDisplay::LvglDisplay() {
     // Notification timer
     esp_timer_create_args_t notification_timer_args = {
@@ -79,6 +83,7 @@ void LvglDisplay::SetStatus(const char* status) {
     lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
 
     last_status_update_time_ = std::chrono::system_clock::now();
+    status_is_clock_ = false;
 }
 
 void LvglDisplay::ShowNotification(const std::string &notification, int duration_ms) {
@@ -102,49 +107,42 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
     auto& app = Application::GetInstance();
     auto& board = Board::GetInstance();
     auto codec = board.GetAudioCodec();
-
-    // Update mute icon
-    {
-        DisplayLockGuard lock(this);
-        if (mute_label_ == nullptr) {
-            return;
-        }
-
-        // Update icon if mute state changes
-        if (codec->output_volume() == 0 && !muted_) {
-            muted_ = true;
-            lv_label_set_text(mute_label_, FONT_AWESOME_VOLUME_XMARK);
-        } else if (codec->output_volume() > 0 && muted_) {
-            muted_ = false;
-            lv_label_set_text(mute_label_, "");
-        }
+    if (mute_label_ == nullptr) {
+        return;
     }
 
-    // Update time
-    if (app.GetDeviceState() == kDeviceStateIdle) {
-        if (last_status_update_time_ + std::chrono::seconds(10) < std::chrono::system_clock::now()) {
-            // Set status to clock "HH:MM"
-            time_t now = time(NULL);
-            struct tm* tm = localtime(&now);
+    // 先在锁外收集状态，只有值发生变化的控件才需要加锁刷新
+    bool muted = codec->output_volume() == 0;
+    bool mute_changed = update_all || muted != muted_;
+
+    // Update time: only format the clock when the minute changes, or when the status label shows something else
+    char time_str[16] = {0};
+    auto device_state = app.GetDeviceState();
+    if (device_state == kDeviceStateIdle &&
+        last_status_update_time_ + std::chrono::seconds(10) < std::chrono::system_clock::now()) {
+        time_t now = time(NULL);
+        time_t minute = now / 60;
+        if (update_all || !status_is_clock_ || minute != clock_minute_) {
+            struct tm tm;
+            localtime_r(&now, &tm);
             // Check if the we have already set the time
-            if (tm->tm_year >= 2025 - 1900) {
-                char time_str[16];
-                strftime(time_str, sizeof(time_str), "%H:%M", tm);
-                SetStatus(time_str);
+            if (tm.tm_year >= 2025 - 1900) {
+                strftime(time_str, sizeof(time_str), "%H:%M", &tm);
+                clock_minute_ = minute;
             } else {
-                ESP_LOGW(TAG, "System time is not set, tm_year: %d", tm->tm_year);
+                ESP_LOGW(TAG, "System time is not set, tm_year: %d", tm.tm_year);
             }
         }
     }
 
-    esp_pm_lock_acquire(pm_lock_);
     // Update battery icon
     int battery_level;
     bool charging, discharging;
-    const char* icon = nullptr;
+    const char* battery_icon = battery_icon_;
+    bool show_low_battery = low_battery_shown_;
     if (board.GetBatteryLevel(battery_level, charging, discharging)) {
         if (charging) {
-            icon = FONT_AWESOME_BATTERY_BOLT;
+            battery_icon = FONT_AWESOME_BATTERY_BOLT;
         } else {
             const char* levels[] = {
                 FONT_AWESOME_BATTERY_EMPTY, // 0-19%
@@ -154,34 +152,15 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
                 FONT_AWESOME_BATTERY_FULL, // 80-99%
                 FONT_AWESOME_BATTERY_FULL, // 100%
             };
-            icon = levels[battery_level / 20];
-        }
-        DisplayLockGuard lock(this);
-        if (battery_label_ != nullptr && battery_icon_ != icon) {
-            battery_icon_ = icon;
-            lv_label_set_text(battery_label_, battery_icon_);
-        }
-
-        if (low_battery_popup_ != nullptr) {
-            if (strcmp(icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging) {
-                if (lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // Show if low battery popup is hidden
-                    lv_obj_remove_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
-                    app.PlaySound(Lang::Sounds::OGG_LOW_BATTERY);
-                }
-            } else {
-                // Hide the low battery popup when the battery is not empty
-                if (!lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // Hide if low battery popup is shown
-                    lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
-                }
-            }
+            battery_icon = levels[battery_level / 20];
         }
+        show_low_battery = strcmp(battery_icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging;
     }
 
     // Update network icon every 10 seconds
-    static int seconds_counter = 0;
-    if (update_all || seconds_counter++ % 10 == 0) {
+    const char* network_icon = network_icon_;
+    if (update_all || status_bar_seconds_ % 10 == 0) {
         // Don't read 4G network status during firmware upgrade to avoid occupying UART resources
-        auto device_state = Application::GetInstance().GetDeviceState();
         static const std::vector<DeviceState> allowed_states = {
             kDeviceStateIdle,
             kDeviceStateStarting,
@@ -190,16 +169,152 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
             kDeviceStateActivating,
         };
         if (std::find(allowed_states.begin(), allowed_states.end(), device_state) != allowed_states.end()) {
-            icon = board.GetNetworkStateIcon();
-            if (network_label_ != nullptr && icon != nullptr && network_icon_ != icon) {
-                DisplayLockGuard lock(this);
-                network_icon_ = icon;
+            esp_pm_lock_acquire(pm_lock_);
+            auto icon = board.GetNetworkStateIcon();
+            esp_pm_lock_release(pm_lock_);
+            if (icon != nullptr) {
+                network_icon = icon;
+            }
+        }
+    }
+
+    bool battery_changed = battery_label_ != nullptr && battery_icon != nullptr && battery_icon != battery_icon_;
+    bool low_battery_changed = low_battery_popup_ != nullptr && show_low_battery != low_battery_shown_;
+    bool network_changed = network_label_ != nullptr && network_icon != nullptr && network_icon != network_icon_;
+    bool clock_changed = time_str[0] != '\0';
+
+    if (mute_changed || battery_changed || low_battery_changed || network_changed || clock_changed) {
+        esp_pm_lock_acquire(pm_lock_);
+        {
+            DisplayLockGuard lock(this);
+            status_bar_lock_count_++;
+            if (mute_changed) {
+                muted_ = muted;
+                lv_label_set_text(mute_label_, muted_ ? FONT_AWESOME_VOLUME_XMARK : "");
+                status_bar_widget_updates_++;
+            }
+            if (battery_changed) {
+                battery_icon_ = battery_icon;
+                lv_label_set_text(battery_label_, battery_icon_);
+                status_bar_widget_updates_++;
+            }
+            if (low_battery_changed) {
+                low_battery_shown_ = show_low_battery;
+                if (low_battery_shown_) {
+                    lv_obj_remove_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+                } else {
+                    lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+                }
+                status_bar_widget_updates_++;
+            }
+            if (network_changed) {
+                network_icon_ = network_icon;
                 lv_label_set_text(network_label_, network_icon_);
+                status_bar_widget_updates_++;
+            }
+        }
+        if (clock_changed) {
+            SetStatus(time_str);
+            status_is_clock_ = true;
+            status_bar_lock_count_++;
+            status_bar_widget_updates_++;
+        }
+        esp_pm_lock_release(pm_lock_);
+
+        if (low_battery_changed && low_battery_shown_) {
+            app.PlaySound(Lang::Sounds::OGG_LOW_BATTERY);
+        }
+    }
+
+    InstallRefreshMonitor();
+    UpdateRefreshGovernor();
+    if (++status_bar_seconds_ % 60 == 0) {
+        ESP_LOGI(TAG, "Status bar: %lu lock acquisitions, %lu widget updates, %lu px invalidated in the last 60s",
+            status_bar_lock_count_, status_bar_widget_updates_, invalidated_pixels_.load());
+        uint32_t frames = flushed_frames_.exchange(0);
+        ESP_LOGI(TAG, "Refresh: %lu.%02lu fps, %lu px flushed, %lu ms in flush, %lu ms waiting for flush, %s",
+            frames / 60, frames * 100 / 60 % 100, flushed_pixels_.exchange(0),
+            flush_time_us_.exchange(0) / 1000, flush_wait_time_us_.exchange(0) / 1000,
+            refresh_idle_ ? "idle" : "active");
+        status_bar_lock_count_ = 0;
+        status_bar_widget_updates_ = 0;
+        invalidated_pixels_ = 0;
+    }
+}
+
+// 统计 LVGL 的无效区域、刷屏帧数、像素数和刷屏耗时，并在有新内容时唤醒刷新定时器
+void LvglDisplay::InstallRefreshMonitor() {
+    if (refresh_monitor_installed_ || display_ == nullptr) {
+        return;
+    }
+    DisplayLockGuard lock(this);
+    last_invalidate_time_ = esp_timer_get_time();
+    lv_display_add_event_cb(display_, [](lv_event_t* e) {
+        auto self = static_cast<LvglDisplay*>(lv_event_get_user_data(e));
+        switch (lv_event_get_code(e)) {
+        case LV_EVENT_INVALIDATE_AREA: {
+            auto area = static_cast<lv_area_t*>(lv_event_get_param(e));
+            if (area != nullptr) {
+                self->invalidated_pixels_ += lv_area_get_size(area);
+            }
+            self->last_invalidate_time_ = esp_timer_get_time();
+            if (self->refresh_idle_) {
+                self->SetRefreshIdle(false);
+            }
+            break;
+        }
+        case LV_EVENT_FLUSH_START: {
+            auto area = static_cast<lv_area_t*>(lv_event_get_param(e));
+            if (area != nullptr) {
+                self->flushed_pixels_ += lv_area_get_size(area);
+            }
+            self->flush_start_time_ = esp_timer_get_time();
+            break;
+        }
+        case LV_EVENT_FLUSH_FINISH:
+            self->flush_time_us_ += esp_timer_get_time() - self->flush_start_time_;
+            if (lv_display_flush_is_last(self->display_)) {
+                self->flushed_frames_++;
             }
+            break;
+        case LV_EVENT_FLUSH_WAIT_START:
+            self->flush_wait_start_time_ = esp_timer_get_time();
+            break;
+        case LV_EVENT_FLUSH_WAIT_FINISH:
+            self->flush_wait_time_us_ += esp_timer_get_time() - self->flush_wait_start_time_;
+            break;
+        default:
+            break;
         }
+    }, LV_EVENT_ALL, this);
+    refresh_monitor_installed_ = true;
+}
+
+void LvglDisplay::UpdateRefreshGovernor() {
+    if (!refresh_monitor_installed_ || refresh_idle_) {
+        return;
+    }
+    if (esp_timer_get_time() - last_invalidate_time_ < REFRESH_IDLE_TIMEOUT_US) {
+        return;
     }
+    DisplayLockGuard lock(this);
+    SetRefreshIdle(true);
+}
 
-    esp_pm_lock_release(pm_lock_);
+// 需在持有显示锁时调用
+void LvglDisplay::SetRefreshIdle(bool idle) {
+    lv_timer_t* refr_timer = lv_display_get_refr_timer(display_);
+    if (refr_timer == nullptr) {
+        return;
+    }
+    refresh_idle_ = idle;
+    if (idle) {
+        lv_timer_set_period(refr_timer, REFRESH_IDLE_PERIOD_MS);
+    } else {
+        // 恢复默认刷新周期并立即刷新，避免空闲后第一帧的延迟
+        lv_timer_set_period(refr_timer, LV_DEF_REFR_PERIOD);
+        lv_timer_ready(refr_timer);
+    }
 }
 
 void LvglDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
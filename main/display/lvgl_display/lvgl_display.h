@@ -11,6 +11,7 @@
 
 #include <string>
 #include <chrono>
+#include <atomic>
 
 class LvglDisplay : public Display {
 public:
@@ -40,10 +41,34 @@ protected:
     const char* battery_icon_ = nullptr;
     const char* network_icon_ = nullptr;
     bool muted_ = false;
+    bool low_battery_shown_ = false;
+
+    // 状态栏变化检测
+    bool status_is_clock_ = false;
+    time_t clock_minute_ = 0;
+    uint32_t status_bar_seconds_ = 0;
+    uint32_t status_bar_lock_count_ = 0;
+    uint32_t status_bar_widget_updates_ = 0;
+    std::atomic<uint32_t> invalidated_pixels_{0};
+
+    // 刷新调节：一段时间没有无效区域时降低 LVGL 刷新频率，并统计刷新开销
+    bool refresh_monitor_installed_ = false;
+    bool refresh_idle_ = false;
+    std::atomic<int64_t> last_invalidate_time_{0};
+    std::atomic<uint32_t> flushed_frames_{0};
+    std::atomic<uint32_t> flushed_pixels_{0};
+    std::atomic<uint32_t> flush_time_us_{0};
+    std::atomic<uint32_t> flush_wait_time_us_{0};
+    int64_t flush_start_time_ = 0;
+    int64_t flush_wait_start_time_ = 0;
 
     std::chrono::system_clock::time_point last_status_update_time_;
     esp_timer_handle_t notification_timer_ = nullptr;
 
+    void InstallRefreshMonitor();
+    void UpdateRefreshGovernor();
+    void SetRefreshIdle(bool idle);
+
     friend class DisplayLockGuard;
     virtual bool Lock(int timeout_ms = 0) = 0;
     virtual void Unlock() = 0;
@@ -2,11 +2,24 @@
 #include <cbin_font.h>
 
 
-LvglCBinFont::LvglCBinFont(void* data) {
+#ifndef CONFIG_LVGL_GLYPH_CACHE_SIZE_KB
+#define CONFIG_LVGL_GLYPH_CACHE_SIZE_KB 0
+#endif
+
+LvglCBinFont::LvglCBinFont(void* data, bool glyph_cache, uint32_t fallback_letter) {
     font_ = cbin_font_create(static_cast<uint8_t*>(data));
+    size_t budget = glyph_cache ? CONFIG_LVGL_GLYPH_CACHE_SIZE_KB * 1024 : 0;
+    if (font_ != nullptr && (budget > 0 || fallback_letter != 0)) {
+        glyph_cache_ = std::make_unique<LvglGlyphCache>(font_, budget, fallback_letter);
+        if (!glyph_cache_->active()) {
+            glyph_cache_.reset();
+        }
+    }
 }
 
 LvglCBinFont::~LvglCBinFont() {
+    // 代理字体引用原字体的数据，先释放缓存
+    glyph_cache_.reset();
     if (font_ != nullptr) {
         cbin_font_delete(font_);
     }
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <lvgl.h>
+#include <memory>
+
+#include "lvgl_glyph_cache.h"
 
 
 class LvglFont {
@@ -22,10 +25,16 @@ private:
 
 class LvglCBinFont : public LvglFont {
 public:
-    LvglCBinFont(void* data);
+    // glyph_cache: serve glyphs through LvglGlyphCache, only for fonts rendered by LVGL itself
+    // fallback_letter: glyph drawn for letters missing from a subset font, 0 to skip them
+    LvglCBinFont(void* data, bool glyph_cache = false, uint32_t fallback_letter = 0);
     virtual ~LvglCBinFont();
-    virtual const lv_font_t* font() const override { return font_; }
+    virtual const lv_font_t* font() const override {
+        return glyph_cache_ != nullptr ? glyph_cache_->font() : font_;
+    }
+    LvglGlyphCache* glyph_cache() const { return glyph_cache_.get(); }
 
 private:
     lv_font_t* font_;
+    std::unique_ptr<LvglGlyphCache> glyph_cache_;
 };
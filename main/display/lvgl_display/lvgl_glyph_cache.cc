@@ -0,0 +1,223 @@
+#include "lvgl_glyph_cache.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <cstring>
+
+#define TAG "GlyphCache"
+
+static uint32_t GetCacheCaps() {
+    return heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0 ? MALLOC_CAP_SPIRAM : MALLOC_CAP_DEFAULT;
+}
+
+LvglGlyphCache::LvglGlyphCache(const lv_font_t* base, size_t budget, uint32_t fallback_letter) : base_(base) {
+    proxy_.font = *base;
+    proxy_.cache = this;
+
+    if (fallback_letter != 0) {
+        lv_font_glyph_dsc_t dsc = {};
+        if (base->get_glyph_dsc(&proxy_.font, &dsc, fallback_letter, 0)) {
+            fallback_letter_ = fallback_letter;
+        } else {
+            ESP_LOGW(TAG, "Fallback glyph U+%04lX is not in the font", fallback_letter);
+        }
+    }
+    if (budget > 0) {
+        AllocateSlots(budget);
+    }
+
+    if (bitmap_slots_ != nullptr || fallback_letter_ != 0) {
+        proxy_.font.get_glyph_dsc = GetGlyphDsc;
+    }
+    if (bitmap_slots_ != nullptr) {
+        proxy_.font.get_glyph_bitmap = GetGlyphBitmap;
+    }
+}
+
+void LvglGlyphCache::AllocateSlots(size_t budget) {
+    // 按字体行高估算单个字形的大小，组数取 2 的幂
+    size_t line_height = base_->line_height > 0 ? base_->line_height : 16;
+    size_t glyph_bytes = ((line_height + 3) & ~3) * line_height;
+    size_t sets = 1;
+    while (sets * 2 * kWays * glyph_bytes <= budget) {
+        sets *= 2;
+    }
+    if (sets < 8) {
+        ESP_LOGW(TAG, "Budget %u is too small for line height %u, glyph cache disabled", budget, line_height);
+        return;
+    }
+
+    uint32_t caps = GetCacheCaps();
+    dsc_slots_ = (DscSlot*)heap_caps_calloc(kDscSlotCount, sizeof(DscSlot), caps);
+    bitmap_slots_ = (BitmapSlot*)heap_caps_calloc(sets * kWays, sizeof(BitmapSlot), caps);
+    if (dsc_slots_ == nullptr || bitmap_slots_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate glyph cache");
+        heap_caps_free(dsc_slots_);
+        heap_caps_free(bitmap_slots_);
+        dsc_slots_ = nullptr;
+        bitmap_slots_ = nullptr;
+        return;
+    }
+    set_count_ = sets;
+    // 远大于行高的字形（例如表情字体）不缓存，避免少数大字形占满预算
+    max_glyph_bytes_ = glyph_bytes * 4;
+
+    has_kerning_ = DetectKerning();
+    ESP_LOGI(TAG, "Glyph cache: %u sets x %u ways, about %u KB for %u px glyphs%s", sets, kWays,
+        sets * kWays * glyph_bytes / 1024, line_height, has_kerning_ ? ", kerning pairs bypass the cache" : "");
+}
+
+LvglGlyphCache::~LvglGlyphCache() {
+    if (bitmap_slots_ != nullptr) {
+        for (size_t i = 0; i < set_count_ * kWays; i++) {
+            heap_caps_free(bitmap_slots_[i].data);
+        }
+        heap_caps_free(bitmap_slots_);
+    }
+    heap_caps_free(dsc_slots_);
+}
+
+void LvglGlyphCache::ResetStats() {
+    size_t bytes = stats_.bytes;
+    stats_ = {};
+    stats_.bytes = bytes;
+}
+
+// 字形描述只按字符缓存，字体带有字距调整时，有后续字符的查询直接交给原字体
+bool LvglGlyphCache::DetectKerning() {
+    static const char pairs[][2] = { {'A', 'V'}, {'T', 'o'}, {'L', 'T'}, {'V', 'a'}, {'W', 'e'} };
+    for (auto& pair : pairs) {
+        lv_font_glyph_dsc_t with_next = {};
+        lv_font_glyph_dsc_t without_next = {};
+        if (base_->get_glyph_dsc(&proxy_.font, &with_next, pair[0], pair[1]) &&
+            base_->get_glyph_dsc(&proxy_.font, &without_next, pair[0], 0) &&
+            with_next.adv_w != without_next.adv_w) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LvglGlyphCache::GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next) {
+    auto proxy = reinterpret_cast<const ProxyFont*>(font);
+    return proxy->cache->LookupDsc(dsc, letter, letter_next) || proxy->cache->LookupFallback(dsc, letter);
+}
+
+const void* LvglGlyphCache::GetGlyphBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf) {
+    auto proxy = reinterpret_cast<const ProxyFont*>(dsc->resolved_font);
+    return proxy->cache->LookupBitmap(dsc, draw_buf);
+}
+
+bool LvglGlyphCache::LookupDsc(lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next) {
+    if (dsc_slots_ == nullptr) {
+        return base_->get_glyph_dsc(&proxy_.font, dsc, letter, letter_next);
+    }
+    if (has_kerning_ && letter_next != 0) {
+        stats_.dsc_misses++;
+        return base_->get_glyph_dsc(&proxy_.font, dsc, letter, letter_next);
+    }
+
+    auto& slot = dsc_slots_[letter % kDscSlotCount];
+    if (slot.valid && slot.letter == letter) {
+        stats_.dsc_hits++;
+        if (slot.found) {
+            *dsc = slot.dsc;
+        }
+        return slot.found;
+    }
+
+    stats_.dsc_misses++;
+    bool found = base_->get_glyph_dsc(&proxy_.font, dsc, letter, 0);
+    slot.letter = letter;
+    slot.valid = true;
+    slot.found = found;
+    if (found) {
+        slot.dsc = *dsc;
+    }
+    return found;
+}
+
+// 子集字体缺少的可见字符显示为替代字形，控制字符和零宽字符保持不显示
+bool LvglGlyphCache::LookupFallback(lv_font_glyph_dsc_t* dsc, uint32_t letter) {
+    if (fallback_letter_ == 0 || letter == fallback_letter_ || letter < 0x20 || letter == 0x7F ||
+        (letter >= 0x200B && letter <= 0x200F) || (letter >= 0xFE00 && letter <= 0xFE0F) || letter == 0xFEFF) {
+        return false;
+    }
+    if (!LookupDsc(dsc, fallback_letter_, 0)) {
+        return false;
+    }
+    stats_.fallbacks++;
+    return true;
+}
+
+const void* LvglGlyphCache::LookupBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf) {
+    int64_t start_time = esp_timer_get_time();
+    const void* result = nullptr;
+
+    if (draw_buf == nullptr || draw_buf->data == nullptr) {
+        stats_.bitmap_bypasses++;
+        result = base_->get_glyph_bitmap(dsc, draw_buf);
+        stats_.render_time_us += esp_timer_get_time() - start_time;
+        return result;
+    }
+
+    uint32_t index = dsc->gid.index;
+    BitmapSlot* ways = &bitmap_slots_[(index & (set_count_ - 1)) * kWays];
+    uint32_t stride = draw_buf->header.stride;
+    for (size_t i = 0; i < kWays; i++) {
+        auto& slot = ways[i];
+        if (slot.valid && slot.index == index && slot.stride == stride && slot.height == dsc->box_h &&
+            slot.size <= draw_buf->data_size) {
+            memcpy(draw_buf->data, slot.data, slot.size);
+            slot.last_use = ++use_counter_;
+            stats_.bitmap_hits++;
+            result = slot.returns_draw_buf ? (const void*)draw_buf : (const void*)draw_buf->data;
+            stats_.render_time_us += esp_timer_get_time() - start_time;
+            return result;
+        }
+    }
+
+    result = base_->get_glyph_bitmap(dsc, draw_buf);
+    // 原字体直接返回字体数据中的位图时无需缓存
+    uint32_t size = stride * dsc->box_h;
+    if ((result != draw_buf && result != draw_buf->data) || size == 0 || size > draw_buf->data_size ||
+        size > max_glyph_bytes_) {
+        stats_.bitmap_bypasses++;
+        stats_.render_time_us += esp_timer_get_time() - start_time;
+        return result;
+    }
+
+    stats_.bitmap_misses++;
+    BitmapSlot* victim = &ways[0];
+    for (size_t i = 0; i < kWays; i++) {
+        if (!ways[i].valid) {
+            victim = &ways[i];
+            break;
+        }
+        if (ways[i].last_use < victim->last_use) {
+            victim = &ways[i];
+        }
+    }
+    if (victim->capacity < size) {
+        heap_caps_free(victim->data);
+        stats_.bytes -= victim->capacity;
+        victim->data = (uint8_t*)heap_caps_malloc(size, GetCacheCaps());
+        victim->capacity = victim->data != nullptr ? size : 0;
+        stats_.bytes += victim->capacity;
+    }
+    if (victim->data != nullptr) {
+        memcpy(victim->data, draw_buf->data, size);
+        victim->index = index;
+        victim->stride = stride;
+        victim->height = dsc->box_h;
+        victim->size = size;
+        victim->returns_draw_buf = result == draw_buf;
+        victim->last_use = ++use_counter_;
+        victim->valid = true;
+    } else {
+        victim->valid = false;
+    }
+    stats_.render_time_us += esp_timer_get_time() - start_time;
+    return result;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <lvgl.h>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Glyph cache in front of an lv_font_t.
+ * The cache exposes a proxy font whose glyph callbacks look up glyph descriptors and rendered
+ * A8 bitmaps by codepoint / glyph index before falling back to the wrapped font. LVGL measures
+ * and line-breaks label text again on every redraw, so cached descriptors make layout cheap, and
+ * cached bitmaps avoid decoding the same CJK glyphs from the mmapped font over and over.
+ *
+ * Bitmaps live in a 2-way set associative table, the least recently used way of a set is
+ * replaced. All cache storage is allocated in PSRAM when available.
+ *
+ * When a fallback letter is given, letters missing from the font (typical for subset fonts)
+ * are drawn with the fallback glyph instead of being skipped.
+ */
+class LvglGlyphCache {
+public:
+    struct Stats {
+        uint32_t dsc_hits;
+        uint32_t dsc_misses;
+        uint32_t bitmap_hits;
+        uint32_t bitmap_misses;
+        uint32_t bitmap_bypasses;   // Glyphs that are not rendered into the draw buffer
+        uint32_t fallbacks;         // Letters drawn with the fallback glyph
+        uint64_t render_time_us;    // Time spent in the bitmap callback, hits and misses included
+        size_t bytes;
+    };
+
+    // budget is the number of bytes used for glyph bitmaps, 0 to only substitute missing letters
+    LvglGlyphCache(const lv_font_t* base, size_t budget, uint32_t fallback_letter = 0);
+    ~LvglGlyphCache();
+
+    LvglGlyphCache(const LvglGlyphCache&) = delete;
+    LvglGlyphCache& operator=(const LvglGlyphCache&) = delete;
+
+    const lv_font_t* font() const { return &proxy_.font; }
+    bool enabled() const { return bitmap_slots_ != nullptr; }
+    // The proxy font does anything besides forwarding to the wrapped font
+    bool active() const { return enabled() || fallback_letter_ != 0; }
+
+    Stats GetStats() const { return stats_; }
+    void ResetStats();
+
+private:
+    static constexpr size_t kWays = 2;
+    static constexpr size_t kDscSlotCount = 512;
+
+    // The proxy font is the first member so the callbacks can get back to the cache
+    struct ProxyFont {
+        lv_font_t font;
+        LvglGlyphCache* cache;
+    };
+
+    struct DscSlot {
+        uint32_t letter;
+        bool valid;
+        bool found;
+        lv_font_glyph_dsc_t dsc;
+    };
+
+    struct BitmapSlot {
+        uint32_t index;
+        uint32_t last_use;
+        uint16_t stride;
+        uint16_t height;
+        uint32_t size;
+        uint32_t capacity;
+        uint8_t* data;
+        bool valid;
+        bool returns_draw_buf;  // The font returned the draw buffer itself instead of its data pointer
+    };
+
+    ProxyFont proxy_;
+    const lv_font_t* base_;
+    bool has_kerning_ = false;
+    uint32_t fallback_letter_ = 0;
+    DscSlot* dsc_slots_ = nullptr;
+    BitmapSlot* bitmap_slots_ = nullptr;
+    size_t set_count_ = 0;
+    size_t max_glyph_bytes_ = 0;
+    uint32_t use_counter_ = 0;
+    Stats stats_ = {};
+
+    static bool GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next);
+    static const void* GetGlyphBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf);
+
+    void AllocateSlots(size_t budget);
+    bool LookupDsc(lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next);
+    bool LookupFallback(lv_font_glyph_dsc_t* dsc, uint32_t letter);
+    const void* LookupBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf);
+    bool DetectKerning();
+};
@@ -1,4 +1,5 @@
 #include "lvgl_image.h"
+#include "lvgl_rle_animation.h"
 #include <cbin_font.h>
 
 #include <esp_log.h>
@@ -24,6 +25,10 @@ bool LvglRawImage::IsGif() const {
     return ptr[0] == 'G' && ptr[1] == 'I' && ptr[2] == 'F';
 }
 
+bool LvglRawImage::IsRleAnimation() const {
+    return LvglRleAnimation::IsRleAnimation(image_dsc_.data, image_dsc_.data_size);
+}
+
 LvglCBinImage::LvglCBinImage(void* data) {
     image_dsc_ = cbin_img_dsc_create(static_cast<uint8_t*>(data));
 }
@@ -8,6 +8,7 @@ class LvglImage {
 public:
     virtual const lv_img_dsc_t* image_dsc() const = 0;
     virtual bool IsGif() const { return false; }
+    virtual bool IsRleAnimation() const { return false; }
     virtual ~LvglImage() = default;
 };
 
@@ -17,6 +18,7 @@ public:
     LvglRawImage(void* data, size_t size);
     virtual const lv_img_dsc_t* image_dsc() const override { return &image_dsc_; }
     virtual bool IsGif() const;
+    virtual bool IsRleAnimation() const;
 
 private:
     lv_img_dsc_t image_dsc_;
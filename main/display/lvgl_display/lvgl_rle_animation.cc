@@ -0,0 +1,256 @@
+#include "lvgl_rle_animation.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "LvglRleAnimation"
+
+#define RLA_MAGIC               0x31414C52  // 'RLA1'
+#define RLA_HEADER_SIZE         16
+#define RLA_FRAME_INFO_SIZE     12
+#define RLA_FLAG_ALPHA          0x01
+#define RLA_FRAME_KEY           0
+
+#define RLA_OP_COPY             0
+#define RLA_OP_FILL             1
+#define RLA_OP_SKIP             2
+
+// 小尺寸表情的帧缓冲放在内部 RAM，刷新时读取更快
+#define RLA_INTERNAL_BUFFER_MAX (32 * 1024)
+
+static inline uint16_t ReadU16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t ReadU32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool LvglRleAnimation::IsRleAnimation(const void* data, size_t size) {
+    return data != nullptr && size >= RLA_HEADER_SIZE && ReadU32((const uint8_t*)data) == RLA_MAGIC;
+}
+
+LvglRleAnimation::LvglRleAnimation(const lv_img_dsc_t* img_dsc) {
+    memset(&img_dsc_, 0, sizeof(img_dsc_));
+    if (img_dsc == nullptr || !IsRleAnimation(img_dsc->data, img_dsc->data_size)) {
+        ESP_LOGE(TAG, "Invalid RLA data");
+        return;
+    }
+
+    data_ = img_dsc->data;
+    size_t data_size = img_dsc->data_size;
+    width_ = ReadU16(data_ + 4);
+    height_ = ReadU16(data_ + 6);
+    uint16_t frame_count = ReadU16(data_ + 8);
+    has_alpha_ = ReadU16(data_ + 10) & RLA_FLAG_ALPHA;
+    loop_count_ = ReadU16(data_ + 12);
+    if (width_ == 0 || height_ == 0 || frame_count == 0 ||
+        RLA_HEADER_SIZE + (size_t)frame_count * RLA_FRAME_INFO_SIZE > data_size) {
+        ESP_LOGE(TAG, "Invalid RLA header: %ux%u, %u frames", width_, height_, frame_count);
+        return;
+    }
+
+    // 资源数据不保证对齐，帧表逐字节解析后保存
+    frames_.reserve(frame_count);
+    const uint8_t* table = data_ + RLA_HEADER_SIZE;
+    for (uint16_t i = 0; i < frame_count; i++) {
+        const uint8_t* p = table + i * RLA_FRAME_INFO_SIZE;
+        FrameInfo frame = {
+            .offset = ReadU32(p),
+            .size = ReadU32(p + 4),
+            .delay_ms = ReadU16(p + 8),
+            .type = p[10],
+        };
+        if (frame.offset > data_size || frame.size > data_size - frame.offset) {
+            ESP_LOGE(TAG, "Frame %u is out of range", i);
+            frames_.clear();
+            return;
+        }
+        frames_.push_back(frame);
+    }
+    if (frames_[0].type != RLA_FRAME_KEY) {
+        ESP_LOGE(TAG, "The first frame is not a key frame");
+        frames_.clear();
+        return;
+    }
+
+    size_t pixels = (size_t)width_ * height_;
+    size_t buffer_size = pixels * (has_alpha_ ? 3 : 2);
+    if (buffer_size <= RLA_INTERNAL_BUFFER_MAX) {
+        buffer_ = (uint8_t*)heap_caps_malloc(buffer_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (buffer_ == nullptr) {
+        buffer_ = (uint8_t*)heap_caps_malloc(buffer_size, MALLOC_CAP_SPIRAM);
+    }
+    if (buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes frame buffer", buffer_size);
+        return;
+    }
+
+    img_dsc_.header.magic = LV_IMAGE_HEADER_MAGIC;
+    img_dsc_.header.cf = has_alpha_ ? LV_COLOR_FORMAT_RGB565A8 : LV_COLOR_FORMAT_RGB565;
+    img_dsc_.header.flags = LV_IMAGE_FLAGS_MODIFIABLE;
+    img_dsc_.header.w = width_;
+    img_dsc_.header.h = height_;
+    img_dsc_.header.stride = width_ * 2;
+    img_dsc_.data = buffer_;
+    img_dsc_.data_size = buffer_size;
+
+    if (!DecodeFrame(0)) {
+        return;
+    }
+    loaded_ = true;
+    ESP_LOGD(TAG, "RLA loaded: %ux%u, %u frames, alpha %d", width_, height_, frames_.size(), has_alpha_);
+}
+
+LvglRleAnimation::~LvglRleAnimation() {
+    if (timer_ != nullptr) {
+        lv_timer_delete(timer_);
+        timer_ = nullptr;
+    }
+    if (buffer_ != nullptr) {
+        heap_caps_free(buffer_);
+        buffer_ = nullptr;
+    }
+}
+
+const lv_img_dsc_t* LvglRleAnimation::image_dsc() const {
+    if (!loaded_) {
+        return nullptr;
+    }
+    return &img_dsc_;
+}
+
+void LvglRleAnimation::Start() {
+    if (!loaded_) {
+        ESP_LOGW(TAG, "RLA not loaded, cannot start");
+        return;
+    }
+
+    if (timer_ == nullptr) {
+        timer_ = lv_timer_create([](lv_timer_t* timer) {
+            auto animation = static_cast<LvglRleAnimation*>(lv_timer_get_user_data(timer));
+            animation->NextFrame();
+        }, 10, this);
+    }
+
+    if (timer_ != nullptr) {
+        playing_ = true;
+        last_call_ = lv_tick_get();
+        lv_timer_resume(timer_);
+        lv_timer_reset(timer_);
+    }
+}
+
+void LvglRleAnimation::Pause() {
+    if (timer_ != nullptr) {
+        playing_ = false;
+        lv_timer_pause(timer_);
+    }
+}
+
+void LvglRleAnimation::Resume() {
+    if (!loaded_) {
+        ESP_LOGW(TAG, "RLA not loaded, cannot resume");
+        return;
+    }
+    if (timer_ != nullptr) {
+        playing_ = true;
+        lv_timer_resume(timer_);
+    }
+}
+
+void LvglRleAnimation::Stop() {
+    Pause();
+    loops_played_ = 0;
+    if (loaded_ && frame_index_ != 0) {
+        DecodeFrame(0);
+    }
+}
+
+void LvglRleAnimation::NextFrame() {
+    if (!loaded_ || !playing_) {
+        return;
+    }
+    if (lv_tick_elaps(last_call_) < frames_[frame_index_].delay_ms) {
+        return;
+    }
+    last_call_ = lv_tick_get();
+
+    uint16_t next = frame_index_ + 1;
+    if (next == frames_.size()) {
+        if (loop_count_ != 0 && ++loops_played_ >= loop_count_) {
+            Pause();
+            return;
+        }
+        next = 0;
+    }
+    if (!DecodeFrame(next)) {
+        Pause();
+        return;
+    }
+    if (frame_callback_) {
+        frame_callback_();
+    }
+}
+
+bool LvglRleAnimation::DecodeFrame(uint16_t index) {
+    const FrameInfo& frame = frames_[index];
+    const uint8_t* src = data_ + frame.offset;
+    const uint8_t* end = src + frame.size;
+    size_t pixels = (size_t)width_ * height_;
+    uint16_t* color = (uint16_t*)buffer_;
+    uint8_t* alpha = has_alpha_ ? buffer_ + pixels * 2 : nullptr;
+    size_t alpha_bytes = has_alpha_ ? 1 : 0;
+    size_t pos = 0;
+
+    // 游程覆盖整帧：COPY 为两次 memcpy，FILL 为一次填充，SKIP 保留上一帧像素
+    while (pos < pixels && end - src >= 2) {
+        uint16_t op = ReadU16(src);
+        src += 2;
+        size_t count = (op & 0x3FFF) + 1;
+        if (count > pixels - pos) {
+            break;
+        }
+        switch (op >> 14) {
+        case RLA_OP_COPY:
+            if ((size_t)(end - src) < count * (2 + alpha_bytes)) {
+                ESP_LOGE(TAG, "Frame %u is truncated", index);
+                return false;
+            }
+            memcpy(color + pos, src, count * 2);
+            src += count * 2;
+            if (alpha != nullptr) {
+                memcpy(alpha + pos, src, count);
+                src += count;
+            }
+            break;
+        case RLA_OP_FILL:
+            if ((size_t)(end - src) < 2 + alpha_bytes) {
+                ESP_LOGE(TAG, "Frame %u is truncated", index);
+                return false;
+            }
+            std::fill_n(color + pos, count, ReadU16(src));
+            src += 2;
+            if (alpha != nullptr) {
+                memset(alpha + pos, *src++, count);
+            }
+            break;
+        case RLA_OP_SKIP:
+            break;
+        default:
+            ESP_LOGE(TAG, "Unknown op %u in frame %u", op >> 14, index);
+            return false;
+        }
+        pos += count;
+    }
+
+    if (pos != pixels) {
+        ESP_LOGE(TAG, "Frame %u does not cover the whole image", index);
+        return false;
+    }
+    frame_index_ = index;
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "lvgl_animation.h"
+
+#include <lvgl.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * Player of RLA animations, GIF emojis transcoded at build time by
+ * scripts/spiffs_assets/rla_transcode.py into run-length encoded RGB565 frames.
+ * Frames are expanded straight from the (mmapped) source data into one RGB565 / RGB565A8 buffer.
+ */
+class LvglRleAnimation : public LvglAnimation {
+public:
+    explicit LvglRleAnimation(const lv_img_dsc_t* img_dsc);
+    virtual ~LvglRleAnimation();
+
+    // Check the RLA magic of raw image data
+    static bool IsRleAnimation(const void* data, size_t size);
+
+    virtual const lv_img_dsc_t* image_dsc() const override;
+    virtual void Start() override;
+    virtual void Pause() override;
+    virtual void Resume() override;
+    virtual void Stop() override;
+    virtual bool IsPlaying() const override { return playing_; }
+    virtual bool IsLoaded() const override { return loaded_; }
+    virtual uint16_t width() const override { return width_; }
+    virtual uint16_t height() const override { return height_; }
+    virtual void SetFrameCallback(std::function<void()> callback) override { frame_callback_ = callback; }
+
+private:
+    struct FrameInfo {
+        uint32_t offset;
+        uint32_t size;
+        uint16_t delay_ms;
+        uint8_t type;
+    };
+
+    const uint8_t* data_ = nullptr;
+    std::vector<FrameInfo> frames_;
+    uint16_t width_ = 0;
+    uint16_t height_ = 0;
+    uint16_t loop_count_ = 0;
+    uint16_t loops_played_ = 0;
+    bool has_alpha_ = false;
+
+    uint8_t* buffer_ = nullptr;
+    lv_img_dsc_t img_dsc_;
+    lv_timer_t* timer_ = nullptr;
+    uint32_t last_call_ = 0;
+    uint16_t frame_index_ = 0;
+    bool playing_ = false;
+    bool loaded_ = false;
+    std::function<void()> frame_callback_;
+
+    bool DecodeFrame(uint16_t index);
+    void NextFrame();
+};
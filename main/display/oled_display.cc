@@ -2,6 +2,7 @@
 #include "assets/lang_config.h"
 #include "lvgl_theme.h"
 #include "lvgl_font.h"
+#include "emotion_table.h"
 
 #include <string>
 #include <algorithm>
@@ -373,7 +374,11 @@ void OledDisplay::SetupUI_128x32() {
 }
 
 void OledDisplay::SetEmotion(const char* emotion) {
-    const char* utf8 = font_awesome_get_utf8(emotion);
+    // 只查表不登记，未知名称直接按字符串查找字体图标
+    auto& emotion_table = EmotionTable::GetInstance();
+    EmotionId emotion_id = emotion_table.Find(emotion);
+    const char* utf8 = emotion_id != EmotionTable::kInvalidId ?
+        emotion_table.GetFontAwesomeUtf8(emotion_id) : font_awesome_get_utf8(emotion);
     DisplayLockGuard lock(this);
     if (emotion_label_ == nullptr) {
         return;
@@ -385,6 +390,15 @@ void OledDisplay::SetEmotion(const char* emotion) {
     }
 }
 
+void OledDisplay::SetEmotionId(EmotionId emotion_id) {
+    const char* utf8 = EmotionTable::GetInstance().GetFontAwesomeUtf8(emotion_id);
+    DisplayLockGuard lock(this);
+    if (emotion_label_ == nullptr) {
+        return;
+    }
+    lv_label_set_text(emotion_label_, utf8 != nullptr ? utf8 : FONT_AWESOME_NEUTRAL);
+}
+
 void OledDisplay::SetTheme(Theme* theme) {
     DisplayLockGuard lock(this);
 
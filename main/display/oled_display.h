@@ -34,6 +34,7 @@ public:
 
     virtual void SetChatMessage(const char* role, const char* content) override;
     virtual void SetEmotion(const char* emotion) override;
+    virtual void SetEmotionId(EmotionId emotion_id) override;
     virtual void SetTheme(Theme* theme) override;
 };
 
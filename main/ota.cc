@@ -13,14 +13,25 @@
 #ifdef SOC_HMAC_SUPPORTED
 #include <esp_hmac.h>
 #endif
+#include <esp_timer.h>
+#include <freertos/ringbuf.h>
+#include <freertos/semphr.h>
+#include <mbedtls/sha256.h>
 
 #include <cstring>
 #include <vector>
 #include <sstream>
 #include <algorithm>
+#include <atomic>
 
 #define TAG "Ota"
 
+#define OTA_READ_CHUNK_SIZE 4096
+#define OTA_RING_BUFFER_SIZE (64 * 1024)
+#define OTA_RING_BUFFER_SIZE_INTERNAL (16 * 1024)
+#define OTA_MAX_RESUME_ATTEMPTS 3
+#define OTA_RING_SEND_TIMEOUT_MS 100
+
 
 Ota::Ota() {
 #ifdef ESP_EFUSE_BLOCK_USR_DATA
@@ -218,6 +229,8 @@ esp_err_t Ota::CheckVersion() {
         if (cJSON_IsString(url)) {
             firmware_url_ = url->valuestring;
         }
+        cJSON *sha256 = cJSON_GetObjectItem(firmware, "sha256");
+        firmware_sha256_ = cJSON_IsString(sha256) ? sha256->valuestring : "";
 
         if (cJSON_IsString(version) && cJSON_IsString(url)) {
             // Check if the version is newer, for example, 0.1.0 is newer than 0.0.1
@@ -261,93 +274,264 @@ void Ota::MarkCurrentVersionValid() {
     }
 }
 
-bool Ota::Upgrade(const std::string& firmware_url) {
-    ESP_LOGI(TAG, "Upgrading firmware from %s", firmware_url.c_str());
+namespace {
+
+struct OtaWriter {
+    RingbufHandle_t ring_buffer;
+    const esp_partition_t* partition;
+    size_t content_length;
+    SemaphoreHandle_t done;
+    std::atomic<size_t> written{0};
+    std::atomic<bool> aborted{false};
+    bool success = false;
     esp_ota_handle_t update_handle = 0;
-    auto update_partition = esp_ota_get_next_update_partition(NULL);
-    if (update_partition == NULL) {
-        ESP_LOGE(TAG, "Failed to get update partition");
+    mbedtls_sha256_context sha256;
+    int64_t flash_time_us = 0;
+    int64_t stall_time_us = 0;      // 等待网络数据的时间
+};
+
+bool OtaWriteChunk(OtaWriter* writer, std::string& image_header, const uint8_t* data, size_t size) {
+    // 收到足够的镜像头之后才开始 OTA，先打印新固件版本
+    if (writer->update_handle == 0) {
+        image_header.append((const char*)data, size);
+        if (image_header.size() < sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
+            return true;
+        }
+        esp_app_desc_t new_app_info;
+        memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
+        ESP_LOGI(TAG, "Current version: %s, New version: %s", esp_app_get_description()->version, new_app_info.version);
+
+        if (esp_ota_begin(writer->partition, OTA_WITH_SEQUENTIAL_WRITES, &writer->update_handle)) {
+            esp_ota_abort(writer->update_handle);
+            writer->update_handle = 0;
+            ESP_LOGE(TAG, "Failed to begin OTA");
+            return false;
+        }
+        data = (const uint8_t*)image_header.data();
+        size = image_header.size();
+    }
+
+    auto start_time = esp_timer_get_time();
+    auto err = esp_ota_write(writer->update_handle, data, size);
+    writer->flash_time_us += esp_timer_get_time() - start_time;
+    if (!image_header.empty()) {
+        std::string().swap(image_header);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
         return false;
     }
+    return true;
+}
 
-    ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
-    bool image_header_checked = false;
+void OtaWriterTask(OtaWriter* writer) {
     std::string image_header;
+    mbedtls_sha256_starts(&writer->sha256, 0);
+
+    while (writer->written < writer->content_length && !writer->aborted) {
+        size_t size = 0;
+        auto wait_start = esp_timer_get_time();
+        auto data = (uint8_t*)xRingbufferReceiveUpTo(writer->ring_buffer, &size, pdMS_TO_TICKS(100), OTA_READ_CHUNK_SIZE);
+        writer->stall_time_us += esp_timer_get_time() - wait_start;
+        if (data == nullptr) {
+            continue;
+        }
+
+        mbedtls_sha256_update(&writer->sha256, data, size);
+        bool ok = OtaWriteChunk(writer, image_header, data, size);
+        vRingbufferReturnItem(writer->ring_buffer, data);
+        if (!ok) {
+            writer->aborted = true;
+            break;
+        }
+        writer->written += size;
+    }
+
+    writer->success = !writer->aborted && writer->written == writer->content_length && writer->update_handle != 0;
+    if (!writer->success && writer->update_handle != 0) {
+        esp_ota_abort(writer->update_handle);
+        writer->update_handle = 0;
+    }
+    xSemaphoreGive(writer->done);
+}
+
+}  // namespace
 
+std::unique_ptr<Http> Ota::OpenFirmware(const std::string& firmware_url, size_t offset, size_t& content_length) {
     auto network = Board::GetInstance().GetNetwork();
     auto http = network->CreateHttp(0);
+    if (offset > 0) {
+        http->SetHeader("Range", "bytes=" + std::to_string(offset) + "-");
+    }
     if (!http->Open("GET", firmware_url)) {
         ESP_LOGE(TAG, "Failed to open HTTP connection");
-        return false;
+        return nullptr;
     }
 
-    if (http->GetStatusCode() != 200) {
+    int expected_status = offset > 0 ? 206 : 200;
+    if (http->GetStatusCode() != expected_status) {
         ESP_LOGE(TAG, "Failed to get firmware, status code: %d", http->GetStatusCode());
-        return false;
+        return nullptr;
     }
 
-    size_t content_length = http->GetBodyLength();
+    content_length = http->GetBodyLength();
     if (content_length == 0) {
         ESP_LOGE(TAG, "Failed to get content length");
+        return nullptr;
+    }
+    return http;
+}
+
+bool Ota::Upgrade(const std::string& firmware_url) {
+    ESP_LOGI(TAG, "Upgrading firmware from %s", firmware_url.c_str());
+    auto update_partition = esp_ota_get_next_update_partition(NULL);
+    if (update_partition == NULL) {
+        ESP_LOGE(TAG, "Failed to get update partition");
         return false;
     }
 
-    char buffer[512];
-    size_t total_read = 0, recent_read = 0;
-    auto last_calc_time = esp_timer_get_time();
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
-            return false;
-        }
+    ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
 
-        // Calculate speed and progress every second
-        recent_read += ret;
-        total_read += ret;
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || ret == 0) {
-            size_t progress = total_read * 100 / content_length;
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, total_read, content_length, recent_read);
-            if (upgrade_callback_) {
-                upgrade_callback_(progress, recent_read);
-            }
-            last_calc_time = esp_timer_get_time();
-            recent_read = 0;
+    size_t content_length = 0;
+    auto http = OpenFirmware(firmware_url, 0, content_length);
+    if (!http) {
+        return false;
+    }
+
+    // 下载在当前任务，写 flash 和 SHA-256 在写入任务，通过环形缓冲区连接
+    bool ring_buffer_in_psram = true;
+    auto ring_buffer = xRingbufferCreateWithCaps(OTA_RING_BUFFER_SIZE, RINGBUF_TYPE_BYTEBUF, MALLOC_CAP_SPIRAM);
+    if (ring_buffer == nullptr) {
+        ring_buffer_in_psram = false;
+        ring_buffer = xRingbufferCreate(OTA_RING_BUFFER_SIZE_INTERNAL, RINGBUF_TYPE_BYTEBUF);
+    }
+    auto buffer = (char*)malloc(OTA_READ_CHUNK_SIZE);
+    if (ring_buffer == nullptr || buffer == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate OTA buffers");
+        if (ring_buffer != nullptr) {
+            ring_buffer_in_psram ? vRingbufferDeleteWithCaps(ring_buffer) : vRingbufferDelete(ring_buffer);
         }
+        free(buffer);
+        return false;
+    }
 
-        if (ret == 0) {
-            break;
+    OtaWriter writer;
+    writer.ring_buffer = ring_buffer;
+    writer.partition = update_partition;
+    writer.content_length = content_length;
+    writer.done = xSemaphoreCreateBinary();
+    mbedtls_sha256_init(&writer.sha256);
+    if (writer.done == nullptr || xTaskCreate([](void* arg) {
+        OtaWriterTask((OtaWriter*)arg);
+        vTaskDelete(NULL);
+    }, "ota_writer", 4096, &writer, 4, nullptr) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create OTA writer task");
+        if (writer.done != nullptr) {
+            vSemaphoreDelete(writer.done);
         }
+        mbedtls_sha256_free(&writer.sha256);
+        ring_buffer_in_psram ? vRingbufferDeleteWithCaps(ring_buffer) : vRingbufferDelete(ring_buffer);
+        free(buffer);
+        return false;
+    }
 
-        if (!image_header_checked) {
-            image_header.append(buffer, ret);
-            if (image_header.size() >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
-                esp_app_desc_t new_app_info;
-                memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
-                
-                auto current_version = esp_app_get_description()->version;
-                ESP_LOGI(TAG, "Current version: %s, New version: %s", current_version, new_app_info.version);
-
-                if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
-                    esp_ota_abort(update_handle);
-                    ESP_LOGE(TAG, "Failed to begin OTA");
-                    return false;
+    size_t total_read = 0, last_written = 0;
+    int resume_count = 0;
+    int64_t reader_stall_us = 0;
+    auto start_time = esp_timer_get_time();
+    auto last_calc_time = start_time;
+    while (total_read < content_length && !writer.aborted) {
+        int ret = http->Read(buffer, std::min((size_t)OTA_READ_CHUNK_SIZE, content_length - total_read));
+        if (ret <= 0) {
+            // 网络中断时从已收到的位置续传
+            ESP_LOGW(TAG, "Connection lost at %u/%u: %s", total_read, content_length, esp_err_to_name(ret));
+            http->Close();
+            http.reset();
+            while (!http && resume_count < OTA_MAX_RESUME_ATTEMPTS) {
+                resume_count++;
+                vTaskDelay(pdMS_TO_TICKS(1000 * resume_count));
+                size_t remaining = 0;
+                http = OpenFirmware(firmware_url, total_read, remaining);
+                if (http && remaining != content_length - total_read) {
+                    ESP_LOGE(TAG, "Firmware size changed, cannot resume");
+                    http.reset();
+                    break;
                 }
+            }
+            if (!http) {
+                break;
+            }
+            ESP_LOGI(TAG, "Resumed download from %u (attempt %d)", total_read, resume_count);
+            continue;
+        }
 
-                image_header_checked = true;
-                std::string().swap(image_header);
+        // 写入任务出错后不再取数据，限时发送并检查中止标志，避免阻塞在满的环形缓冲区上
+        auto send_start = esp_timer_get_time();
+        bool sent = false;
+        while (!writer.aborted) {
+            if (xRingbufferSend(ring_buffer, buffer, ret, pdMS_TO_TICKS(OTA_RING_SEND_TIMEOUT_MS)) == pdTRUE) {
+                sent = true;
+                break;
             }
         }
-        auto err = esp_ota_write(update_handle, buffer, ret);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
-            esp_ota_abort(update_handle);
-            return false;
+        reader_stall_us += esp_timer_get_time() - send_start;
+        if (!sent) {
+            break;
+        }
+        total_read += ret;
+
+        // Calculate speed and progress every second
+        auto now = esp_timer_get_time();
+        if (now - last_calc_time >= 1000000 || total_read == content_length) {
+            size_t written = writer.written;
+            size_t progress = written * 100 / content_length;
+            size_t speed = (written - last_written) * 1000000 / std::max<int64_t>(now - last_calc_time, 1);
+            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, written, content_length, speed);
+            if (upgrade_callback_) {
+                upgrade_callback_(progress, speed);
+            }
+            last_calc_time = now;
+            last_written = written;
         }
     }
-    http->Close();
+    if (http) {
+        http->Close();
+    }
+    if (total_read != content_length) {
+        writer.aborted = true;
+    }
+
+    xSemaphoreTake(writer.done, portMAX_DELAY);
+    vSemaphoreDelete(writer.done);
+    ring_buffer_in_psram ? vRingbufferDeleteWithCaps(ring_buffer) : vRingbufferDelete(ring_buffer);
+    free(buffer);
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&writer.sha256, digest);
+    mbedtls_sha256_free(&writer.sha256);
+
+    auto elapsed_us = esp_timer_get_time() - start_time;
+    ESP_LOGI(TAG, "Downloaded %u bytes in %d ms (%d KB/s), flash write %d ms, network stall %d ms, flash stall %d ms, resumed %d times",
+        total_read, int(elapsed_us / 1000), int(total_read * 1000000LL / std::max<int64_t>(elapsed_us, 1) / 1024),
+        int(writer.flash_time_us / 1000), int(writer.stall_time_us / 1000), int(reader_stall_us / 1000), resume_count);
+
+    if (!writer.success) {
+        ESP_LOGE(TAG, "Firmware download failed (%u/%u)", total_read, content_length);
+        return false;
+    }
+
+    char sha256_hex[65];
+    for (int i = 0; i < 32; i++) {
+        snprintf(sha256_hex + i * 2, 3, "%02x", digest[i]);
+    }
+    ESP_LOGI(TAG, "Firmware SHA-256: %s", sha256_hex);
+    if (firmware_url == firmware_url_ && !firmware_sha256_.empty() && strcasecmp(firmware_sha256_.c_str(), sha256_hex) != 0) {
+        ESP_LOGE(TAG, "Firmware SHA-256 mismatch, expected %s", firmware_sha256_.c_str());
+        esp_ota_abort(writer.update_handle);
+        return false;
+    }
 
-    esp_err_t err = esp_ota_end(update_handle);
+    esp_err_t err = esp_ota_end(writer.update_handle);
     if (err != ESP_OK) {
         if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
             ESP_LOGE(TAG, "Image validation failed, image is corrupted");
@@ -7,10 +7,18 @@
 #include <chrono>
 #include <vector>
 
+enum AudioStreamFormat {
+    kAudioStreamFormatOpus,
+    kAudioStreamFormatMp3,
+    kAudioStreamFormatPcm,     // WAV file or raw 16-bit PCM
+};
+
 struct AudioStreamPacket {
     int sample_rate = 0;
     int frame_duration = 0;
     uint32_t timestamp = 0;
+    // Opus packets are decoded one by one, other formats are byte chunks of a stream
+    AudioStreamFormat format = kAudioStreamFormatOpus;
     std::vector<uint8_t> payload;
 };
 
@@ -0,0 +1,249 @@
+import argparse
+import glob
+import json
+import os
+import socket
+import sys
+import time
+import wave
+
+import numpy as np
+
+
+'''
+  唤醒词 / VAD 离线评测与延迟测试
+
+  语料为 16 kHz 单声道 WAV，每个文件旁边放一个同名 JSON 标注（单位：秒）:
+    {"wake_word": [[1.20, 1.85]], "speech": [[1.20, 1.85], [3.00, 5.40]]}
+
+  目标:
+    stub    在主机上运行的能量 VAD 和能量突发"唤醒词"桩，用于验证评测流程和指标计算
+    device  通过 UDP 把语料回放给设备（需要打开 CONFIG_AUDIO_DEBUG_REPLAY），
+            设备上的 ESP-SR 唤醒词 / AFE VAD 把检测事件回报给主机
+'''
+
+SAMPLE_RATE = 16000
+CHUNK_SAMPLES = 512         # 与 AFE 的 feed size 一致
+SILENCE_TAIL_S = 1.5        # 每个文件后追加的静音，给检测结果留出时间
+
+
+def load_corpus(corpus_dir):
+    items = []
+    for wav_path in sorted(glob.glob(os.path.join(corpus_dir, "**", "*.wav"), recursive=True)):
+        label_path = os.path.splitext(wav_path)[0] + ".json"
+        if not os.path.exists(label_path):
+            print(f"Skip {wav_path}: no label file")
+            continue
+        with wave.open(wav_path, "rb") as wav:
+            if wav.getframerate() != SAMPLE_RATE or wav.getsampwidth() != 2 or wav.getnchannels() != 1:
+                print(f"Skip {wav_path}: expected 16 kHz 16 bit mono")
+                continue
+            pcm = np.frombuffer(wav.readframes(wav.getnframes()), dtype=np.int16)
+        with open(label_path, "r", encoding="utf-8") as f:
+            labels = json.load(f)
+        items.append({
+            "name": os.path.relpath(wav_path, corpus_dir),
+            "pcm": np.concatenate([pcm, np.zeros(int(SILENCE_TAIL_S * SAMPLE_RATE), dtype=np.int16)]),
+            "wake_word": labels.get("wake_word", []),
+            "speech": labels.get("speech", []),
+        })
+    return items
+
+
+class StubTarget:
+    '''Energy VAD with hysteresis, a burst of 0.3 ~ 1.2 s of speech counts as a wake word'''
+
+    def __init__(self, threshold_db=-40.0, hangover_ms=300):
+        self.threshold = 32768 * 10 ** (threshold_db / 20)
+        self.hangover_chunks = max(1, hangover_ms * SAMPLE_RATE // 1000 // CHUNK_SAMPLES)
+
+    def run(self, item, mode):
+        events = []
+        feed_us = []
+        speaking = False
+        silent_chunks = 0
+        speech_start = 0
+        pcm = item["pcm"]
+        for position in range(CHUNK_SAMPLES, len(pcm) + 1, CHUNK_SAMPLES):
+            start = time.perf_counter()
+            chunk = pcm[position - CHUNK_SAMPLES:position].astype(np.float32)
+            loud = np.sqrt(np.mean(chunk * chunk)) > self.threshold
+            if loud:
+                silent_chunks = 0
+                if not speaking:
+                    speaking = True
+                    speech_start = position
+                    if mode == "vad":
+                        events.append(("vad", position, "1"))
+            elif speaking:
+                silent_chunks += 1
+                if silent_chunks >= self.hangover_chunks:
+                    speaking = False
+                    if mode == "vad":
+                        events.append(("vad", position, "0"))
+                    duration = (position - silent_chunks * CHUNK_SAMPLES - speech_start) / SAMPLE_RATE
+                    if mode == "wake" and 0.3 <= duration <= 1.2:
+                        events.append(("wake", position, "stub"))
+            feed_us.append((time.perf_counter() - start) * 1e6)
+        return events, feed_us
+
+
+class DeviceTarget:
+    '''Serve the corpus to a device running with CONFIG_AUDIO_DEBUG_REPLAY'''
+
+    def __init__(self, port, realtime):
+        self.socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.socket.bind(("0.0.0.0", port))
+        self.realtime = realtime
+        print(f"Waiting for the device on 0.0.0.0:{port} ...")
+
+    def receive(self):
+        message, address = self.socket.recvfrom(2048)
+        return message.decode("utf-8", errors="replace").split(" "), address
+
+    def run(self, item, mode):
+        events = []
+        feed_us = []
+        pcm = item["pcm"]
+
+        # 等待设备的第一个请求，通知它切换模式并从头开始
+        while True:
+            fields, address = self.receive()
+            if fields[0] == "READ":
+                self.socket.sendto(b"STRT" + (b"VAD" if mode == "vad" else b"WAKE"), address)
+                break
+
+        position = 0
+        start_time = time.monotonic()
+        while position < len(pcm):
+            fields, address = self.receive()
+            if fields[0] == "EVT" and len(fields) >= 4:
+                events.append((fields[1], int(fields[2]), " ".join(fields[3:])))
+                continue
+            if fields[0] != "READ" or len(fields) < 4:
+                continue
+            frames, channels, last_feed_us = int(fields[1]), int(fields[2]), int(fields[3])
+            if position > 0:
+                feed_us.append(last_feed_us)
+            if self.realtime:
+                delay = start_time + position / SAMPLE_RATE - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+            mic = pcm[position:position + frames]
+            if len(mic) < frames:
+                mic = np.concatenate([mic, np.zeros(frames - len(mic), dtype=np.int16)])
+            # 第二声道是回采参考信号，评测时为静音
+            data = np.zeros((frames, channels), dtype=np.int16)
+            data[:, 0] = mic
+            self.socket.sendto(b"PCM " + data.tobytes(), address)
+            position += frames
+        return events, feed_us
+
+
+def percentile(values, p):
+    return float(np.percentile(values, p)) if values else float("nan")
+
+
+def evaluate_wake_word(item, events, tolerance):
+    labels = item["wake_word"]
+    detections = [position / SAMPLE_RATE for name, position, _ in events if name == "wake"]
+    matched = set()
+    latencies = []
+    for start, end in labels:
+        for i, t in enumerate(detections):
+            if i not in matched and start <= t <= end + tolerance:
+                matched.add(i)
+                latencies.append(t - end)
+                break
+    misses = len(labels) - len(latencies)
+    false_accepts = len(detections) - len(matched)
+    return latencies, misses, false_accepts
+
+
+def evaluate_vad(item, events, tolerance):
+    '''End of speech delay: time from the labeled end of speech to the first "vad 0" after it'''
+    ends = [position / SAMPLE_RATE for name, position, value in events if name == "vad" and value == "0"]
+    starts = [position / SAMPLE_RATE for name, position, value in events if name == "vad" and value == "1"]
+    end_delays = []
+    start_delays = []
+    misses = 0
+    for start, end in item["speech"]:
+        onset = [t - start for t in starts if start - tolerance <= t <= end]
+        offset = [t - end for t in ends if end <= t <= end + SILENCE_TAIL_S + tolerance]
+        if not onset:
+            misses += 1
+            continue
+        start_delays.append(min(onset))
+        if offset:
+            end_delays.append(min(offset))
+    return start_delays, end_delays, misses
+
+
+def main():
+    parser = argparse.ArgumentParser(description="唤醒词 / VAD 离线评测与延迟测试")
+    parser.add_argument("corpus", help="标注语料目录（WAV + JSON）")
+    parser.add_argument("--target", choices=["stub", "device"], default="stub", help="评测对象")
+    parser.add_argument("--mode", choices=["wake", "vad"], default="wake", help="评测唤醒词或 VAD")
+    parser.add_argument("--port", type=int, default=8000, help="device 模式的 UDP 端口，与 AUDIO_DEBUG_UDP_SERVER 一致")
+    parser.add_argument("--fast", action="store_true", help="device 模式下不按实时速度回放")
+    parser.add_argument("--tolerance", type=float, default=1.0, help="检测结果允许晚于标注结束的秒数")
+    parser.add_argument("--report", help="把逐文件结果写入 JSON 文件")
+    args = parser.parse_args()
+
+    items = load_corpus(args.corpus)
+    if not items:
+        print("No labeled audio found")
+        sys.exit(1)
+
+    target = StubTarget() if args.target == "stub" else DeviceTarget(args.port, not args.fast)
+
+    total_hours = 0.0
+    latencies, start_delays, end_delays, feed_us = [], [], [], []
+    misses = false_accepts = labeled = 0
+    report = []
+    for item in items:
+        events, item_feed_us = target.run(item, args.mode)
+        feed_us.extend(item_feed_us)
+        total_hours += len(item["pcm"]) / SAMPLE_RATE / 3600
+        if args.mode == "wake":
+            item_latencies, item_misses, item_false_accepts = evaluate_wake_word(item, events, args.tolerance)
+            latencies.extend(item_latencies)
+            misses += item_misses
+            false_accepts += item_false_accepts
+            labeled += len(item["wake_word"])
+            print(f"{item['name']}: {len(item_latencies)}/{len(item['wake_word'])} detected, "
+                  f"{item_false_accepts} false accepts")
+        else:
+            item_starts, item_ends, item_misses = evaluate_vad(item, events, args.tolerance)
+            start_delays.extend(item_starts)
+            end_delays.extend(item_ends)
+            misses += item_misses
+            labeled += len(item["speech"])
+            print(f"{item['name']}: {len(item['speech']) - item_misses}/{len(item['speech'])} segments detected")
+        report.append({"name": item["name"], "events": events})
+
+    print()
+    print(f"Target: {args.target}, files: {len(items)}, audio: {total_hours * 60:.1f} min")
+    if args.mode == "wake":
+        print(f"Wake words: {labeled}, misses: {misses} ({misses / max(labeled, 1) * 100:.1f}%)")
+        print(f"False accepts: {false_accepts} ({false_accepts / max(total_hours, 1e-9):.2f} / hour)")
+        print(f"Detection latency after word end: mean {np.mean(latencies) * 1000 if latencies else float('nan'):.0f} ms, "
+              f"p50 {percentile(latencies, 50) * 1000:.0f} ms, p90 {percentile(latencies, 90) * 1000:.0f} ms")
+    else:
+        print(f"Speech segments: {labeled}, misses: {misses}")
+        print(f"Speech start delay: p50 {percentile(start_delays, 50) * 1000:.0f} ms, "
+              f"p90 {percentile(start_delays, 90) * 1000:.0f} ms")
+        print(f"End of speech delay: mean {np.mean(end_delays) * 1000 if end_delays else float('nan'):.0f} ms, "
+              f"p50 {percentile(end_delays, 50) * 1000:.0f} ms, p90 {percentile(end_delays, 90) * 1000:.0f} ms")
+    print(f"Processing per chunk: mean {np.mean(feed_us) if feed_us else float('nan'):.0f} us, "
+          f"p90 {percentile(feed_us, 90):.0f} us, max {max(feed_us) if feed_us else float('nan'):.0f} us")
+    if args.target == "device" and args.fast:
+        print("Note: accelerated replay, latency includes queueing on the device")
+
+    if args.report:
+        with open(args.report, "w", encoding="utf-8") as f:
+            json.dump(report, f, ensure_ascii=False, indent=2)
+
+
+if __name__ == "__main__":
+    main()
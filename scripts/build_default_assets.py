@@ -19,6 +19,10 @@ import json
 import struct
 from datetime import datetime
 
+sys.dont_write_bytecode = True
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), 'spiffs_assets'))
+from assets_image import compute_checksum, sort_key, find_long_asset_names, build_assets_image_v2
+
 
 # =============================================================================
 # Pack model functions (from pack_model.py)
@@ -311,6 +315,7 @@ def generate_config_json(build_dir, assets_dir):
         "assets_size": "0x400000",
         "support_format": ".png, .gif, .jpg, .bin, .json",
         "name_length": "32",
+        "format_version": 2,
         "split_height": "0",
         "support_qoi": False,
         "support_spng": False,
@@ -334,17 +339,7 @@ def generate_config_json(build_dir, assets_dir):
 # Simplified SPIFFS assets generation (from spiffs_assets_gen.py)
 # =============================================================================
 
-def compute_checksum(data):
-    checksum = sum(data) & 0xFFFF
-    return checksum
-
-
-def sort_key(filename):
-    basename, extension = os.path.splitext(filename)
-    return extension, basename
-
-
-def pack_assets_simple(target_path, include_path, out_file, assets_path, max_name_len=32):
+def pack_assets_simple(target_path, include_path, out_file, assets_path, max_name_len=32, format_version=2):
     """
     Simplified version of pack_assets that handles basic file packing
     """
@@ -379,22 +374,34 @@ def pack_assets_simple(target_path, include_path, out_file, assets_path, max_nam
 
     total_files = len(file_info_list)
 
-    mmap_table = bytearray()
-    for file_name, offset, file_size, width, height in file_info_list:
-        if len(file_name) > max_name_len:
-            print(f'Warning: "{file_name}" exceeds {max_name_len} bytes and will be truncated.')
-        fixed_name = file_name.ljust(max_name_len, '\0')[:max_name_len]
-        mmap_table.extend(fixed_name.encode('utf-8'))
-        mmap_table.extend(file_size.to_bytes(4, byteorder='little'))
-        mmap_table.extend(offset.to_bytes(4, byteorder='little'))
-        mmap_table.extend(width.to_bytes(2, byteorder='little'))
-        mmap_table.extend(height.to_bytes(2, byteorder='little'))
-
-    combined_data = mmap_table + merged_data
-    combined_checksum = compute_checksum(combined_data)
-    combined_data_length = len(combined_data).to_bytes(4, byteorder='little')
-    header_data = total_files.to_bytes(4, byteorder='little') + combined_checksum.to_bytes(4, byteorder='little')
-    final_data = header_data + combined_data_length + combined_data
+    if format_version >= 2:
+        long_names = find_long_asset_names(file_info_list, max_name_len)
+        for file_name in long_names:
+            print(f'Error: "{file_name}" exceeds {max_name_len} bytes, rename it.')
+        if long_names:
+            sys.exit(1)
+    else:
+        for file_name, _, _, _, _ in file_info_list:
+            if len(file_name) > max_name_len:
+                print(f'Warning: "{file_name}" exceeds {max_name_len} bytes and will be truncated.')
+
+    if format_version >= 2:
+        final_data, combined_checksum = build_assets_image_v2(file_info_list, merged_data, max_name_len)
+    else:
+        mmap_table = bytearray()
+        for file_name, offset, file_size, width, height in file_info_list:
+            fixed_name = file_name.ljust(max_name_len, '\0')[:max_name_len]
+            mmap_table.extend(fixed_name.encode('utf-8'))
+            mmap_table.extend(file_size.to_bytes(4, byteorder='little'))
+            mmap_table.extend(offset.to_bytes(4, byteorder='little'))
+            mmap_table.extend(width.to_bytes(2, byteorder='little'))
+            mmap_table.extend(height.to_bytes(2, byteorder='little'))
+
+        combined_data = mmap_table + merged_data
+        combined_checksum = compute_checksum(combined_data)
+        combined_data_length = len(combined_data).to_bytes(4, byteorder='little')
+        header_data = total_files.to_bytes(4, byteorder='little') + combined_checksum.to_bytes(4, byteorder='little')
+        final_data = header_data + combined_data_length + combined_data
 
     with open(out_file, 'wb') as output_bin:
         output_bin.write(final_data)
@@ -734,7 +741,8 @@ def build_assets_integrated(wakenet_model_paths, multinet_model_paths, text_font
         # Use simplified packing function
         include_path = config_data['include_path']
         image_file = config_data['image_file']
-        pack_assets_simple(assets_dir, include_path, image_file, "assets", int(config_data['name_length']))
+        pack_assets_simple(assets_dir, include_path, image_file, "assets", int(config_data['name_length']),
+                           int(config_data.get('format_version', 2)))
         
         # Copy final assets.bin to output location
         if os.path.exists(image_file):
@@ -0,0 +1,63 @@
+# SPDX-FileCopyrightText: 2024-2025 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Apache-2.0
+"""
+On-disk format of the mmap assets image, shared by spiffs_assets_gen.py and
+build_default_assets.py so both writers produce the same layout as assets.cc.
+"""
+import os
+import struct
+import zlib
+
+MMAP_ASSETS_V2_MAGIC = 0x3253415A  # "ZAS2"
+
+
+def compute_checksum(data):
+    checksum = sum(data) & 0xFFFF
+    return checksum
+
+
+def sort_key(filename):
+    basename, extension = os.path.splitext(filename)
+    return extension, basename
+
+
+def hash_asset_name(name_bytes):
+    """FNV-1a 32-bit hash of the asset name, must match HashAssetName() in assets.cc"""
+    hash_value = 0x811C9DC5
+    for byte in name_bytes.rstrip(b'\0'):
+        hash_value ^= byte
+        hash_value = (hash_value * 0x01000193) & 0xFFFFFFFF
+    return hash_value
+
+
+def find_long_asset_names(file_info_list, max_name_len):
+    """
+    Names longer than the directory field (in UTF-8 bytes). The v2 directory and the
+    delta manifest must agree on every name, so v2 images reject these instead of truncating.
+    """
+    return [file_name for file_name, _, _, _, _ in file_info_list if len(file_name.encode('utf-8')) > max_name_len]
+
+
+def build_assets_image_v2(file_info_list, merged_data, max_name_len):
+    """
+    Build the v2 assets image: header + directory sorted by name hash + data.
+    Each entry carries the CRC32 of its payload so the device only verifies the
+    directory at boot and checks every asset lazily on first access.
+    Returns (final_data, directory_crc32).
+    """
+    entries = []
+    for file_name, offset, file_size, width, height in file_info_list:
+        fixed_name = file_name.encode('utf-8').ljust(max_name_len, b'\0')[:max_name_len]
+        payload = merged_data[offset + 2:offset + 2 + file_size]
+        entries.append((hash_asset_name(fixed_name), fixed_name, file_size, offset, width, height, zlib.crc32(payload)))
+    entries.sort(key=lambda entry: (entry[0], entry[1]))
+
+    directory = bytearray()
+    for name_hash, fixed_name, file_size, offset, width, height, crc in entries:
+        directory.extend(fixed_name)
+        directory.extend(struct.pack('<IIHHII', file_size, offset, width, height, crc, name_hash))
+
+    directory_crc32 = zlib.crc32(directory)
+    data_offset = 24 + len(directory)
+    header = struct.pack('<IIIIII', MMAP_ASSETS_V2_MAGIC, 2, len(entries), directory_crc32, data_offset, len(merged_data))
+    return header + directory + merged_data, directory_crc32
@@ -7,6 +7,10 @@ Usage:
         --text_font <text_font_file> \
         --emoji_collection <emoji_collection_dir>
 
+    The text font can also be generated as a subset of a TTF font from the locales
+    strings and a corpus, see font_subset.py:
+        --subset_font_ttf <ttf_file> --subset_font_size 20 [--corpus <text_file> ...]
+
 Example:
     ./build.py --wakenet_model ../../managed_components/espressif__esp-sr/model/wakenet_model/wn9_nihaoxiaozhi_tts \
         --text_font ../../components/xiaozhi-fonts/build/font_puhui_common_20_4.bin \
@@ -86,7 +90,23 @@ def process_text_font(text_font_file, assets_dir):
     return font_filename
 
 
-def process_emoji_collection(emoji_collection_dir, assets_dir):
+def process_subset_font(args, assets_dir):
+    """Generate the subset text font, returns (font_filename, fallback_letter)"""
+    from font_subset import generate_subset_font, compare_fonts
+
+    font_filename = f"font_subset_{args.subset_font_size}_{args.subset_font_bpp}.bin"
+    font_dst = os.path.join(assets_dir, font_filename)
+    locales_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "main", "assets", "locales")
+    fallback = generate_subset_font(args.subset_font_ttf, args.subset_font_size, args.subset_font_bpp, font_dst,
+                                    locales_dir, args.lang, args.corpus, args.font_conv)
+    if fallback is None:
+        sys.exit(1)
+    # 同时给出 --text_font 时作为完整字体对比占用
+    compare_fonts(font_dst, args.text_font)
+    return font_filename, fallback
+
+
+def process_emoji_collection(emoji_collection_dir, assets_dir, transcode_gif=False):
     """Process emoji_collection parameter"""
     if not emoji_collection_dir:
         return []
@@ -97,10 +117,18 @@ def process_emoji_collection(emoji_collection_dir, assets_dir):
     for root, dirs, files in os.walk(emoji_collection_dir):
         for file in files:
             if file.lower().endswith(('.png', '.gif')):
-                # Copy file
                 src_file = os.path.join(root, file)
-                dst_file = os.path.join(assets_dir, file)
-                copy_file(src_file, dst_file)
+                if transcode_gif and file.lower().endswith('.gif'):
+                    # 预先转成 RLE 编码的 RGB565 帧，设备端无需 LZW 解码
+                    from rla_transcode import transcode_gif as transcode
+                    rla_file = os.path.splitext(file)[0] + ".rla"
+                    if transcode(src_file, os.path.join(assets_dir, rla_file)):
+                        file = rla_file
+                    else:
+                        copy_file(src_file, os.path.join(assets_dir, file))
+                else:
+                    # Copy file
+                    copy_file(src_file, os.path.join(assets_dir, file))
                 
                 # Get filename without extension
                 filename_without_ext = os.path.splitext(file)[0]
@@ -276,7 +304,8 @@ def process_board_collection(target_board_dir, res_path, assets_dir):
     
     return emoji_collection, icon_collection, layout_json
 
-def generate_index_json(assets_dir, srmodels, text_font, emoji_collection, icon_collection, layout_json):
+def generate_index_json(assets_dir, srmodels, text_font, emoji_collection, icon_collection, layout_json,
+                        text_font_fallback=None):
     """Generate index.json file"""
     index_data = {
         "version": 1
@@ -287,6 +316,8 @@ def generate_index_json(assets_dir, srmodels, text_font, emoji_collection, icon_
     
     if text_font:
         index_data["text_font"] = text_font
+        if text_font_fallback:
+            index_data["text_font_fallback"] = text_font_fallback
     
     if emoji_collection:
         index_data["emoji_collection"] = emoji_collection
@@ -305,7 +336,7 @@ def generate_index_json(assets_dir, srmodels, text_font, emoji_collection, icon_
     print(f"Generated: {index_path}")
 
 
-def generate_config_json(build_dir, assets_dir):
+def generate_config_json(build_dir, assets_dir, format_version=2):
     """Generate config.json file"""
     # Get absolute path of current working directory
     workspace_dir = os.path.abspath(os.path.join(os.path.dirname(__file__)))
@@ -316,8 +347,9 @@ def generate_config_json(build_dir, assets_dir):
         "image_file": os.path.join(workspace_dir, "build/output/assets.bin"),
         "lvgl_ver": "9.3.0",
         "assets_size": "0x400000",
-        "support_format": ".png, .gif, .jpg, .bin, .json, .eaf",
+        "support_format": ".png, .gif, .jpg, .bin, .json, .eaf, .rla",
         "name_length": "32",
+        "format_version": format_version,
         "split_height": "0",
         "support_qoi": False,
         "support_spng": False,
@@ -342,9 +374,19 @@ def main():
     parser.add_argument('--wakenet_model', help='Path to wakenet model directory')
     parser.add_argument('--text_font', help='Path to text font file')
     parser.add_argument('--emoji_collection', help='Path to emoji collection directory')
+    parser.add_argument('--subset_font_ttf', help='Generate the text font as a subset of this TTF font')
+    parser.add_argument('--subset_font_size', type=int, default=20, help='Subset font size in pixels')
+    parser.add_argument('--subset_font_bpp', type=int, choices=[1, 2, 4, 8], default=4, help='Subset font bits per pixel')
+    parser.add_argument('--lang', nargs='*', help='Languages whose strings go into the subset font (default: all)')
+    parser.add_argument('--corpus', nargs='*', help='Text files with typical replies for the subset font')
+    parser.add_argument('--font_conv', default='lv_font_conv', help='lv_font_conv command that writes cbin fonts')
 
     parser.add_argument('--res_path', help='Path to res directory')
     parser.add_argument('--target_board', help='Path to target board directory')
+    parser.add_argument('--format_version', type=int, choices=[1, 2], default=2,
+                        help='Assets partition format, 2 = indexed directory with per-asset CRC32 (default)')
+    parser.add_argument('--transcode_gif', action='store_true',
+                        help='Transcode GIF emojis to RLE RGB565 animations (.rla), requires Pillow')
     
     args = parser.parse_args()
     
@@ -365,20 +407,25 @@ def main():
     
     # Process each parameter
     srmodels = process_wakenet_model(args.wakenet_model, build_dir, assets_dir)
-    text_font = process_text_font(args.text_font, assets_dir)
+    text_font_fallback = None
+    if args.subset_font_ttf:
+        text_font, text_font_fallback = process_subset_font(args, assets_dir)
+    else:
+        text_font = process_text_font(args.text_font, assets_dir)
 
     if(args.target_board):
         emoji_collection, icon_collection, layout_json = process_board_collection(args.target_board, args.res_path, assets_dir)
     else:
-        emoji_collection = process_emoji_collection(args.emoji_collection, assets_dir)
+        emoji_collection = process_emoji_collection(args.emoji_collection, assets_dir, args.transcode_gif)
         icon_collection = []
         layout_json = []
     
     # Generate index.json
-    generate_index_json(assets_dir, srmodels, text_font, emoji_collection, icon_collection, layout_json)
+    generate_index_json(assets_dir, srmodels, text_font, emoji_collection, icon_collection, layout_json,
+                        text_font_fallback)
     
     # Generate config.json
-    config_path = generate_config_json(build_dir, assets_dir)
+    config_path = generate_config_json(build_dir, assets_dir, args.format_version)
     
     # Use spiffs_assets_gen.py to package final build/assets.bin
     try:
@@ -393,6 +440,10 @@ def main():
     
     # Copy build/output/assets.bin to build/assets.bin
     shutil.copy(os.path.join(build_dir, "output", "assets.bin"), os.path.join(build_dir, "assets.bin"))
+    manifest_file = os.path.join(build_dir, "output", "assets.bin.manifest.json")
+    if os.path.exists(manifest_file):
+        # 与 assets.bin 一起发布，设备据此只下载有变化的资源
+        shutil.copy(manifest_file, os.path.join(build_dir, "assets.bin.manifest.json"))
     print("Build completed!")
 
 
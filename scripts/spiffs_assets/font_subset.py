@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+"""
+Generate a subset text font for the assets partition
+
+The character set is collected from the UI strings in main/assets/locales
+(the same language.json files gen_lang.py turns into lang_config.h), ASCII,
+common CJK punctuation and an optional corpus of typical assistant replies.
+Only those glyphs are converted, plus a fallback glyph that the device draws
+for any letter missing from the subset.
+
+Usage:
+    ./font_subset.py --ttf <font.ttf> --size 20 --bpp 4 \
+        [--lang zh-CN en-US] [--corpus replies.txt ...] [--compare <full_font.bin>] \
+        -o <output.bin>
+
+Example:
+    ./font_subset.py --ttf ../../components/xiaozhi-fonts/ttf/AlibabaPuHuiTi-3-55-Regular.ttf \
+        --size 20 --bpp 4 --lang zh-CN --corpus corpus.txt \
+        --compare ../../components/xiaozhi-fonts/cbin/font_puhui_common_20_4.bin \
+        -o build/font_subset_20_4.bin
+
+The font is converted with lv_font_conv, the command given by --font_conv
+must be able to write the cbin format used by xiaozhi-fonts.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import time
+
+# 替代字形候选：优先使用标准替换字符，其次是空心方框，最后退回问号
+FALLBACK_CANDIDATES = [0xFFFD, 0x25A1, ord('?')]
+
+BASE_SYMBOLS = (
+    ''.join(chr(c) for c in range(0x20, 0x7F)) +
+    '，。！？、；：“”‘’（）《》【】「」『』…—～·￥％＋－×÷°℃'
+)
+
+
+def _collect_strings(node, out):
+    if isinstance(node, str):
+        out.append(node)
+    elif isinstance(node, dict):
+        for value in node.values():
+            _collect_strings(value, out)
+    elif isinstance(node, list):
+        for value in node:
+            _collect_strings(value, out)
+
+
+def load_locale_text(locales_dir, languages=None):
+    """Return the UI strings of the given languages (all locales when None)"""
+    if not os.path.isdir(locales_dir):
+        print(f"Warning: Locales directory not found: {locales_dir}")
+        return ''
+    if not languages:
+        languages = sorted(os.listdir(locales_dir))
+    strings = []
+    for lang in languages:
+        path = os.path.join(locales_dir, lang, 'language.json')
+        if not os.path.exists(path):
+            print(f"Warning: Language file not found: {path}")
+            continue
+        with open(path, 'r', encoding='utf-8') as f:
+            _collect_strings(json.load(f).get('strings', {}), strings)
+    return ''.join(strings)
+
+
+def load_corpus_text(corpus_files):
+    text = []
+    for path in corpus_files or []:
+        with open(path, 'r', encoding='utf-8', errors='ignore') as f:
+            text.append(f.read())
+    return ''.join(text)
+
+
+def load_font_cmap(ttf_file):
+    """Return the set of code points in the font, None if fontTools is not installed"""
+    try:
+        from fontTools.ttLib import TTFont
+    except ImportError:
+        print("Warning: fontTools is not installed, glyph coverage is not checked")
+        return None
+    with TTFont(ttf_file, lazy=True) as font:
+        return set(font.getBestCmap().keys())
+
+
+def collect_code_points(locales_dir, languages, corpus_files, cmap):
+    """Collect the code points to keep, returns (code_points, per source counts, missing count)"""
+    sources = [
+        ('base', BASE_SYMBOLS),
+        ('locales', load_locale_text(locales_dir, languages)),
+        ('corpus', load_corpus_text(corpus_files)),
+    ]
+    code_points = set()
+    counts = {}
+    missing = set()
+    for name, text in sources:
+        letters = {ord(ch) for ch in text if ch == ' ' or (ord(ch) >= 0x20 and not ch.isspace())}
+        if cmap is not None:
+            missing |= letters - cmap
+            letters &= cmap
+        counts[name] = len(letters - code_points)
+        code_points |= letters
+    return code_points, counts, len(missing)
+
+
+def choose_fallback(cmap):
+    for letter in FALLBACK_CANDIDATES:
+        if cmap is None or letter in cmap:
+            return letter
+    return ord('?')
+
+
+def to_ranges(code_points):
+    """Compress code points into lv_font_conv --range syntax"""
+    ranges = []
+    start = prev = None
+    for letter in sorted(code_points):
+        if prev is not None and letter == prev + 1:
+            prev = letter
+            continue
+        if start is not None:
+            ranges.append(f"0x{start:X}" if start == prev else f"0x{start:X}-0x{prev:X}")
+        start = prev = letter
+    if start is not None:
+        ranges.append(f"0x{start:X}" if start == prev else f"0x{start:X}-0x{prev:X}")
+    return ','.join(ranges)
+
+
+def generate_subset_font(ttf_file, size, bpp, output_file, locales_dir, languages=None,
+                         corpus_files=None, font_conv='lv_font_conv', font_format='cbin'):
+    """Convert the subset font, returns the fallback code point or None on failure"""
+    cmap = load_font_cmap(ttf_file)
+    code_points, counts, missing = collect_code_points(locales_dir, languages, corpus_files, cmap)
+    fallback = choose_fallback(cmap)
+    code_points.add(fallback)
+
+    command = font_conv.split() + [
+        '--font', ttf_file, '--size', str(size), '--bpp', str(bpp),
+        '--format', font_format, '--no-compress',
+        '--range', to_ranges(code_points), '-o', output_file,
+    ]
+    start_time = time.time()
+    try:
+        subprocess.run(command, check=True)
+    except (OSError, subprocess.CalledProcessError) as e:
+        print(f"Error: Failed to convert subset font: {e}")
+        return None
+
+    print(f"Generated: {output_file}, {len(code_points)} glyphs "
+          f"(base {counts['base']}, locales {counts['locales']}, corpus {counts['corpus']}), "
+          f"fallback U+{fallback:04X}, {missing} letters not in the font, "
+          f"{os.path.getsize(output_file)} bytes in {time.time() - start_time:.1f}s")
+    return fallback
+
+
+def compare_fonts(subset_file, full_file):
+    """Print the flash footprint of the subset font against the full font"""
+    if not full_file or not os.path.exists(full_file):
+        return
+    subset_size = os.path.getsize(subset_file)
+    full_size = os.path.getsize(full_file)
+    print(f"Flash footprint: subset {subset_size / 1024:.1f} KB, full {full_size / 1024:.1f} KB "
+          f"({subset_size * 100 // max(full_size, 1)}%), saves {(full_size - subset_size) / 1024:.1f} KB")
+
+
+def main():
+    script_dir = os.path.dirname(os.path.abspath(__file__))
+    default_locales = os.path.join(script_dir, '..', '..', 'main', 'assets', 'locales')
+
+    parser = argparse.ArgumentParser(description='Generate a subset text font for the assets partition')
+    parser.add_argument('--ttf', required=True, help='Source TTF/OTF font')
+    parser.add_argument('--size', type=int, required=True, help='Font size in pixels')
+    parser.add_argument('--bpp', type=int, choices=[1, 2, 4, 8], default=4, help='Bits per pixel')
+    parser.add_argument('--locales', default=default_locales, help='Path to main/assets/locales')
+    parser.add_argument('--lang', nargs='*', help='Languages to include, e.g. zh-CN en-US (default: all)')
+    parser.add_argument('--corpus', nargs='*', help='UTF-8 text files with typical replies')
+    parser.add_argument('--font_conv', default='lv_font_conv', help='lv_font_conv command')
+    parser.add_argument('--format', default='cbin', help='lv_font_conv output format')
+    parser.add_argument('--compare', help='Full font file to compare the flash footprint with')
+    parser.add_argument('-o', '--output', required=True, help='Output font file')
+    args = parser.parse_args()
+
+    fallback = generate_subset_font(args.ttf, args.size, args.bpp, args.output, args.locales, args.lang,
+                                    args.corpus, args.font_conv, args.format)
+    if fallback is None:
+        sys.exit(1)
+    compare_fonts(args.output, args.compare)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+"""
+Transcode animated GIF emojis to the RLA (RLE animation) format
+
+The device plays RLA files by expanding run-length encoded RGB565 frames
+straight from the mmapped assets partition, no LZW decoding or palette
+lookup is needed.
+
+Usage:
+    ./rla_transcode.py <input.gif> <output.rla>
+
+File layout (little endian):
+    header (16 bytes):
+        u32 magic 'RLA1'
+        u16 width, u16 height
+        u16 frame_count
+        u16 flags           bit0: frames carry an A8 alpha plane (RGB565A8)
+        u16 loop_count      0 = loop forever
+        u16 reserved
+    frame table (frame_count * 12 bytes):
+        u32 offset          from the start of the file
+        u32 size
+        u16 delay_ms
+        u8  type            0 = key frame, 1 = delta from the previous frame
+        u8  reserved
+    frame data: a sequence of u16 ops, type in the top 2 bits,
+    pixel count - 1 in the low 14 bits:
+        0 COPY  count * u16 RGB565, then count * u8 alpha if bit0 of flags
+        1 FILL  one u16 RGB565, then one u8 alpha if bit0 of flags
+        2 SKIP  keep count pixels of the previous frame (delta frames only)
+"""
+
+import struct
+import sys
+
+RLA_MAGIC = 0x31414C52  # 'RLA1'
+RLA_FLAG_ALPHA = 0x01
+RLA_FRAME_KEY = 0
+RLA_FRAME_DELTA = 1
+
+OP_COPY = 0
+OP_FILL = 1
+OP_SKIP = 2
+MAX_RUN = 1 << 14
+# 短于该长度的相同像素不单独编码为 FILL，避免打断 COPY 带来的额外开销
+MIN_FILL_RUN = 3
+
+
+def _to_pixels(frame):
+    """Convert an RGBA frame to a list of (rgb565, alpha) tuples"""
+    pixels = []
+    for r, g, b, a in frame.getdata():
+        if a < 128:
+            # 透明像素统一为 0，便于合并成长串
+            pixels.append((0, 0))
+        else:
+            pixels.append((((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3), 0xFF))
+    return pixels
+
+
+def _emit(out, op, count):
+    out += struct.pack('<H', (op << 14) | (count - 1))
+
+
+def _encode_copy(out, pixels, has_alpha):
+    for start in range(0, len(pixels), MAX_RUN):
+        chunk = pixels[start:start + MAX_RUN]
+        _emit(out, OP_COPY, len(chunk))
+        out += b''.join(struct.pack('<H', color) for color, _ in chunk)
+        if has_alpha:
+            out += bytes(alpha for _, alpha in chunk)
+
+
+def _encode_frame(pixels, previous, has_alpha):
+    """Encode one frame, pixels equal to `previous` are skipped when it is given"""
+    out = bytearray()
+    literal = []
+    i = 0
+    n = len(pixels)
+    while i < n:
+        if previous is not None and pixels[i] == previous[i]:
+            j = i
+            while j < n and j - i < MAX_RUN and pixels[j] == previous[j]:
+                j += 1
+            if literal:
+                _encode_copy(out, literal, has_alpha)
+                literal = []
+            _emit(out, OP_SKIP, j - i)
+            i = j
+            continue
+
+        j = i
+        while j < n and j - i < MAX_RUN and pixels[j] == pixels[i]:
+            j += 1
+        if j - i >= MIN_FILL_RUN:
+            if literal:
+                _encode_copy(out, literal, has_alpha)
+                literal = []
+            color, alpha = pixels[i]
+            _emit(out, OP_FILL, j - i)
+            out += struct.pack('<H', color)
+            if has_alpha:
+                out.append(alpha)
+            i = j
+        else:
+            literal.append(pixels[i])
+            i += 1
+    if literal:
+        _encode_copy(out, literal, has_alpha)
+    return bytes(out)
+
+
+def transcode_gif(input_file, output_file):
+    """Transcode a GIF file to RLA, returns False if the input is not an animated GIF"""
+    from PIL import Image, ImageSequence
+
+    with Image.open(input_file) as im:
+        if im.format != 'GIF':
+            return False
+        width, height = im.size
+        loop_count = im.info.get('loop', 1)
+        frames = []
+        for frame in ImageSequence.Iterator(im):
+            # Pillow 会按 disposal 合成完整画面
+            frames.append((_to_pixels(frame.convert('RGBA')), max(frame.info.get('duration', 100), 10)))
+
+    if not frames:
+        return False
+    has_alpha = any(alpha != 0xFF for pixels, _ in frames for _, alpha in pixels)
+    flags = RLA_FLAG_ALPHA if has_alpha else 0
+
+    encoded = []
+    previous = None
+    for pixels, delay in frames:
+        key = _encode_frame(pixels, None, has_alpha)
+        frame_type, data = RLA_FRAME_KEY, key
+        if previous is not None:
+            delta = _encode_frame(pixels, previous, has_alpha)
+            if len(delta) < len(key):
+                frame_type, data = RLA_FRAME_DELTA, delta
+        encoded.append((frame_type, min(delay, 0xFFFF), data))
+        previous = pixels
+
+    header = struct.pack('<IHHHHHH', RLA_MAGIC, width, height, len(encoded), flags, loop_count, 0)
+    offset = len(header) + 12 * len(encoded)
+    table = bytearray()
+    for frame_type, delay, data in encoded:
+        table += struct.pack('<IIHBB', offset, len(data), delay, frame_type, 0)
+        offset += len(data)
+
+    with open(output_file, 'wb') as f:
+        f.write(header)
+        f.write(table)
+        for _, _, data in encoded:
+            f.write(data)
+
+    raw_size = width * height * (3 if has_alpha else 2) * len(encoded)
+    print(f"Transcoded: {input_file} -> {output_file}, {width}x{height}, {len(encoded)} frames, "
+          f"{offset} bytes ({offset * 100 // max(raw_size, 1)}% of raw)")
+    return True
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        print(__doc__)
+        sys.exit(1)
+    if not transcode_gif(sys.argv[1], sys.argv[2]):
+        print(f"Error: {sys.argv[1]} is not a GIF file")
+        sys.exit(1)
@@ -12,6 +12,8 @@ import numpy as np
 import importlib
 import subprocess
 import urllib.request
+import struct
+import zlib
 
 from PIL import Image
 from datetime import datetime
@@ -22,6 +24,8 @@ from packaging import version
 
 sys.dont_write_bytecode = True
 
+from assets_image import compute_checksum, sort_key, find_long_asset_names, build_assets_image_v2
+
 GREEN = '\033[1;32m'
 RED = '\033[1;31m'
 RESET = '\033[0m'
@@ -45,6 +49,7 @@ class PackModelsConfig:
     image_file: str
     assets_path: str
     name_length: int
+    format_version: int = 2
 
 def generate_header_filename(path):
     asset_name = os.path.basename(path)
@@ -52,13 +57,32 @@ def generate_header_filename(path):
     header_filename = f'mmap_generate_{asset_name}.h'
     return header_filename
 
-def compute_checksum(data):
-    checksum = sum(data) & 0xFFFF
-    return checksum
 
-def sort_key(filename):
-    basename, extension = os.path.splitext(filename)
-    return extension, basename
+def write_assets_manifest(out_file, file_info_list, merged_data, final_data):
+    """
+    Write <image>.manifest.json next to a v2 image. The device compares it with the
+    directory of its current image and only fetches (HTTP Range) the assets that changed.
+    """
+    data_offset = len(final_data) - len(merged_data)
+    assets = []
+    for file_name, offset, file_size, _, _ in file_info_list:
+        assets.append({
+            'name': file_name,
+            'offset': offset,
+            'size': file_size,
+            'crc32': zlib.crc32(merged_data[offset + 2:offset + 2 + file_size]),
+        })
+    manifest = {
+        'version': 2,
+        'image_size': len(final_data),
+        'data_offset': data_offset,
+        'assets': assets,
+    }
+    manifest_file = out_file + '.manifest.json'
+    with open(manifest_file, 'w') as f:
+        json.dump(manifest, f, indent=1)
+    return manifest_file
+
 
 def download_v8_script(convert_path):
     """
@@ -440,26 +464,41 @@ def pack_assets(config: PackModelsConfig):
 
     total_files = len(file_info_list)
 
-    mmap_table = bytearray()
-    for file_name, offset, file_size, width, height in file_info_list:
-        if len(file_name) > int(max_name_len):
-            print(f'\033[1;33mWarn:\033[0m "{file_name}" exceeds {max_name_len} bytes and will be truncated.')
-        fixed_name = file_name.ljust(int(max_name_len), '\0')[:int(max_name_len)]
-        mmap_table.extend(fixed_name.encode('utf-8'))
-        mmap_table.extend(file_size.to_bytes(4, byteorder='little'))
-        mmap_table.extend(offset.to_bytes(4, byteorder='little'))
-        mmap_table.extend(width.to_bytes(2, byteorder='little'))
-        mmap_table.extend(height.to_bytes(2, byteorder='little'))
-
-    combined_data = mmap_table + merged_data
-    combined_checksum = compute_checksum(combined_data)
-    combined_data_length = len(combined_data).to_bytes(4, byteorder='little')
-    header_data = total_files.to_bytes(4, byteorder='little') + combined_checksum.to_bytes(4, byteorder='little')
-    final_data = header_data + combined_data_length + combined_data
+    if int(config.format_version) >= 2:
+        long_names = find_long_asset_names(file_info_list, int(max_name_len))
+        for file_name in long_names:
+            print(f'{RED}Error:{RESET} "{file_name}" exceeds {max_name_len} bytes, rename it.')
+        if long_names:
+            sys.exit(1)
+    else:
+        for file_name, _, _, _, _ in file_info_list:
+            if len(file_name) > int(max_name_len):
+                print(f'\033[1;33mWarn:\033[0m "{file_name}" exceeds {max_name_len} bytes and will be truncated.')
+
+    if int(config.format_version) >= 2:
+        final_data, combined_checksum = build_assets_image_v2(file_info_list, merged_data, int(max_name_len))
+    else:
+        mmap_table = bytearray()
+        for file_name, offset, file_size, width, height in file_info_list:
+            fixed_name = file_name.ljust(int(max_name_len), '\0')[:int(max_name_len)]
+            mmap_table.extend(fixed_name.encode('utf-8'))
+            mmap_table.extend(file_size.to_bytes(4, byteorder='little'))
+            mmap_table.extend(offset.to_bytes(4, byteorder='little'))
+            mmap_table.extend(width.to_bytes(2, byteorder='little'))
+            mmap_table.extend(height.to_bytes(2, byteorder='little'))
+
+        combined_data = mmap_table + merged_data
+        combined_checksum = compute_checksum(combined_data)
+        combined_data_length = len(combined_data).to_bytes(4, byteorder='little')
+        header_data = total_files.to_bytes(4, byteorder='little') + combined_checksum.to_bytes(4, byteorder='little')
+        final_data = header_data + combined_data_length + combined_data
 
     with open(out_file, 'wb') as output_bin:
         output_bin.write(final_data)
 
+    if int(config.format_version) >= 2:
+        write_assets_manifest(out_file, file_info_list, merged_data, final_data)
+
     os.makedirs(assets_include_path, exist_ok=True)
     current_year = datetime.now().year
 
@@ -557,7 +596,8 @@ def process_assets_build(config_data):
         include_path=include_path,
         image_file=image_file,
         assets_path=assets_path,
-        name_length=name_length
+        name_length=name_length,
+        format_version=int(config_data.get('format_version', 2))
     )
 
     print('--support_format:', support_format)